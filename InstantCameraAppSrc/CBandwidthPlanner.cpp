@@ -0,0 +1,304 @@
+/*  CBandwidthPlanner.cpp: Definition file for CBandwidthPlanner.
+    Shares the bandwidth of each usb host controller or network card between the cameras on it.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#include "CBandwidthPlanner.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#ifndef WIN32
+#include <dirent.h>
+#endif
+
+// Typically usb 3 can support ~350-400 MB/sec, but performance varies based on the host system's chipset. So, assuming a maximum of 300 MB/sec per chipset is usually safe.
+// usb 2 is stable at about 24 MB/sec.
+static const double DefaultUsb3Capacity = 300000000;
+static const double DefaultUsb2Capacity = 24000000;
+// Each gige packet carries 36 bytes of IP, UDP and GVSP headers within GevSCPSPacketSize, and 38 bytes of ethernet framing around it.
+static const double GigePacketHeaderSize = 36;
+static const double GigePacketFramingSize = 38;
+
+CBandwidthPlanner::CBandwidthPlanner()
+{
+	m_usb3Capacity = DefaultUsb3Capacity;
+	m_usb2Capacity = DefaultUsb2Capacity;
+}
+
+// How many bytes per second one usb host controller carries, for usb 3 (SuperSpeed) and usb 2 (HighSpeed) links. Gige links use the link speed the camera reports.
+void CBandwidthPlanner::SetLinkCapacity(double usb3BytesPerSecond, double usb2BytesPerSecond)
+{
+	m_usb3Capacity = usb3BytesPerSecond;
+	m_usb2Capacity = usb2BytesPerSecond;
+}
+
+// targetFrameRate: the frame rate the camera should reach. -1 = as fast as its share of the link allows.
+void CBandwidthPlanner::AddCamera(Pylon::CInstantCamera *pCamera, double targetFrameRate)
+{
+	SCameraPlan plan;
+	plan.pCamera = pCamera;
+	plan.targetFrameRate = targetFrameRate;
+	plan.linkCapacity = 0;
+	plan.payloadSize = 0;
+	plan.assignedRate = 0;
+	plan.sustainableFrameRate = -1;
+	m_cameras.push_back(plan);
+}
+
+// Find the shared links, split them between their cameras, and set each camera's limits.
+bool CBandwidthPlanner::Plan()
+{
+	try
+	{
+		for (size_t i = 0; i < m_cameras.size(); i++)
+		{
+			SCameraPlan &plan = m_cameras[i];
+			GenApi::INodeMap &nodeMap = plan.pCamera->GetNodeMap();
+			if (IsReadable(nodeMap.GetNode("PayloadSize")) == false)
+			{
+				cout << "Cannot read the payload size of camera " << plan.pCamera->GetDeviceInfo().GetSerialNumber() << "." << endl;
+				return false;
+			}
+			plan.payloadSize = (double)GenApi::CIntegerPtr(nodeMap.GetNode("PayloadSize"))->GetValue();
+			plan.link = find_link(plan.pCamera);
+			plan.linkCapacity = get_link_capacity(plan.pCamera);
+		}
+
+		vector<bool> isPlanned(m_cameras.size(), false);
+		for (size_t i = 0; i < m_cameras.size(); i++)
+		{
+			if (isPlanned[i] == true)
+				continue;
+
+			// the cameras on this link
+			vector<size_t> sharing;
+			for (size_t j = i; j < m_cameras.size(); j++)
+			{
+				if (m_cameras[j].link == m_cameras[i].link)
+				{
+					sharing.push_back(j);
+					isPlanned[j] = true;
+				}
+			}
+
+			// Each camera gets a share of the link in proportion to the data rate it needs. A camera without a target frame rate asks for the whole link.
+			double capacity = m_cameras[i].linkCapacity;
+			double totalDemand = 0;
+			vector<double> demand(sharing.size(), 0);
+			for (size_t k = 0; k < sharing.size(); k++)
+			{
+				SCameraPlan &plan = m_cameras[sharing[k]];
+				demand[k] = (plan.targetFrameRate > 0) ? plan.payloadSize * plan.targetFrameRate : capacity;
+				totalDemand += demand[k];
+			}
+
+			for (size_t k = 0; k < sharing.size(); k++)
+			{
+				SCameraPlan &plan = m_cameras[sharing[k]];
+				plan.assignedRate = (totalDemand > 0) ? capacity * demand[k] / totalDemand : capacity;
+				plan.sustainableFrameRate = plan.assignedRate / plan.payloadSize;
+				if (plan.targetFrameRate > 0)
+					plan.sustainableFrameRate = std::min(plan.sustainableFrameRate, plan.targetFrameRate);
+
+				if (plan.pCamera->GetDeviceInfo().GetDeviceClass() == Pylon::BaslerUsbDeviceClass)
+					assign_usb_rate(plan);
+				else if (plan.pCamera->GetDeviceInfo().GetDeviceClass() == Pylon::BaslerGigEDeviceClass)
+					assign_gige_rate(plan, (int)k);
+			}
+		}
+
+		return true;
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in Plan(): " << endl << e.GetDescription() << endl;
+		return false;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in Plan(): " << endl << e.what() << endl;
+		return false;
+	}
+}
+
+// Print the plan: each link, and what each camera on it needs, gets, and can sustain.
+void CBandwidthPlanner::Print()
+{
+	// leave cout's format as we found it for the rest of the application
+	std::ios::fmtflags flags = cout.flags();
+	std::streamsize precision = cout.precision();
+
+	cout << "Bandwidth plan:" << endl;
+	cout << std::fixed << std::setprecision(1);
+	vector<bool> isPrinted(m_cameras.size(), false);
+	for (size_t i = 0; i < m_cameras.size(); i++)
+	{
+		if (isPrinted[i] == true)
+			continue;
+
+		cout << "  " << m_cameras[i].link << " (" << m_cameras[i].linkCapacity / 1e6 << " MB/s)" << endl;
+		for (size_t j = i; j < m_cameras.size(); j++)
+		{
+			const SCameraPlan &plan = m_cameras[j];
+			if (plan.link != m_cameras[i].link)
+				continue;
+			isPrinted[j] = true;
+
+			cout << "    Camera " << plan.pCamera->GetDeviceInfo().GetSerialNumber() << ": ";
+			if (plan.targetFrameRate > 0)
+				cout << "needs " << plan.payloadSize * plan.targetFrameRate / 1e6 << " MB/s for " << plan.targetFrameRate << " fps, ";
+			cout << "gets " << plan.assignedRate / 1e6 << " MB/s, sustains " << plan.sustainableFrameRate << " fps" << endl;
+		}
+	}
+	cout.flags(flags);
+	cout.precision(precision);
+}
+
+size_t CBandwidthPlanner::GetSize()
+{
+	return m_cameras.size();
+}
+
+// The frame rate the camera can sustain on its share of the link (see Plan())
+double CBandwidthPlanner::GetSustainableFrameRate(size_t index)
+{
+	return m_cameras.at(index).sustainableFrameRate;
+}
+
+// The highest frame rate all cameras can sustain together
+double CBandwidthPlanner::GetMinSustainableFrameRate()
+{
+	double frameRate = -1;
+	for (size_t i = 0; i < m_cameras.size(); i++)
+	{
+		if (i == 0 || m_cameras[i].sustainableFrameRate < frameRate)
+			frameRate = m_cameras[i].sustainableFrameRate;
+	}
+	return frameRate;
+}
+
+// Name the link the camera shares with others.
+// usb: the usb bus the camera is on (each bus has its own root hub on a host controller). Gige: the network card the camera was found on.
+string CBandwidthPlanner::find_link(Pylon::CInstantCamera *pCamera)
+{
+	const Pylon::CDeviceInfo &deviceInfo = pCamera->GetDeviceInfo();
+	if (deviceInfo.GetDeviceClass() == Pylon::BaslerGigEDeviceClass)
+		return string("network card ") + deviceInfo.GetInterface().c_str();
+
+	if (deviceInfo.GetDeviceClass() != Pylon::BaslerUsbDeviceClass)
+		return string("camera ") + deviceInfo.GetSerialNumber().c_str(); // ie: BCON has a link of its own
+
+#ifndef WIN32
+	// linux lists each usb device with its serial number and bus in sysfs
+	string serialNumber = deviceInfo.GetSerialNumber().c_str();
+	DIR *pDirectory = opendir("/sys/bus/usb/devices");
+	if (pDirectory != NULL)
+	{
+		string busNumber = "";
+		struct dirent *pEntry = NULL;
+		while (busNumber.empty() == true && (pEntry = readdir(pDirectory)) != NULL)
+		{
+			string devicePath = string("/sys/bus/usb/devices/") + pEntry->d_name;
+			string deviceSerialNumber = "";
+			std::ifstream serialFile(devicePath + "/serial");
+			if (serialFile.is_open() && std::getline(serialFile, deviceSerialNumber) && deviceSerialNumber == serialNumber)
+			{
+				std::ifstream busFile(devicePath + "/busnum");
+				std::getline(busFile, busNumber);
+			}
+		}
+		closedir(pDirectory);
+		if (busNumber.empty() == false)
+			return "usb bus " + busNumber;
+	}
+#endif
+
+	// we can't tell the host controllers apart, so assume all usb cameras of one speed share one.
+	if (IsReadable(pCamera->GetNodeMap().GetNode("BslUSBSpeedMode")))
+		return string("usb ") + GenApi::CEnumerationPtr(pCamera->GetNodeMap().GetNode("BslUSBSpeedMode"))->ToString().c_str();
+	return "usb";
+}
+
+// How many bytes per second of image data the camera's link carries
+double CBandwidthPlanner::get_link_capacity(Pylon::CInstantCamera *pCamera)
+{
+	GenApi::INodeMap &nodeMap = pCamera->GetNodeMap();
+	if (pCamera->GetDeviceInfo().GetDeviceClass() == Pylon::BaslerGigEDeviceClass)
+	{
+		double linkSpeed = 1000; // Mbit/s
+		if (IsReadable(nodeMap.GetNode("GevLinkSpeed")))
+			linkSpeed = (double)GenApi::CIntegerPtr(nodeMap.GetNode("GevLinkSpeed"))->GetValue();
+		double packetSize = 1500;
+		if (IsReadable(nodeMap.GetNode("GevSCPSPacketSize")))
+			packetSize = (double)GenApi::CIntegerPtr(nodeMap.GetNode("GevSCPSPacketSize"))->GetValue();
+		// only the image data in each packet counts
+		return linkSpeed * 1e6 / 8 * (packetSize - GigePacketHeaderSize) / (packetSize + GigePacketFramingSize);
+	}
+
+	if (IsReadable(nodeMap.GetNode("BslUSBSpeedMode")) && GenApi::CEnumerationPtr(nodeMap.GetNode("BslUSBSpeedMode"))->ToString() == "HighSpeed")
+		return m_usb2Capacity;
+	return m_usb3Capacity;
+}
+
+// Limit the usb camera to its share of the link
+void CBandwidthPlanner::assign_usb_rate(SCameraPlan &plan)
+{
+	GenApi::INodeMap &nodeMap = plan.pCamera->GetNodeMap();
+	if (IsWritable(nodeMap.GetNode("DeviceLinkThroughputLimitMode")) == false)
+		return;
+
+	GenApi::CEnumerationPtr(nodeMap.GetNode("DeviceLinkThroughputLimitMode"))->FromString("On");
+	GenApi::CIntegerPtr ptrLimit = nodeMap.GetNode("DeviceLinkThroughputLimit");
+	int64_t limit = std::max(ptrLimit->GetMin(), std::min(ptrLimit->GetMax(), (int64_t)plan.assignedRate));
+	if (ptrLimit->GetInc() > 1)
+		limit -= (limit - ptrLimit->GetMin()) % ptrLimit->GetInc();
+	ptrLimit->SetValue(limit);
+}
+
+// Space the gige camera's packets so it sends at its share of the link, and stagger its first packet after those of the cameras before it.
+// position: the camera's place among the cameras on its link.
+void CBandwidthPlanner::assign_gige_rate(SCameraPlan &plan, int position)
+{
+	GenApi::INodeMap &nodeMap = plan.pCamera->GetNodeMap();
+	if (IsWritable(nodeMap.GetNode("GevSCPD")) == false || IsReadable(nodeMap.GetNode("GevSCPSPacketSize")) == false)
+		return;
+
+	double tickFrequency = 125000000; // the delays count ticks of the camera clock
+	if (IsReadable(nodeMap.GetNode("GevTimestampTickFrequency")))
+		tickFrequency = (double)GenApi::CIntegerPtr(nodeMap.GetNode("GevTimestampTickFrequency"))->GetValue();
+	double linkSpeed = 1000;
+	if (IsReadable(nodeMap.GetNode("GevLinkSpeed")))
+		linkSpeed = (double)GenApi::CIntegerPtr(nodeMap.GetNode("GevLinkSpeed"))->GetValue();
+	double packetSize = (double)GenApi::CIntegerPtr(nodeMap.GetNode("GevSCPSPacketSize"))->GetValue();
+
+	// each packet takes its time on the wire, plus the delay we add after it
+	double wireTime = (packetSize + GigePacketFramingSize) / (linkSpeed * 1e6 / 8);
+	double packetTime = (packetSize - GigePacketHeaderSize) / plan.assignedRate;
+	GenApi::CIntegerPtr ptrDelay = nodeMap.GetNode("GevSCPD");
+	int64_t delay = std::max(ptrDelay->GetMin(), std::min(ptrDelay->GetMax(), (int64_t)((packetTime - wireTime) * tickFrequency)));
+	ptrDelay->SetValue(delay);
+
+	if (IsWritable(nodeMap.GetNode("GevSCFTD")))
+	{
+		GenApi::CIntegerPtr ptrTransmissionDelay = nodeMap.GetNode("GevSCFTD");
+		int64_t transmissionDelay = std::min(ptrTransmissionDelay->GetMax(), (int64_t)(position * wireTime * tickFrequency));
+		ptrTransmissionDelay->SetValue(transmissionDelay);
+	}
+}
@@ -0,0 +1,69 @@
+/*  CBandwidthPlanner.h: header file for CBandwidthPlanner.
+    Shares the bandwidth of each usb host controller or network card between the cameras on it.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#pragma once
+
+#include <pylon/PylonIncludes.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// ******* CBandwidthPlanner *******
+// Cameras on one usb host controller, or one network card, share its bandwidth. If together they send more than it carries, images are lost.
+// Plan() finds which cameras share a link, works out the data rate each camera needs from its payload size (AOI, pixel format, chunks) and target frame rate,
+// and splits the link between them in that proportion, so the link is filled without overflowing:
+// - usb cameras get a DeviceLinkThroughputLimit.
+// - gige cameras get an inter-packet delay (GevSCPD), and their frame transmission delays (GevSCFTD) are staggered, so they don't start sending at the same moment.
+// It then reports the frame rate each camera can sustain. Plan after setting the AOI and pixel format, and before starting the cameras.
+class CBandwidthPlanner
+{
+public:
+	CBandwidthPlanner();
+
+	void SetLinkCapacity(double usb3BytesPerSecond, double usb2BytesPerSecond);
+	void AddCamera(Pylon::CInstantCamera *pCamera, double targetFrameRate = -1);
+	bool Plan();
+	void Print();
+	size_t GetSize();
+	double GetSustainableFrameRate(size_t index);
+	double GetMinSustainableFrameRate();
+
+private:
+	struct SCameraPlan
+	{
+		Pylon::CInstantCamera *pCamera;
+		double targetFrameRate;      // -1 = as fast as the link allows
+		string link;                 // the host controller or network card the camera is on
+		double linkCapacity;         // bytes per second the link carries
+		double payloadSize;          // bytes per image
+		double assignedRate;         // bytes per second the camera may send
+		double sustainableFrameRate;
+	};
+	vector<SCameraPlan> m_cameras;
+	double m_usb3Capacity;
+	double m_usb2Capacity;
+	string find_link(Pylon::CInstantCamera *pCamera);
+	double get_link_capacity(Pylon::CInstantCamera *pCamera);
+	void assign_usb_rate(SCameraPlan &plan);
+	void assign_gige_rate(SCameraPlan &plan, int position);
+};
@@ -0,0 +1,834 @@
+/*  CCameraArrayAppSrc.cpp: Definition file for CCameraArrayAppSrc.
+    Opens many cameras at once, and retrieves their images on one shared pool of threads.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#include "CCameraArrayAppSrc.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <pylon/gige/GigETransportLayer.h>
+
+// The keys the cameras accept our action commands with (see configure_action_commands())
+static const uint32_t ActionDeviceKey = 0x50594C4E;
+static const uint32_t ActionGroupKey = 1;
+static const uint32_t ActionGroupMask = 0xFFFFFFFF;
+// How long before each image its action command is sent. It must reach every camera in time.
+static const int64_t ActionLeadTimeNs = 20000000;
+// How far the camera clocks may be from the PTP master before we consider them synchronized
+static const int64_t MaxPtpOffsetNs = 1000;
+// How many images of one camera may wait for the rest of their set
+static const size_t MaxPendingFrames = 4;
+
+// Enumerate the cameras once, and open them in parallel.
+// maxNumCameras: use at most this many of the cameras found (-1 = all of them).
+// serialNumbers: use these cameras, in this order, instead of the first ones found.
+// pWorkerPool: the pool to retrieve and convert the images on. If NULL, the array makes one with a thread per core.
+CCameraArrayAppSrc::CCameraArrayAppSrc(int maxNumCameras, vector<string> serialNumbers, CWorkerPool *pWorkerPool)
+{
+	// initialize Pylon runtime. The cameras share it.
+	Pylon::PylonInitialize();
+
+	m_pWorkerPool = pWorkerPool;
+	m_ownsWorkerPool = false;
+	m_isRetrieving = false;
+	m_syncMode = Sync_None;
+	m_toleranceMs = -1;
+	m_frameRate = 0;
+	m_tolerance = 0;
+	m_isTriggering = false;
+	m_statsIntervalMs = 1000;
+	m_isSampling = false;
+	m_numSetsPushed = 0;
+	m_numFramesUnmatched = 0;
+
+	try
+	{
+		if (m_pWorkerPool == NULL)
+		{
+			m_pWorkerPool = new CWorkerPool();
+			m_ownsWorkerPool = true;
+		}
+
+		Pylon::DeviceInfoList_t devices;
+		CTlFactory::GetInstance().EnumerateDevices(devices);
+
+		vector<Pylon::CDeviceInfo> selected;
+		if (serialNumbers.empty() == true)
+		{
+			for (size_t i = 0; i < devices.size() && (maxNumCameras < 0 || (int)selected.size() < maxNumCameras); i++)
+				selected.push_back(devices[i]);
+		}
+		else
+		{
+			for (size_t s = 0; s < serialNumbers.size(); s++)
+			{
+				bool isFound = false;
+				for (size_t i = 0; i < devices.size() && isFound == false; i++)
+				{
+					if (string(devices[i].GetSerialNumber().c_str()) == serialNumbers[s])
+					{
+						selected.push_back(devices[i]);
+						isFound = true;
+					}
+				}
+				if (isFound == false)
+					cout << "Camera " << serialNumbers[s] << " not found." << endl;
+			}
+		}
+
+		// Opening a camera mostly waits for the device, so open them all at once.
+		cout << "Opening " << selected.size() << " cameras..." << endl;
+		vector<CInstantCameraAppSrc*> cameras(selected.size(), (CInstantCameraAppSrc*)NULL);
+		m_pWorkerPool->Run((int)selected.size(), [&](int i) { cameras[i] = new CInstantCameraAppSrc(selected[i]); });
+
+		for (size_t i = 0; i < cameras.size(); i++)
+		{
+			if (cameras[i]->IsOpen() == false)
+			{
+				cout << "Could not open camera " << selected[i].GetSerialNumber() << "." << endl;
+				delete cameras[i];
+				continue;
+			}
+
+			// The array retrieves the images, and converts several cameras' images in parallel on the shared pool.
+			// The array publishes the statistics of all cameras from one thread (see SetStatsInterval()).
+			cameras[i]->SetExternalRetrieval(true);
+			cameras[i]->SetConversionStripes(1);
+			cameras[i]->SetStatsInterval(0);
+			m_cameras.push_back(cameras[i]);
+		}
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in CCameraArrayAppSrc(): " << endl << e.GetDescription() << endl;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in CCameraArrayAppSrc(): " << endl << e.what() << endl;
+	}
+}
+
+CCameraArrayAppSrc::~CCameraArrayAppSrc()
+{
+	StopCameras();
+	for (size_t i = 0; i < m_cameras.size(); i++)
+		delete m_cameras[i];
+	m_cameras.clear();
+	if (m_ownsWorkerPool == true)
+		delete m_pWorkerPool;
+	// free resources allocated by pylon runtime.
+	Pylon::PylonTerminate();
+}
+
+// How many cameras are open
+size_t CCameraArrayAppSrc::GetSize()
+{
+	return m_cameras.size();
+}
+
+// Each camera is a CInstantCameraAppSrc, for its own settings and source bin (GetSource())
+CInstantCameraAppSrc& CCameraArrayAppSrc::GetCamera(size_t index)
+{
+	return *m_cameras.at(index);
+}
+
+// Initialize all cameras in parallel with the same settings (see CInstantCameraAppSrc::InitCamera())
+bool CCameraArrayAppSrc::InitCameras(int width, int height, int framesPerSecond, bool useTrigger, int scaledWidth, int scaledHeight, int rotation)
+{
+	try
+	{
+		if (m_cameras.empty() == true)
+		{
+			cout << "No cameras to initialize." << endl;
+			return false;
+		}
+
+		// synchronized cameras only take images on their trigger
+		if (m_syncMode != Sync_None)
+		{
+			useTrigger = true;
+			for (size_t i = 0; i < m_cameras.size(); i++)
+				m_cameras[i]->SetTriggerSource(m_syncMode == Sync_ActionCommand ? "Action1" : "Line1");
+		}
+		m_frameRate = framesPerSecond;
+
+		vector<char> isInitialized(m_cameras.size(), 0);
+		m_pWorkerPool->Run((int)m_cameras.size(), [&](int i)
+		{
+			isInitialized[i] = m_cameras[i]->InitCamera(width, height, framesPerSecond, false, useTrigger, scaledWidth, scaledHeight, rotation) ? 1 : 0;
+		});
+
+		if (std::find(isInitialized.begin(), isInitialized.end(), 0) != isInitialized.end())
+			return false;
+
+		if (m_syncMode == Sync_ActionCommand)
+			return configure_action_commands() && synchronize_clocks();
+
+		return true;
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in InitCameras(): " << endl << e.GetDescription() << endl;
+		return false;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in InitCameras(): " << endl << e.what() << endl;
+		return false;
+	}
+}
+
+// The highest frame rate all cameras can reach under their current settings
+double CCameraArrayAppSrc::GetMaxCommonFrameRate()
+{
+	double frameRate = 0;
+	for (size_t i = 0; i < m_cameras.size(); i++)
+	{
+		if (i == 0 || m_cameras[i]->GetFrameRate() < frameRate)
+			frameRate = m_cameras[i]->GetFrameRate();
+	}
+	return frameRate;
+}
+
+// Split the bandwidth of each usb host controller or network card between the cameras on it (see CBandwidthPlanner), and print the plan.
+// Run after InitCameras(), and after changing the AOI or pixel format.
+// targetFrameRate: the frame rate each camera should reach. -1 = as fast as the links allow.
+// Returns the highest frame rate all cameras can sustain together, or -1 if the bandwidth could not be planned.
+double CCameraArrayAppSrc::PlanBandwidth(double targetFrameRate)
+{
+	if (m_isRetrieving == true)
+	{
+		cout << "Cannot plan bandwidth while grabbing. Run StopCameras() first." << endl;
+		return -1;
+	}
+
+	CBandwidthPlanner planner;
+	for (size_t i = 0; i < m_cameras.size(); i++)
+		planner.AddCamera(m_cameras[i], targetFrameRate);
+	if (planner.Plan() == false)
+		return -1;
+
+	planner.Print();
+	return planner.GetMinSustainableFrameRate();
+}
+
+// Run all cameras at the same frame rate
+// With Sync_ActionCommand, this is the rate we trigger the cameras at. With Sync_HardwareTrigger, the trigger signal sets the rate; tell us what it is, to match the images by.
+bool CCameraArrayAppSrc::SetFrameRate(double framesPerSecond)
+{
+	if (m_isRetrieving == true)
+	{
+		cout << "Cannot change frame rate while grabbing. Run StopCameras() first." << endl;
+		return false;
+	}
+	if (framesPerSecond <= 0)
+	{
+		cout << "Frame rate must be positive." << endl;
+		return false;
+	}
+
+	m_frameRate = framesPerSecond;
+	if (m_syncMode != Sync_None)
+		return true;
+
+	bool isSet = true;
+	for (size_t i = 0; i < m_cameras.size(); i++)
+		isSet = m_cameras[i]->SetFrameRate(framesPerSecond) && isSet;
+	return isSet;
+}
+
+// Start all cameras, and the retrieval of their images. Run GetCamera(i).GetSource() for each camera first.
+bool CCameraArrayAppSrc::StartCameras()
+{
+	try
+	{
+		if (m_isRetrieving == true)
+		{
+			cout << "Cameras are already started." << endl;
+			return false;
+		}
+
+		// we trigger action commands at m_frameRate, so we need a rate to trigger at
+		if (m_syncMode == Sync_ActionCommand && m_frameRate <= 0)
+			m_frameRate = GetMaxCommonFrameRate();
+		if (m_syncMode == Sync_ActionCommand && m_frameRate <= 0)
+		{
+			cout << "Cannot trigger the cameras without a frame rate. Run SetFrameRate() first." << endl;
+			return false;
+		}
+
+		for (size_t i = 0; i < m_cameras.size(); i++)
+		{
+			if (m_cameras[i]->StartCamera() == false)
+			{
+				for (size_t j = 0; j < i; j++)
+					m_cameras[j]->StopCamera();
+				return false;
+			}
+		}
+
+		// images further apart than this are not from the same trigger. Default: half a frame period.
+		if (m_toleranceMs >= 0)
+			m_tolerance = (guint64)(m_toleranceMs * 1e6);
+		else if (m_frameRate > 0)
+			m_tolerance = (guint64)(0.5e9 / m_frameRate);
+		else
+			m_tolerance = 5000000;
+		m_pendingFrames.assign(m_cameras.size(), std::deque<std::pair<guint64, GstBuffer*>>());
+		m_isCameraRemoved.assign(m_cameras.size(), false);
+		m_numSetsPushed = 0;
+		m_numFramesUnmatched = 0;
+
+		m_isRetrieving = true;
+		m_retrievalThread = std::thread(&CCameraArrayAppSrc::retrieval_loop, this);
+
+		if (m_syncMode == Sync_ActionCommand)
+		{
+			m_isTriggering = true;
+			m_triggerThread = std::thread(&CCameraArrayAppSrc::trigger_loop, this);
+		}
+
+		if (m_statsIntervalMs > 0)
+		{
+			m_isSampling = true;
+			m_statsThread = std::thread(&CCameraArrayAppSrc::stats_loop, this);
+		}
+		return true;
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in StartCameras(): " << endl << e.GetDescription() << endl;
+		return false;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in StartCameras(): " << endl << e.what() << endl;
+		return false;
+	}
+}
+
+// Stop the retrieval of images, and then the cameras
+bool CCameraArrayAppSrc::StopCameras()
+{
+	if (m_isRetrieving == false)
+		return false;
+
+	stop_stats_thread();
+
+	m_isTriggering = false;
+	if (m_triggerThread.joinable())
+		m_triggerThread.join();
+
+	m_isRetrieving = false;
+	if (m_retrievalThread.joinable())
+		m_retrievalThread.join();
+
+	if (m_syncMode != Sync_None)
+	{
+		release_pending_frames();
+		cout << "Synchronized sets pushed: " << m_numSetsPushed << ", unmatched images dropped: " << m_numFramesUnmatched << endl;
+	}
+
+	bool isStopped = true;
+	for (size_t i = 0; i < m_cameras.size(); i++)
+		isStopped = m_cameras[i]->StopCamera() && isStopped;
+	return isStopped;
+}
+
+bool CCameraArrayAppSrc::CloseCameras()
+{
+	StopCameras();
+
+	bool isClosed = true;
+	for (size_t i = 0; i < m_cameras.size(); i++)
+		isClosed = m_cameras[i]->CloseCamera() && isClosed;
+	return isClosed;
+}
+
+// Take the images of all cameras together, and push them in matched sets. Run before InitCameras().
+// Sync_HardwareTrigger: wire one trigger signal to Line1 of every camera. The images are matched by their timestamps on the pipeline clock (see CInstantCameraAppSrc::SetHardwareTimestamps()).
+// Sync_ActionCommand: GigE cameras on one network synchronize their clocks by PTP, and take each image at the same PTP time, scheduled by an action command.
+//                     The images are matched by their camera timestamps, which are all on the PTP clock.
+// toleranceMs: how far apart the images of one set may be. -1 = half a frame period.
+bool CCameraArrayAppSrc::SetSynchronization(ESyncMode syncMode, double toleranceMs)
+{
+	if (m_isRetrieving == true)
+	{
+		cout << "Cannot change synchronization while grabbing. Run StopCameras() first." << endl;
+		return false;
+	}
+
+	m_syncMode = syncMode;
+	m_toleranceMs = toleranceMs;
+	return true;
+}
+
+// How often the frame counts and stream grabber statistics of all cameras are published while grabbing (see CInstantCameraAppSrc::PublishStats()).
+// 0 publishes them only once, when the cameras stop. The cameras' own stats threads stay off.
+// To write the statistics to metrics files, give each camera its own file with GetCamera(i).SetStatsInterval(0, metricsFile).
+bool CCameraArrayAppSrc::SetStatsInterval(int intervalMs)
+{
+	if (m_isRetrieving == true)
+	{
+		cout << "Cannot change stats interval while grabbing. Run StopCameras() first." << endl;
+		return false;
+	}
+	if (intervalMs < 0)
+	{
+		cout << "Stats interval cannot be negative." << endl;
+		return false;
+	}
+
+	m_statsIntervalMs = intervalMs;
+	return true;
+}
+
+// How many matched sets of images were pushed since StartCameras()
+uint64_t CCameraArrayAppSrc::GetNumSetsPushed()
+{
+	return m_numSetsPushed;
+}
+
+// How many images were dropped since StartCameras(), because the other cameras had no image to match them with
+uint64_t CCameraArrayAppSrc::GetNumFramesUnmatched()
+{
+	return m_numFramesUnmatched;
+}
+
+// Wait for an image from any camera, and retrieve, convert and push the images of all cameras that have one, in parallel on the pool.
+void CCameraArrayAppSrc::retrieval_loop()
+{
+	Pylon::WaitObjects waitObjects;
+	for (size_t i = 0; i < m_cameras.size(); i++)
+		waitObjects.Add(m_cameras[i]->GetGrabResultWaitObject());
+	size_t numWaiting = m_cameras.size();
+
+	vector<int> ready;
+	vector<GstBuffer*> buffers;
+	vector<guint64> deviceTimes;
+	while (m_isRetrieving == true)
+	{
+		try
+		{
+			// Use a short timeout, so we notice when to stop.
+			bool isImageReady = false;
+			if (numWaiting > 0)
+				isImageReady = waitObjects.WaitForAny(100);
+			else
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+			// Look for removed cameras even while the others keep sending images.
+			bool isAnyRemoved = false;
+			for (size_t i = 0; i < m_cameras.size(); i++)
+			{
+				if (m_isCameraRemoved[i] == false && m_cameras[i]->IsCameraDeviceRemoved() == true)
+				{
+					m_cameras[i]->PushImage(0); // sends end-of-stream
+					m_isCameraRemoved[i] = true;
+					isAnyRemoved = true;
+					if (m_syncMode != Sync_None)
+					{
+						cout << "Camera " << m_cameras[i]->GetDeviceInfo().GetSerialNumber() << " removed. Matching the images of the other cameras." << endl;
+						while (m_pendingFrames[i].empty() == false)
+							drop_pending_frame(i);
+						match_frames();
+					}
+				}
+			}
+
+			// stop waiting on removed cameras. Their wait objects may stay signaled with nothing to retrieve.
+			if (isAnyRemoved == true)
+			{
+				waitObjects.RemoveAll();
+				numWaiting = 0;
+				for (size_t i = 0; i < m_cameras.size(); i++)
+				{
+					if (m_isCameraRemoved[i] == false)
+					{
+						waitObjects.Add(m_cameras[i]->GetGrabResultWaitObject());
+						numWaiting++;
+					}
+				}
+				continue;
+			}
+
+			if (isImageReady == false)
+				continue;
+
+			ready.clear();
+			for (size_t i = 0; i < m_cameras.size(); i++)
+			{
+				if (m_isCameraRemoved[i] == false && m_cameras[i]->GetGrabResultWaitObject().Wait(0) == true)
+					ready.push_back((int)i);
+			}
+
+			if (m_syncMode == Sync_None)
+			{
+				m_pWorkerPool->Run((int)ready.size(), [&](int task) { m_cameras[ready[task]]->PushImage(0); });
+				continue;
+			}
+
+			// retrieve and convert the images in parallel, then match them into sets here, in order.
+			buffers.assign(ready.size(), (GstBuffer*)NULL);
+			deviceTimes.assign(ready.size(), 0);
+			m_pWorkerPool->Run((int)ready.size(), [&](int task) { buffers[task] = m_cameras[ready[task]]->GrabImage(0, &deviceTimes[task]); });
+
+			for (size_t task = 0; task < ready.size(); task++)
+			{
+				if (buffers[task] != NULL)
+					m_pendingFrames[ready[task]].push_back(std::make_pair(get_capture_time(buffers[task], deviceTimes[task]), buffers[task]));
+			}
+			match_frames();
+		}
+		catch (GenICam::GenericException &e)
+		{
+			cerr << "An exception occured in retrieval_loop(): " << endl << e.GetDescription() << endl;
+		}
+		catch (std::exception &e)
+		{
+			cerr << "An exception occurred in retrieval_loop(): " << endl << e.what() << endl;
+		}
+	}
+}
+
+// Latch the camera's PTP data set, and read its state (ie: "Master", "Slave", "Listening") and offset from the master clock in ns.
+// GigE cameras use the GevIEEE1588 names, newer cameras the SFNC3 Ptp names.
+static bool read_ptp_status(GenApi::INodeMap &nodeMap, string &status, int64_t &offsetFromMaster)
+{
+	if (IsWritable(nodeMap.GetNode("GevIEEE1588DataSetLatch")))
+	{
+		GenApi::CCommandPtr(nodeMap.GetNode("GevIEEE1588DataSetLatch"))->Execute();
+		status = GenApi::CEnumerationPtr(nodeMap.GetNode("GevIEEE1588StatusLatched"))->ToString().c_str();
+		offsetFromMaster = GenApi::CIntegerPtr(nodeMap.GetNode("GevIEEE1588OffsetFromMaster"))->GetValue();
+		return true;
+	}
+	if (IsWritable(nodeMap.GetNode("PtpDataSetLatch")))
+	{
+		GenApi::CCommandPtr(nodeMap.GetNode("PtpDataSetLatch"))->Execute();
+		status = GenApi::CEnumerationPtr(nodeMap.GetNode("PtpStatus"))->ToString().c_str();
+		offsetFromMaster = GenApi::CIntegerPtr(nodeMap.GetNode("PtpOffsetFromMaster"))->GetValue();
+		return true;
+	}
+	return false;
+}
+
+// Latch the camera's clock, and read it in ns. With PTP, this is the time on the master clock.
+static uint64_t read_camera_time(GenApi::INodeMap &nodeMap)
+{
+	if (IsWritable(nodeMap.GetNode("GevTimestampControlLatch")))
+	{
+		GenApi::CCommandPtr(nodeMap.GetNode("GevTimestampControlLatch"))->Execute();
+		return (uint64_t)GenApi::CIntegerPtr(nodeMap.GetNode("GevTimestampValue"))->GetValue();
+	}
+	GenApi::CCommandPtr(nodeMap.GetNode("TimestampLatch"))->Execute(); // SFNC3 names
+	return (uint64_t)GenApi::CIntegerPtr(nodeMap.GetNode("TimestampLatchValue"))->GetValue();
+}
+
+// Turn on PTP (IEEE 1588) in every camera, and wait until they follow one master clock within MaxPtpOffsetNs.
+// The master is either one of the cameras, or another PTP clock on the network (ie: a switch), in which case all cameras are slaves.
+bool CCameraArrayAppSrc::synchronize_clocks()
+{
+	try
+	{
+		for (size_t i = 0; i < m_cameras.size(); i++)
+		{
+			GenApi::INodeMap &nodeMap = m_cameras[i]->GetNodeMap();
+			if (IsWritable(nodeMap.GetNode("GevIEEE1588")))
+				GenApi::CBooleanPtr(nodeMap.GetNode("GevIEEE1588"))->SetValue(true);
+			else if (IsWritable(nodeMap.GetNode("PtpEnable")))
+				GenApi::CBooleanPtr(nodeMap.GetNode("PtpEnable"))->SetValue(true);
+			else
+			{
+				cout << "Camera " << m_cameras[i]->GetDeviceInfo().GetSerialNumber() << " does not support PTP." << endl;
+				return false;
+			}
+		}
+
+		// The cameras first agree on a master, and then the slaves take some seconds to settle on its clock.
+		cout << "Waiting for the camera clocks to synchronize (PTP)..." << endl;
+		for (int attempt = 0; attempt < 60; attempt++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+			size_t numMasters = 0;
+			size_t numSlaves = 0;
+			int64_t maxOffset = 0;
+			for (size_t i = 0; i < m_cameras.size(); i++)
+			{
+				string status;
+				int64_t offset = 0;
+				if (read_ptp_status(m_cameras[i]->GetNodeMap(), status, offset) == false)
+				{
+					cout << "Cannot read the PTP status of camera " << m_cameras[i]->GetDeviceInfo().GetSerialNumber() << "." << endl;
+					return false;
+				}
+				if (status == "Master")
+					numMasters++;
+				else if (status == "Slave")
+				{
+					numSlaves++;
+					maxOffset = std::max(maxOffset, (int64_t)std::llabs(offset));
+				}
+			}
+
+			if (numMasters <= 1 && numMasters + numSlaves == m_cameras.size() && maxOffset <= MaxPtpOffsetNs)
+			{
+				cout << "Camera clocks synchronized. Largest offset from the master clock: " << maxOffset << " ns" << endl;
+				return true;
+			}
+		}
+
+		cout << "The camera clocks did not synchronize in time. Check that the cameras are on one network, and that PTP is not blocked." << endl;
+		return false;
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in synchronize_clocks(): " << endl << e.GetDescription() << endl;
+		return false;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in synchronize_clocks(): " << endl << e.what() << endl;
+		return false;
+	}
+}
+
+// Make every camera accept our action commands. Their trigger source is Action1 (see InitCameras()).
+bool CCameraArrayAppSrc::configure_action_commands()
+{
+	try
+	{
+		for (size_t i = 0; i < m_cameras.size(); i++)
+		{
+			GenApi::INodeMap &nodeMap = m_cameras[i]->GetNodeMap();
+			if (IsWritable(nodeMap.GetNode("ActionDeviceKey")) == false)
+			{
+				cout << "Camera " << m_cameras[i]->GetDeviceInfo().GetSerialNumber() << " does not support action commands." << endl;
+				return false;
+			}
+
+			if (IsWritable(nodeMap.GetNode("ActionSelector")))
+				GenApi::CIntegerPtr(nodeMap.GetNode("ActionSelector"))->SetValue(1);
+			GenApi::CIntegerPtr(nodeMap.GetNode("ActionDeviceKey"))->SetValue(ActionDeviceKey);
+			GenApi::CIntegerPtr(nodeMap.GetNode("ActionGroupKey"))->SetValue(ActionGroupKey);
+			GenApi::CIntegerPtr(nodeMap.GetNode("ActionGroupMask"))->SetValue(ActionGroupMask);
+		}
+		return true;
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in configure_action_commands(): " << endl << e.GetDescription() << endl;
+		return false;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in configure_action_commands(): " << endl << e.what() << endl;
+		return false;
+	}
+}
+
+// Trigger all cameras at m_frameRate with scheduled action commands.
+// Each command is sent ActionLeadTimeNs ahead, and tells the cameras at which PTP time to take the image, so they expose together however late the command reaches each one.
+// We pace the commands with the host clock, and map it onto the PTP clock again every second, so the drift between the two doesn't add up.
+void CCameraArrayAppSrc::trigger_loop()
+{
+	Pylon::IGigETransportLayer *pTl = NULL;
+	try
+	{
+		pTl = dynamic_cast<Pylon::IGigETransportLayer*>(CTlFactory::GetInstance().CreateTl(Pylon::BaslerGigEDeviceClass));
+		if (pTl == NULL)
+		{
+			cout << "GigE transport layer not available. Cannot send action commands." << endl;
+			return;
+		}
+
+		const uint64_t period = (uint64_t)(1e9 / m_frameRate);
+		uint64_t actionTime = 0; // the PTP time of the next image
+		uint64_t anchorCameraTime = 0;
+		std::chrono::steady_clock::time_point anchorHostTime;
+		std::chrono::steady_clock::time_point nextAnchorTime = std::chrono::steady_clock::now();
+
+		while (m_isTriggering == true)
+		{
+			if (std::chrono::steady_clock::now() >= nextAnchorTime)
+			{
+				anchorCameraTime = read_camera_time(m_cameras[0]->GetNodeMap());
+				anchorHostTime = std::chrono::steady_clock::now();
+				nextAnchorTime = anchorHostTime + std::chrono::seconds(1);
+				if (actionTime == 0)
+					actionTime = anchorCameraTime + ActionLeadTimeNs;
+			}
+
+			std::this_thread::sleep_until(anchorHostTime + std::chrono::nanoseconds((int64_t)(actionTime - anchorCameraTime) - ActionLeadTimeNs));
+			if (m_isTriggering == false)
+				break;
+
+			// if we fell behind (ie: the host was busy), skip the images we can no longer schedule in time, rather than bunching them up.
+			uint64_t cameraTime = anchorCameraTime + (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - anchorHostTime).count();
+			while (actionTime < cameraTime + ActionLeadTimeNs / 2)
+				actionTime += period;
+
+			pTl->IssueScheduledActionCommand(ActionDeviceKey, ActionGroupKey, ActionGroupMask, actionTime, "255.255.255.255");
+			actionTime += period;
+		}
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in trigger_loop(): " << endl << e.GetDescription() << endl;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in trigger_loop(): " << endl << e.what() << endl;
+	}
+
+	if (pTl != NULL)
+		CTlFactory::GetInstance().ReleaseTl(pTl);
+}
+
+// The time we match images by, in ns.
+// With action commands, the camera timestamps are all on the PTP clock. Otherwise we use the image's timestamp on the pipeline clock (the cameras' sources share one pipeline),
+// or when it arrived, if it has none.
+guint64 CCameraArrayAppSrc::get_capture_time(GstBuffer *buffer, guint64 deviceTime)
+{
+	if (m_syncMode == Sync_ActionCommand)
+		return deviceTime;
+	if (GST_BUFFER_PTS(buffer) != GST_CLOCK_TIME_NONE)
+		return GST_BUFFER_PTS(buffer);
+	return (guint64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Push the pending images in sets: one image from each camera, all taken within m_tolerance of each other, with one common timestamp.
+// An image that can no longer be part of a full set (the other cameras have moved on to newer images) is dropped here, before it costs the pipeline anything.
+// Removed cameras are left out of the sets, so the others carry on without them.
+void CCameraArrayAppSrc::match_frames()
+{
+	while (true)
+	{
+		size_t numCameras = 0;
+		// a camera that keeps losing images must not hold back the images of the others
+		for (size_t i = 0; i < m_pendingFrames.size(); i++)
+		{
+			while (m_pendingFrames[i].size() > MaxPendingFrames)
+				drop_pending_frame(i);
+		}
+
+		guint64 newestTime = 0;
+		for (size_t i = 0; i < m_pendingFrames.size(); i++)
+		{
+			if (m_isCameraRemoved[i] == true)
+				continue;
+			if (m_pendingFrames[i].empty() == true)
+				return;
+			newestTime = std::max(newestTime, m_pendingFrames[i].front().first);
+			numCameras++;
+		}
+		if (numCameras == 0)
+			return;
+
+		// the oldest images can only be matched with images the other cameras have already passed
+		bool isComplete = true;
+		for (size_t i = 0; i < m_pendingFrames.size(); i++)
+		{
+			if (m_isCameraRemoved[i] == true)
+				continue;
+			while (m_pendingFrames[i].empty() == false && m_pendingFrames[i].front().first + m_tolerance < newestTime)
+				drop_pending_frame(i);
+			if (m_pendingFrames[i].empty() == true)
+				isComplete = false;
+		}
+		if (isComplete == false)
+			return;
+
+		// give the set one timestamp, so the compositor or recorder takes the images together
+		GstClockTime pts = 0;
+		for (size_t i = 0; i < m_pendingFrames.size() && pts != GST_CLOCK_TIME_NONE; i++)
+		{
+			if (m_isCameraRemoved[i] == true)
+				continue;
+			GstClockTime framePts = GST_BUFFER_PTS(m_pendingFrames[i].front().second);
+			pts = (framePts == GST_CLOCK_TIME_NONE) ? GST_CLOCK_TIME_NONE : std::max(pts, framePts);
+		}
+
+		for (size_t i = 0; i < m_pendingFrames.size(); i++)
+		{
+			if (m_isCameraRemoved[i] == true)
+				continue;
+			GstBuffer *buffer = m_pendingFrames[i].front().second;
+			m_pendingFrames[i].pop_front();
+			if (pts != GST_CLOCK_TIME_NONE)
+			{
+				buffer = gst_buffer_make_writable(buffer);
+				GST_BUFFER_PTS(buffer) = pts;
+			}
+			m_cameras[i]->PushBuffer(buffer);
+		}
+		m_numSetsPushed++;
+	}
+}
+
+void CCameraArrayAppSrc::drop_pending_frame(size_t index)
+{
+	gst_buffer_unref(m_pendingFrames[index].front().second);
+	m_pendingFrames[index].pop_front();
+	m_numFramesUnmatched++;
+}
+
+// Throw away the images still waiting for a set, when the cameras stop
+void CCameraArrayAppSrc::release_pending_frames()
+{
+	for (size_t i = 0; i < m_pendingFrames.size(); i++)
+	{
+		for (size_t j = 0; j < m_pendingFrames[i].size(); j++)
+			gst_buffer_unref(m_pendingFrames[i][j].second);
+		m_pendingFrames[i].clear();
+	}
+}
+
+// Publish the statistics of all cameras every m_statsIntervalMs, on one thread of our own, so reading the stream grabbers' node maps never delays retrieval.
+void CCameraArrayAppSrc::stats_loop()
+{
+	std::unique_lock<std::mutex> lock(m_statsMutex);
+	while (m_isSampling == true)
+	{
+		m_statsCondition.wait_for(lock, std::chrono::milliseconds(m_statsIntervalMs));
+		if (m_isSampling == false)
+			break;
+
+		for (size_t i = 0; i < m_cameras.size(); i++)
+		{
+			if (m_cameras[i]->IsCameraDeviceRemoved() == false)
+				m_cameras[i]->PublishStats();
+		}
+	}
+}
+
+// Stop publishing the statistics. Each camera publishes them once more when it stops.
+void CCameraArrayAppSrc::stop_stats_thread()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		m_isSampling = false;
+	}
+	m_statsCondition.notify_all();
+
+	if (m_statsThread.joinable())
+		m_statsThread.join();
+}
@@ -0,0 +1,117 @@
+/*  CCameraArrayAppSrc.h: header file for CCameraArrayAppSrc.
+    Opens many cameras at once, and retrieves their images on one shared pool of threads.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#pragma once
+
+#include <pylon/PylonIncludes.h>
+#include <gst/gst.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "CInstantCameraAppSrc.h"
+#include "CWorkerPool.h"
+#include "CBandwidthPlanner.h"
+
+using namespace std;
+
+// ******* CCameraArrayAppSrc *******
+// Manages many CInstantCameraAppSrc cameras (eg: 8-12 per host) as one:
+// - the devices are enumerated once, and the cameras are opened and initialized in parallel.
+// - one retrieval thread waits for images from all cameras at once (like CInstantCameraArray::RetrieveResult()),
+//   and the cameras with an image are retrieved, converted and pushed in parallel on one shared CWorkerPool (see CInstantCameraAppSrc::SetExternalRetrieval()).
+//   Each camera converts its images in one stripe, as the parallelism comes from the cameras.
+// - one stats thread publishes the frame counts and stream grabber statistics of all cameras (see SetStatsInterval()), instead of one per camera.
+//   So the number of threads doesn't grow with the number of cameras.
+// - each camera still has its own source bin, from GetCamera(i).GetSource().
+// The cameras run free (no on-demand software trigger), as their images are retrieved when they arrive.
+// With SetSynchronization(), the cameras instead take their images together, and the images are pushed in matched sets (ie: for stereo and multi-view measurement).
+class CCameraArrayAppSrc
+{
+public:
+	// How the cameras take their images together
+	enum ESyncMode
+	{
+		Sync_None,            // each camera runs free, and its images are pushed as they arrive
+		Sync_HardwareTrigger, // the cameras are wired to one trigger signal on Line1 (ie: USB cameras)
+		Sync_ActionCommand    // GigE: the camera clocks are synchronized by PTP (IEEE 1588), and we trigger the cameras with scheduled action commands
+	};
+
+	CCameraArrayAppSrc(int maxNumCameras = -1, vector<string> serialNumbers = vector<string>(), CWorkerPool *pWorkerPool = NULL);
+	~CCameraArrayAppSrc();
+
+	size_t GetSize();
+	CInstantCameraAppSrc& GetCamera(size_t index);
+	bool InitCameras(
+		int width,
+		int height,
+		int framesPerSecond,
+		bool useTrigger = false,
+		int scaledWidth = -1,
+		int scaledHeight = -1,
+		int rotation = -1);
+	double GetMaxCommonFrameRate();
+	double PlanBandwidth(double targetFrameRate = -1);
+	bool SetFrameRate(double framesPerSecond);
+	bool StartCameras();
+	bool StopCameras();
+	bool CloseCameras();
+	bool SetSynchronization(ESyncMode syncMode, double toleranceMs = -1);
+	uint64_t GetNumSetsPushed();
+	uint64_t GetNumFramesUnmatched();
+	bool SetStatsInterval(int intervalMs);
+
+private:
+	vector<CInstantCameraAppSrc*> m_cameras;
+	CWorkerPool *m_pWorkerPool;
+	bool m_ownsWorkerPool;
+	std::thread m_retrievalThread;
+	int m_statsIntervalMs;
+	std::thread m_statsThread;
+	std::mutex m_statsMutex;
+	std::condition_variable m_statsCondition;
+	bool m_isSampling;
+	std::atomic<bool> m_isRetrieving;
+	ESyncMode m_syncMode;
+	double m_toleranceMs;  // -1 = half a frame period
+	double m_frameRate;    // the rate the cameras take images at (see SetFrameRate())
+	guint64 m_tolerance;   // in ns, while grabbing
+	std::thread m_triggerThread;
+	std::atomic<bool> m_isTriggering;
+	vector<std::deque<std::pair<guint64, GstBuffer*>>> m_pendingFrames; // each camera's images waiting for the rest of their set, by capture time in ns
+	vector<bool> m_isCameraRemoved;  // removed cameras are left out of the sets (see match_frames())
+	std::atomic<uint64_t> m_numSetsPushed;
+	std::atomic<uint64_t> m_numFramesUnmatched;
+	void retrieval_loop();
+	void stats_loop();
+	void stop_stats_thread();
+	bool synchronize_clocks();
+	bool configure_action_commands();
+	void trigger_loop();
+	guint64 get_capture_time(GstBuffer *buffer, guint64 deviceTime);
+	void match_frames();
+	void drop_pending_frame(size_t index);
+	void release_pending_frames();
+};
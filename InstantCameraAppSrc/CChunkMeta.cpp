@@ -0,0 +1,140 @@
+/*  CChunkMeta.cpp: Definition file for CChunkMeta.
+    Per-frame acquisition parameters from the camera's chunk data, attached to GStreamer buffers as a GstMeta.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#include "CChunkMeta.h"
+
+static gboolean chunk_meta_init(GstMeta *meta, gpointer params, GstBuffer *buffer)
+{
+	CChunkMeta *pChunkMeta = (CChunkMeta*)meta;
+	pChunkMeta->fields = 0;
+	pChunkMeta->frameCounter = 0;
+	pChunkMeta->timestamp = 0;
+	pChunkMeta->exposureTime = 0;
+	pChunkMeta->gain = 0;
+	pChunkMeta->lineStatus = 0;
+	pChunkMeta->isCrcOk = FALSE;
+	return TRUE;
+}
+
+// The acquisition parameters don't change when the image is copied, converted, rescaled or rotated, so every transform keeps them.
+static gboolean chunk_meta_transform(GstBuffer *destination, GstMeta *meta, GstBuffer *source, GQuark type, gpointer data)
+{
+	CChunkMeta *pSource = (CChunkMeta*)meta;
+	CChunkMeta *pDestination = (CChunkMeta*)gst_buffer_add_meta(destination, CChunkMeta::GetInfo(), NULL);
+	if (pDestination == NULL)
+		return FALSE;
+
+	pDestination->fields = pSource->fields;
+	pDestination->frameCounter = pSource->frameCounter;
+	pDestination->timestamp = pSource->timestamp;
+	pDestination->exposureTime = pSource->exposureTime;
+	pDestination->gain = pSource->gain;
+	pDestination->lineStatus = pSource->lineStatus;
+	pDestination->isCrcOk = pSource->isCrcOk;
+	return TRUE;
+}
+
+GType CChunkMeta::GetApiType()
+{
+	// no tags: the meta doesn't depend on the image's format, size or orientation
+	static const gchar *tags[] = { NULL };
+	static GType type = gst_meta_api_type_register("CChunkMetaAPI", tags);
+	return type;
+}
+
+const GstMetaInfo* CChunkMeta::GetInfo()
+{
+	static const GstMetaInfo *pInfo = gst_meta_register(GetApiType(), "CChunkMeta", sizeof(CChunkMeta),
+		chunk_meta_init, (GstMetaFreeFunction)NULL, chunk_meta_transform);
+	return pInfo;
+}
+
+CChunkMeta* CChunkMeta::Get(GstBuffer *buffer)
+{
+	return (CChunkMeta*)gst_buffer_get_meta(buffer, GetApiType());
+}
+
+CChunkMeta* CChunkMeta::Add(GstBuffer *buffer, const Pylon::CGrabResultPtr &ptrGrabResult)
+{
+	if (ptrGrabResult->IsChunkDataAvailable() == false)
+		return NULL;
+
+	CChunkMeta *pChunkMeta = (CChunkMeta*)gst_buffer_add_meta(buffer, GetInfo(), NULL);
+	if (pChunkMeta == NULL)
+		return NULL;
+
+	// Some features have different names on different interfaces, due to different versions of the GenICam SFNC standard (see CInstantCameraAppSrc::InitCamera()).
+	GenApi::INodeMap &chunks = ptrGrabResult->GetChunkDataNodeMap();
+
+	GenApi::CIntegerPtr ptrFrameCounter = chunks.GetNode("ChunkFramecounter"); // gige
+	if (IsReadable(ptrFrameCounter) == false)
+		ptrFrameCounter = chunks.GetNode("ChunkFrameID"); // BCON and USB use SFNC3 names
+	if (IsReadable(ptrFrameCounter) == false)
+		ptrFrameCounter = chunks.GetNode("ChunkCounterValue");
+	if (IsReadable(ptrFrameCounter))
+	{
+		pChunkMeta->frameCounter = (guint64)ptrFrameCounter->GetValue();
+		pChunkMeta->fields |= Field_FrameCounter;
+	}
+
+	GenApi::CIntegerPtr ptrTimestamp = chunks.GetNode("ChunkTimestamp");
+	if (IsReadable(ptrTimestamp))
+	{
+		pChunkMeta->timestamp = (guint64)ptrTimestamp->GetValue();
+		pChunkMeta->fields |= Field_Timestamp;
+	}
+
+	GenApi::CFloatPtr ptrExposureTime = chunks.GetNode("ChunkExposureTime");
+	if (IsReadable(ptrExposureTime))
+	{
+		pChunkMeta->exposureTime = ptrExposureTime->GetValue();
+		pChunkMeta->fields |= Field_ExposureTime;
+	}
+
+	GenApi::CFloatPtr ptrGain = chunks.GetNode("ChunkGain");
+	GenApi::CIntegerPtr ptrGainAll = chunks.GetNode("ChunkGainAll"); // gige reports raw gain
+	if (IsReadable(ptrGain))
+	{
+		pChunkMeta->gain = ptrGain->GetValue();
+		pChunkMeta->fields |= Field_Gain;
+	}
+	else if (IsReadable(ptrGainAll))
+	{
+		pChunkMeta->gain = (gdouble)ptrGainAll->GetValue();
+		pChunkMeta->fields |= Field_Gain;
+	}
+
+	GenApi::CIntegerPtr ptrLineStatus = chunks.GetNode("ChunkLineStatusAll");
+	if (IsReadable(ptrLineStatus))
+	{
+		pChunkMeta->lineStatus = (guint32)ptrLineStatus->GetValue();
+		pChunkMeta->fields |= Field_LineStatus;
+	}
+
+	if (ptrGrabResult->HasCRC() == true)
+	{
+		pChunkMeta->isCrcOk = ptrGrabResult->CheckCRC() ? TRUE : FALSE;
+		pChunkMeta->fields |= Field_Crc;
+	}
+
+	return pChunkMeta;
+}
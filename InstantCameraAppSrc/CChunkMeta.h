@@ -0,0 +1,63 @@
+/*  CChunkMeta.h: header file for CChunkMeta.
+    Per-frame acquisition parameters from the camera's chunk data, attached to GStreamer buffers as a GstMeta.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#pragma once
+
+#include <pylon/PylonIncludes.h>
+#include <gst/gst.h>
+
+// ******* CChunkMeta *******
+// The camera can append "chunks" to each image: its frame counter, timestamp, exposure time, gain, I/O line status and a CRC of the image.
+// CInstantCameraAppSrc decodes them once per image (see SetChunkData()) and attaches them to the pushed buffer as this GstMeta.
+// Downstream elements, pad probes and appsinks then read them with CChunkMeta::Get(buffer), without touching the camera's node map.
+// The meta has no tags, so it stays on the buffer through videoconvert, videoscale and videoflip.
+struct CChunkMeta
+{
+	// Which of the fields below the camera sent
+	enum EField
+	{
+		Field_FrameCounter = 1 << 0,
+		Field_Timestamp = 1 << 1,
+		Field_ExposureTime = 1 << 2,
+		Field_Gain = 1 << 3,
+		Field_LineStatus = 1 << 4,
+		Field_Crc = 1 << 5
+	};
+
+	GstMeta meta;
+	guint fields;          // EField flags
+	guint64 frameCounter;  // counts every image the camera took, so gaps show lost images
+	guint64 timestamp;     // camera clock ticks at the start of exposure
+	gdouble exposureTime;  // us
+	gdouble gain;          // dB, or raw gain units on cameras that only report those
+	guint32 lineStatus;    // one bit per I/O line
+	gboolean isCrcOk;      // the image arrived as the camera sent it
+
+	bool Has(EField field) const { return (fields & field) != 0; }
+
+	// Decode the chunks of a grab result into a new meta on buffer. Returns NULL if the grab result has no chunk data.
+	static CChunkMeta* Add(GstBuffer *buffer, const Pylon::CGrabResultPtr &ptrGrabResult);
+	static CChunkMeta* Get(GstBuffer *buffer);
+
+	static GType GetApiType();
+	static const GstMetaInfo* GetInfo();
+};
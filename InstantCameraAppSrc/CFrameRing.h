@@ -0,0 +1,136 @@
+/*  CFrameRing.h: header file for CFrameRing Class.
+    A bounded single-producer/single-consumer ring used to hand images from the acquisition thread to the pipeline.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// ******* CFrameRing *******
+// Exactly one thread may call Push() and exactly one other thread may call Pop().
+// Push() and Pop() don't take a lock unless the other side is sleeping in one of the Wait functions.
+template <typename T>
+class CFrameRing
+{
+public:
+	CFrameRing(size_t capacity = 1)
+		: m_slots(capacity < 1 ? 1 : capacity), m_head(0), m_tail(0), m_numWaiting(0)
+	{
+	}
+
+	// Only call while neither side is using the ring.
+	void Reset(size_t capacity)
+	{
+		m_slots.assign(capacity < 1 ? 1 : capacity, T());
+		m_head.store(0);
+		m_tail.store(0);
+	}
+
+	size_t Capacity() const
+	{
+		return m_slots.size();
+	}
+
+	size_t Size() const
+	{
+		return m_tail.load() - m_head.load();
+	}
+
+	// Producer side. Returns false if the ring is full.
+	bool Push(const T &item)
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == m_slots.size())
+			return false;
+
+		m_slots[tail % m_slots.size()] = item;
+		m_tail.store(tail + 1);
+		notify();
+		return true;
+	}
+
+	// Consumer side. Returns false if the ring is empty.
+	bool Pop(T &item)
+	{
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+			return false;
+
+		item = m_slots[head % m_slots.size()];
+		m_head.store(head + 1);
+		notify();
+		return true;
+	}
+
+	// Consumer side. Sleep until an item is available or the timeout expires.
+	bool WaitForItem(unsigned int timeoutMs)
+	{
+		return wait(timeoutMs, [this] { return Size() > 0; });
+	}
+
+	// Producer side. Sleep until a slot is free or the timeout expires.
+	bool WaitForSpace(unsigned int timeoutMs)
+	{
+		return wait(timeoutMs, [this] { return Size() < m_slots.size(); });
+	}
+
+	// Wake up a side that is waiting, eg: so it can notice it should stop.
+	void Interrupt()
+	{
+		notify();
+	}
+
+private:
+	std::vector<T> m_slots;
+	// head and tail are published with sequentially consistent stores, so that a waiter and a notifier can't both miss each other (see notify()).
+	std::atomic<size_t> m_head; // next slot to pop. Only written by the consumer.
+	std::atomic<size_t> m_tail; // next slot to push. Only written by the producer.
+	std::atomic<int> m_numWaiting;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+
+	template <typename Predicate>
+	bool wait(unsigned int timeoutMs, Predicate ready)
+	{
+		// announce the waiter before checking, so a Push() or Pop() that we miss is guaranteed to see us and notify.
+		m_numWaiting.fetch_add(1);
+		std::unique_lock<std::mutex> lock(m_mutex);
+		bool isReady = m_condition.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready);
+		m_numWaiting.fetch_sub(1);
+		return isReady;
+	}
+
+	// The mutex is only taken when someone is waiting, to close the gap between the waiter checking its condition and going to sleep.
+	void notify()
+	{
+		if (m_numWaiting.load() == 0)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+		}
+		m_condition.notify_all();
+	}
+};
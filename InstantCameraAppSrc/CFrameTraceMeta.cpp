@@ -0,0 +1,88 @@
+/*  CFrameTraceMeta.cpp: Definition file for CFrameTraceMeta.
+    When an image passed each stage on its way from the camera to the pipeline, attached to GStreamer buffers as a GstMeta.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#include "CFrameTraceMeta.h"
+
+static gboolean frame_trace_meta_init(GstMeta *meta, gpointer params, GstBuffer *buffer)
+{
+	CFrameTraceMeta *pTrace = (CFrameTraceMeta*)meta;
+	pTrace->exposureTime = GST_CLOCK_TIME_NONE;
+	pTrace->retrievedTime = GST_CLOCK_TIME_NONE;
+	pTrace->convertedTime = GST_CLOCK_TIME_NONE;
+	pTrace->pushedTime = GST_CLOCK_TIME_NONE;
+	return TRUE;
+}
+
+// The image is still the same image after it is copied, converted, rescaled or rotated, so every transform keeps its trace.
+static gboolean frame_trace_meta_transform(GstBuffer *destination, GstMeta *meta, GstBuffer *source, GQuark type, gpointer data)
+{
+	CFrameTraceMeta *pSource = (CFrameTraceMeta*)meta;
+	CFrameTraceMeta *pDestination = (CFrameTraceMeta*)gst_buffer_add_meta(destination, CFrameTraceMeta::GetInfo(), NULL);
+	if (pDestination == NULL)
+		return FALSE;
+
+	pDestination->exposureTime = pSource->exposureTime;
+	pDestination->retrievedTime = pSource->retrievedTime;
+	pDestination->convertedTime = pSource->convertedTime;
+	pDestination->pushedTime = pSource->pushedTime;
+	return TRUE;
+}
+
+GType CFrameTraceMeta::GetApiType()
+{
+	// no tags: the meta doesn't depend on the image's format, size or orientation
+	static const gchar *tags[] = { NULL };
+	static GType type = gst_meta_api_type_register("CFrameTraceMetaAPI", tags);
+	return type;
+}
+
+const GstMetaInfo* CFrameTraceMeta::GetInfo()
+{
+	static const GstMetaInfo *pInfo = gst_meta_register(GetApiType(), "CFrameTraceMeta", sizeof(CFrameTraceMeta),
+		frame_trace_meta_init, (GstMetaFreeFunction)NULL, frame_trace_meta_transform);
+	return pInfo;
+}
+
+CFrameTraceMeta* CFrameTraceMeta::Get(GstBuffer *buffer)
+{
+	return (CFrameTraceMeta*)gst_buffer_get_meta(buffer, GetApiType());
+}
+
+CFrameTraceMeta* CFrameTraceMeta::Add(GstBuffer *buffer, GstClockTime exposureTime, GstClockTime retrievedTime, GstClockTime convertedTime)
+{
+	CFrameTraceMeta *pTrace = (CFrameTraceMeta*)gst_buffer_add_meta(buffer, GetInfo(), NULL);
+	if (pTrace == NULL)
+		return NULL;
+
+	pTrace->exposureTime = exposureTime;
+	pTrace->retrievedTime = retrievedTime;
+	pTrace->convertedTime = convertedTime;
+	return pTrace;
+}
+
+// Take the trace off a buffer that doesn't hold a new image (ie: a repeat of the last one), so it isn't counted twice
+void CFrameTraceMeta::Remove(GstBuffer *buffer)
+{
+	CFrameTraceMeta *pTrace = Get(buffer);
+	if (pTrace != NULL)
+		gst_buffer_remove_meta(buffer, (GstMeta*)pTrace);
+}
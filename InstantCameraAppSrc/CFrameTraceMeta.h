@@ -0,0 +1,45 @@
+/*  CFrameTraceMeta.h: header file for CFrameTraceMeta.
+    When an image passed each stage on its way from the camera to the pipeline, attached to GStreamer buffers as a GstMeta.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#pragma once
+
+#include <gst/gst.h>
+
+// ******* CFrameTraceMeta *******
+// With SetLatencyTracing(), CInstantCameraAppSrc stamps each new image with the pipeline clock's time at each stage of the acquisition path.
+// A pad probe at the sink compares them with the time the image arrives there (see CLatencyTracer and CPipelineHelper::trace_latency()).
+// All times are pipeline clock times, or GST_CLOCK_TIME_NONE for a stage the image didn't pass (ie: no hardware timestamps, no exposure time).
+struct CFrameTraceMeta
+{
+	GstMeta meta;
+	GstClockTime exposureTime;   // the camera started exposing the image (with hardware timestamps, see SetHardwareTimestamps())
+	GstClockTime retrievedTime;  // RetrieveResult() returned the image
+	GstClockTime convertedTime;  // the image was converted (or copied, or wrapped) into the buffer
+	GstClockTime pushedTime;     // the buffer was pushed to AppSrc
+
+	static CFrameTraceMeta* Add(GstBuffer *buffer, GstClockTime exposureTime, GstClockTime retrievedTime, GstClockTime convertedTime);
+	static CFrameTraceMeta* Get(GstBuffer *buffer);
+	static void Remove(GstBuffer *buffer);
+
+	static GType GetApiType();
+	static const GstMetaInfo* GetInfo();
+};
@@ -0,0 +1,81 @@
+/*  CGstBufferFactory.cpp: Definition file for CGstBufferFactory Class.
+    A Pylon buffer factory that lets the driver grab directly into GStreamer memory.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#include "CGstBufferFactory.h"
+#include <new>
+
+// allocator: the GStreamer allocator to take memory from. NULL = GStreamer's default system memory allocator.
+CGstBufferFactory::CGstBufferFactory(GstAllocator *allocator)
+{
+	m_allocator = (allocator != NULL) ? (GstAllocator*)gst_object_ref(allocator) : NULL;
+
+	// Align the buffers to cache lines, like the frame buffer pool does.
+	gst_allocation_params_init(&m_params);
+	m_params.align = 63;
+}
+
+CGstBufferFactory::~CGstBufferFactory()
+{
+	if (m_allocator != NULL)
+		gst_object_unref(m_allocator);
+}
+
+// Called by the Grab Engine for each of its buffers (MaxNumBuffer) when grabbing starts.
+void CGstBufferFactory::AllocateBuffer(size_t bufferSize, void** pCreatedBuffer, intptr_t& bufferContext)
+{
+	GstMemory *memory = gst_allocator_alloc(m_allocator, bufferSize, &m_params);
+	if (memory == NULL)
+		throw std::bad_alloc();
+
+	// The driver needs a plain pointer to write into. Memory from a GStreamer allocator stays at the same address for its whole life,
+	// so we can map it once to learn the address and unmap it again. This leaves the memory unlocked for the pipeline to map later.
+	GstMapInfo map;
+	if (gst_memory_map(memory, &map, GST_MAP_WRITE) == FALSE)
+	{
+		gst_memory_unref(memory);
+		throw std::bad_alloc();
+	}
+	*pCreatedBuffer = map.data;
+	gst_memory_unmap(memory, &map);
+
+	// the buffer context is how we find the GstMemory again from a grab result.
+	bufferContext = (intptr_t)memory;
+}
+
+// Called by the Grab Engine when it no longer needs a buffer.
+// Memory still held by the pipeline (see GetMemory()) stays alive until the pipeline releases it.
+void CGstBufferFactory::FreeBuffer(void* pCreatedBuffer, intptr_t bufferContext)
+{
+	gst_memory_unref((GstMemory*)bufferContext);
+}
+
+// Called by the camera when it is done with the factory (see Cleanup_Delete)
+void CGstBufferFactory::DestroyBufferFactory()
+{
+	delete this;
+}
+
+// The GstMemory of a grab result's buffer. Pass CGrabResultPtr::GetBufferContext().
+GstMemory* CGstBufferFactory::GetMemory(intptr_t bufferContext)
+{
+	return (GstMemory*)bufferContext;
+}
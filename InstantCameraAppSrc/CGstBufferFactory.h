@@ -0,0 +1,48 @@
+/*  CGstBufferFactory.h: header file for CGstBufferFactory Class.
+    A Pylon buffer factory that lets the driver grab directly into GStreamer memory.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#pragma once
+
+#include <pylon/PylonIncludes.h>
+#include <gst/gst.h>
+
+// ******* CGstBufferFactory *******
+// The Grab Engine asks the buffer factory for the buffers it grabs into. This one hands out GstMemory blocks from a GStreamer allocator.
+// A grab result's buffer context then leads back to its GstMemory (GetMemory()), which can be pushed downstream without a copy.
+// Install it with CInstantCamera::SetBufferFactory(new CGstBufferFactory(), Cleanup_Delete) before grabbing starts.
+class CGstBufferFactory : public Pylon::IBufferFactory
+{
+public:
+	CGstBufferFactory(GstAllocator *allocator = NULL);
+	virtual ~CGstBufferFactory();
+
+	// Pylon::IBufferFactory
+	virtual void AllocateBuffer(size_t bufferSize, void** pCreatedBuffer, intptr_t& bufferContext);
+	virtual void FreeBuffer(void* pCreatedBuffer, intptr_t bufferContext);
+	virtual void DestroyBufferFactory();
+
+	static GstMemory* GetMemory(intptr_t bufferContext);
+
+private:
+	GstAllocator* m_allocator;
+	GstAllocationParams m_params;
+};
@@ -29,8 +29,8 @@
 	|                                                                         |                                                  |    | elements |    |               |
 	|                                    RetrieveImage()<---cb_need_data()<---------"need-data" signal                           |    |          |    |               |
 	|            ------------------> --> 1. RetrieveResult()                  |                                                  |    |          |    |               |
-	|            | LatestImageOnly |     2. Convert to RGB if color           |                                                  |    |          |    |               |
-	|            <------------------     3. Put into a [pylonimage]           | +-------------+ +------------+ +------------+    |    |          |    |               |
+	|            | LatestImageOnly |     2. Convert to YUV/RGB if color       |                                                  |    |          |    |               |
+	|            <------------------     3. Put into a pooled frame buffer    | +-------------+ +------------+ +------------+    |    |          |    |               |
 	| [Camera]-->[Pylon Grab Engine]     4. Wrap in a gst buffer              | |             | |            | |            |    |    |          |    |               |
 	| -------->                          5. "push-buffer" signal-------------------->AppSrc-------->Rescale------->Rotate------>src--sink       src--sink             |
 	| |freerun|                                                               | |             | |            | |            |    |    |          |    |               |
@@ -46,17 +46,48 @@
 	GetFrameRate()
 
 	1. The camera and grab engine in this case are always freerunning (unless ondemand is used, then it sits idle and sends a trigger when an image is needed)
-	2. LatestImageOnly strategy means the Grab Engine keeps the latest image received ready for retrieval.
+	2. LatestImageOnly strategy (the default) means the Grab Engine keeps the latest image received ready for retrieval.
+	   Recording pipelines can choose OneByOne, LatestImages or UpcomingImage in InitCamera() instead (see configure_grab_buffers()).
 	3. When AppSrc needs data, it sends the "need-data" signal.
 	4. This fires cb_need_data which calls RetrieveImage().
-	5. RetrieveImage() retrieves the image from the Grab Engine, converts it to RGB, and places it in a PylonImage container.
-	6. The memory of the PylonImage container is then wrapped and pushed to AppSrc's src pad by sending the "push-buffer" signal.
+	5. RetrieveImage() retrieves the image from the Grab Engine, converts it if color, and places it in a frame buffer taken from a pool.
+	   8-bit Bayer images are demosaiced straight to I420 (or NV12) with our own SIMD kernels (see CPixelKernels). Other color images are converted to RGB by Pylon.
+	   With SetRawBayer(), Bayer images are not converted at all and leave the bin as video/x-bayer.
+	   YUV 4:2:2 images (UYVY, YUY2, Y42B) are never converted.
+	   The conversion is split into row stripes that are converted in parallel on a pool of worker threads (see CStripedConverter).
+	6. The frame buffer is stamped with the camera's capture time (see timestamp_buffer()) and pushed to AppSrc's src pad by sending the "push-buffer" signal.
+	   It returns to the pool when the pipeline is done with it.
+	   With SetChunkData(), the camera's chunk data is decoded once and attached to the buffer as a CChunkMeta.
+	   With SetLatencyTracing(), the times the image passed each stage are attached too, as a CFrameTraceMeta (see CLatencyTracer).
+	   Skipped, lost, failed, incomplete and repeated images are counted per camera, and posted on the bus as "camera-frame-stats" messages (see post_frame_stats()).
+	   A background thread samples these counts and the stream grabber statistics, and publishes them on the bus and to a Prometheus metrics file (see SetStatsInterval()).
 	7. AppSrc provides the image to the rescaler element, which then pushes it to image rotation element.
-	8. AppSrc, rescaler, and rotator elements are binned together into sourceBin.
+	   8-bit Bayer (as I420) and mono images are rescaled and rotated on the host instead, right after they are converted (see SetFusedTransform() and CScaleRotate).
+	   Downscaling by a factor of 2 or more starts on the camera, with binning or decimation (see SetCameraBinning()). Only the rest is rescaled on the host.
+	   Flips (see SetFlip()) and 180 degree rotation are done by the camera's ReverseX and ReverseY where available (see configure_reverse()).
+	8. AppSrc, and only the converter, rescaler, and rotator elements the images need, are binned together into sourceBin.
+	   Without rescaling, rotation or a format change, sourceBin holds only AppSrc.
 	9. The output of sourceBin (it's src pad) is then the input to the rest of the pipeline
+
+	Push mode (SetPushMode()):
+	Instead of retrieving on "need-data", an acquisition thread retrieves and converts images as they arrive and hands them through a lock-free ring
+	to a delivery thread, which pushes them to AppSrc. Acquisition and the rest of the pipeline then run at the same time on different cores.
+
+	Live reconfiguration (Reconfigure()):
+	The AOI, pixel format and frame rate can change while the pipeline runs. Grabbing stops briefly, the frame buffers are resized,
+	and new caps on AppSrc make the rest of the pipeline renegotiate, instead of tearing it down and reopening the camera.
+
+	Digital pan and zoom (SetRegion(), HandleBusMessage()):
+	The AOI moves over the sensor while streaming, and can be resized through Reconfigure(). The application can also post "camera-region" messages on the bus.
 	*/
 
 #include "CInstantCameraAppSrc.h"
+#include "CBandwidthPlanner.h"
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <cstdio>
 
 using namespace Pylon;
 using namespace GenApi;
@@ -65,16 +96,104 @@ using namespace std;
 // Here we extend the Pylon CInstantCamera class with a few things to make it easier to integrate with Appsrc.
 CInstantCameraAppSrc::CInstantCameraAppSrc(string serialnumber)
 {
-	// initialize Pylon runtime
+	initialize(serialnumber, NULL);
+}
+
+// Use a camera that was already enumerated (ie: by CCameraArrayAppSrc), without enumerating the devices again.
+CInstantCameraAppSrc::CInstantCameraAppSrc(const Pylon::CDeviceInfo &deviceInfo)
+{
+	initialize(deviceInfo.GetSerialNumber().c_str(), &deviceInfo);
+}
+
+void CInstantCameraAppSrc::initialize(string serialnumber, const Pylon::CDeviceInfo *pDeviceInfo)
+{
+	// initialize Pylon runtime (Pylon counts the calls, so cameras sharing the runtime just add to the count)
 	Pylon::PylonInitialize();
 
 	m_serialNumber = serialnumber;
 	m_isOpen = false;
+	m_isInitialized = false;
+	m_isZeroCopy = false;
+	m_isGstBufferFactory = false;
+	m_numConversionStripes = 0;
+	m_pWorkerPool = NULL;
+	m_ownsWorkerPool = false;
+	m_bufferPoolDepth = 8;
+	m_isHardwareTimestamped = true;
+	m_isLowLatency = false;
+	m_isLatencyTraced = false;
+	m_captureLatency = 0;
+	m_minLatency = 0;
+	m_maxLatency = GST_CLOCK_TIME_NONE;
+	m_lastPts = GST_CLOCK_TIME_NONE;
+	m_frameRateNum = 0;
+	m_frameRateDen = 1;
+	m_isPushMode = false;
+	m_isExternalRetrieval = false;
+	m_triggerSource = "Line1";
+	m_tickFrequency = 1e9;
+	m_lastDeviceTime = 0;
+	m_ringDepth = 4;
+	m_dropPolicy = DropPolicy_Wait;
+	m_appsrcMaxBytes = 0;
+	m_appsrcBlock = true;
+	m_grabStrategy = Pylon::GrabStrategy_LatestImageOnly;
+	m_numGrabBuffers = -1;
+	m_numFramesGrabbed = 0;
+	m_numFramesPushed = 0;
+	m_numFramesDropped = 0;
+	m_numFramesSkipped = 0;
+	m_numFramesLost = 0;
+	m_numFramesFailed = 0;
+	m_numFramesIncomplete = 0;
+	m_numFramesDuplicated = 0;
+	m_lastBlockId = UINT64_MAX;
+	m_lastFrameCounter = UINT64_MAX;
+	m_numFramesUncounted = 0;
+	m_statsIntervalMs = 1000;
+	m_metricsFile = "";
+	m_isSampling = false;
+	m_isPushing = false;
+	m_frameSize = 0;
+	m_pixelType = Pylon::PixelType_Undefined;
+	m_cameraPixelType = Pylon::PixelType_Undefined;
+	m_isBayerToYuv = true;
+	m_isNV12 = false;
+	m_isRawBayer = false;
+	m_isMsbAligned = false;
+	m_isFusedTransform = true;
+	m_isCameraBinning = true;
+	m_isCameraBinned = false;
+	m_isFlippedX = false;
+	m_isFlippedY = false;
+	m_isChunkData = false;
+	m_isChunkModeActive = false;
+	m_isCameraReversedX = false;
+	m_isCameraReversedY = false;
+	m_isHostFlippedX = false;
+	m_isHostFlippedY = false;
+	m_hostRotation = 0;
+	m_rotation = -1;
+	m_scaledWidth = -1;
+	m_scaledHeight = -1;
+	m_isTransforming = false;
+	m_offsetX = -1;
+	m_offsetY = -1;
+	m_binHasConverter = false;
+	m_binHasRescaler = false;
+	m_binHasRotator = false;
+	m_binIsRawBayer = false;
+	m_appsrc = NULL;
+	m_sourceBin = NULL;
+	m_bufferPool = NULL;
+	m_lastBuffer = NULL;
 
 	try
 	{
 		// use the first camera device found. You can also populate a CDeviceInfo object with information like serial number, etc. to choose a specific camera
-		if (m_serialNumber == "")
+		if (pDeviceInfo != NULL)
+			Attach(CTlFactory::GetInstance().CreateDevice(*pDeviceInfo));
+		else if (m_serialNumber == "")
 			Attach(CTlFactory::GetInstance().CreateFirstDevice());
 		else
 		{
@@ -99,6 +218,11 @@ CInstantCameraAppSrc::CInstantCameraAppSrc(string serialnumber)
 
 CInstantCameraAppSrc::~CInstantCameraAppSrc()
 {
+	stop_push_threads();
+	stop_stats_thread();
+	destroy_buffer_pool();
+	if (m_ownsWorkerPool == true)
+		delete m_pWorkerPool;
 	CloseCamera();
 	// free resources allocated by pylon runtime.
 	Pylon::PylonTerminate();
@@ -160,8 +284,427 @@ bool CInstantCameraAppSrc::SetFrameRate(double framesPerSecond)
 	}
 }
 
+// Push the grab result buffers themselves into the pipeline instead of copying each image into a pooled buffer.
+// Only images that already have the pipeline's pixel format (mono or RGB) can be pushed this way. Others are still converted.
+// Note: Each buffer travelling through the pipeline holds on to one of the Pylon Grab Engine's buffers until the pipeline is done with it.
+//       If the pipeline holds many buffers (eg: queues), consider increasing the camera's MaxNumBuffer.
+bool CInstantCameraAppSrc::SetZeroCopy(bool useZeroCopy)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change zero-copy mode while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+
+	m_isZeroCopy = useZeroCopy;
+	return true;
+}
+
+// Split the color conversion of each image into numStripes row stripes, which are converted in parallel. 0 = one stripe per core.
+// pWorkerPool: threads to convert on, eg: shared by several cameras. NULL = the camera starts its own pool (numStripes - 1 threads plus the calling thread).
+bool CInstantCameraAppSrc::SetConversionStripes(int numStripes, CWorkerPool *pWorkerPool)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change conversion stripes while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+	if (numStripes < 0)
+	{
+		cout << "Number of stripes must be 0 (one per core) or more." << endl;
+		return false;
+	}
+
+	if (m_ownsWorkerPool == true)
+		delete m_pWorkerPool;
+	m_pWorkerPool = pWorkerPool;
+	m_ownsWorkerPool = false;
+	m_numConversionStripes = numStripes;
+	return true;
+}
+
+// Demosaic 8-bit Bayer images straight into I420 (or NV12 if useNV12) instead of converting them to RGB first, which videoconvert would then convert to I420.
+// The source bin then outputs that format. Other color formats and odd image sizes are still converted to RGB.
+bool CInstantCameraAppSrc::SetBayerToYuv(bool useBayerToYuv, bool useNV12)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change the Bayer conversion while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+
+	m_isBayerToYuv = useBayerToYuv;
+	m_isNV12 = useNV12;
+	return true;
+}
+
+// Push Bayer images as they are, with video/x-bayer caps (eg: rggb, rggb12le), instead of converting them on the host.
+// Downstream can then demosaic after cropping or scaling (eg: bayer2rgb), or record the raw images at a third of the size of RGB.
+// The source bin can't rescale or rotate Bayer images. Packed Bayer formats (eg: BayerRG12p) are unpacked to 16 bits per pixel (eg: rggb12le).
+// Best run before InitCamera(), which picks the camera's binning for the output. Run later, it picks the binning again.
+bool CInstantCameraAppSrc::SetRawBayer(bool useRawBayer)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change the Bayer output while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+
+	try
+	{
+		// color cameras don't bin for raw Bayer output (see configure_binning())
+		m_isRawBayer = useRawBayer;
+		if (m_isInitialized == true)
+			configure_binning();
+		return true;
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in SetRawBayer(): " << endl << e.GetDescription() << endl;
+		return false;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in SetRawBayer(): " << endl << e.what() << endl;
+		return false;
+	}
+}
+
+// Shift 10 and 12-bit images into the upper bits of their 16-bit pixels (eg: 12-bit 0..4095 -> 0..65520).
+// GRAY16_LE consumers (eg: display) then see the full brightness range. Such images can't be pushed zero-copy.
+bool CInstantCameraAppSrc::SetMsbAligned(bool useMsbAlignment)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change MSB alignment while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+
+	m_isMsbAligned = useMsbAlignment;
+	return true;
+}
+
+// Rescale and rotate images on the host, right after converting them, instead of with videoscale and videoflip in the source bin (see CScaleRotate).
+// The source bin then is just the AppSrc, which pushes images at their final size. This saves converting, scaling and flipping the whole image in
+// separate elements, each with its own pass over memory. It applies to 8-bit Bayer demosaiced to I420, and to 8 and 16-bit mono. Others still use the elements.
+bool CInstantCameraAppSrc::SetFusedTransform(bool useFusedTransform)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change the host transform while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+
+	m_isFusedTransform = useFusedTransform;
+	return true;
+}
+
+// Bin (or, on mono cameras, decimate) on the camera when images are rescaled down by a factor of 2 or more, instead of grabbing full resolution
+// and rescaling it all on the host. Fewer pixels then cross the link, the host processes less, and the camera often reaches a higher frame rate.
+// The host only rescales what is left (see SetFusedTransform()). On by default. Takes effect right away when the camera is initialized, so run it before GetSource().
+bool CInstantCameraAppSrc::SetCameraBinning(bool useCameraBinning)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change camera binning while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+
+	try
+	{
+		m_isCameraBinning = useCameraBinning;
+		if (m_isInitialized == true)
+			configure_binning();
+		return true;
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in SetCameraBinning(): " << endl << e.GetDescription() << endl;
+		return false;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in SetCameraBinning(): " << endl << e.what() << endl;
+		return false;
+	}
+}
+
+// Mirror the images horizontally (flipX) and/or vertically (flipY), before any rotation. The camera does it where it can (see configure_reverse()).
+// Takes effect right away when the camera is initialized, so run it before GetSource().
+bool CInstantCameraAppSrc::SetFlip(bool flipX, bool flipY)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change flipping while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+
+	try
+	{
+		m_isFlippedX = flipX;
+		m_isFlippedY = flipY;
+		if (m_isInitialized == true)
+			configure_reverse();
+		return true;
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in SetFlip(): " << endl << e.GetDescription() << endl;
+		return false;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in SetFlip(): " << endl << e.what() << endl;
+		return false;
+	}
+}
+
+// Let the Grab Engine grab directly into GStreamer memory from allocator (NULL = GStreamer's default system memory), see CGstBufferFactory.
+// Images that need no conversion are then pushed downstream as that memory, without any copy and without wrapping foreign memory.
+// Like zero-copy mode, each buffer in the pipeline holds on to one of the Grab Engine's buffers until the pipeline is done with it.
+bool CInstantCameraAppSrc::SetGstBufferFactory(bool useGstBufferFactory, GstAllocator *allocator)
+{
+	try
+	{
+		if (IsGrabbing() == true)
+		{
+			cout << "Cannot change the buffer factory while grabbing. Run StopCamera() first." << endl;
+			return false;
+		}
+
+		// The camera deletes our factory when it no longer needs it. NULL returns to Pylon's own buffer factory.
+		if (useGstBufferFactory == true)
+			SetBufferFactory(new CGstBufferFactory(allocator), Pylon::Cleanup_Delete);
+		else
+			SetBufferFactory(NULL, Pylon::Cleanup_None);
+
+		m_isGstBufferFactory = useGstBufferFactory;
+		return true;
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in SetGstBufferFactory(): " << endl << e.GetDescription() << endl;
+		return false;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in SetGstBufferFactory(): " << endl << e.what() << endl;
+		return false;
+	}
+}
+
+// Set how many frame buffers are preallocated for converted and copied images.
+// Each image pushed to the pipeline occupies one buffer until the pipeline is done with it, so the next image never overwrites one still in use.
+// If the pipeline holds on to more buffers than this (eg: encoders with lookahead), the pool allocates more and keeps them for reuse.
+bool CInstantCameraAppSrc::SetBufferPoolDepth(int numBuffers)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change buffer pool depth while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+	if (numBuffers < 1)
+	{
+		cout << "Buffer pool depth must be at least 1." << endl;
+		return false;
+	}
+
+	m_bufferPoolDepth = numBuffers;
+	return true;
+}
+
+// Use the camera's timestamp of each image (the moment it was captured) as the buffer's presentation timestamp.
+// If false, AppSrc timestamps each image when it is pushed (after any transfer, retrieval and conversion delay).
+bool CInstantCameraAppSrc::SetHardwareTimestamps(bool useHardwareTimestamps)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change timestamping while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+
+	m_isHardwareTimestamped = useHardwareTimestamps;
+	return true;
+}
+
+// Turn on the camera's chunk data (frame counter, timestamp, exposure time, gain, I/O line status, CRC), and attach it to each pushed buffer as a CChunkMeta.
+// The chunks are decoded once per image, so downstream can read each image's acquisition parameters without querying the camera from the streaming thread.
+bool CInstantCameraAppSrc::SetChunkData(bool useChunkData)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change chunk data while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+
+	m_isChunkData = useChunkData;
+	return true;
+}
+
+// Keep as little as possible between the camera and the pipeline, for live displays and teleoperation.
+// Retrieval waits at most two frame periods (then the last good image is repeated), and in push mode AppSrc queues only one image.
+bool CInstantCameraAppSrc::SetLowLatency(bool useLowLatency)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change low-latency mode while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+
+	m_isLowLatency = useLowLatency;
+	return true;
+}
+
+// Stamp each new image with the time it passed each stage from the camera to AppSrc, as a CFrameTraceMeta.
+// A CLatencyTracer at the sink turns these into latency histograms per stage (see CPipelineHelper::trace_latency()).
+bool CInstantCameraAppSrc::SetLatencyTracing(bool useLatencyTracing)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change latency tracing while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+
+	m_isLatencyTraced = useLatencyTracing;
+	return true;
+}
+
+// Push images to the pipeline from our own threads as they arrive, instead of retrieving them when AppSrc asks for data.
+// ringDepth: how many converted images may wait between the acquisition thread and the delivery thread.
+// dropPolicy: what the acquisition thread does when the ring is full.
+// appsrcMaxBytes: how many bytes AppSrc may queue before it is considered full. 0 = one frame per ring slot.
+// appsrcBlock: if true, the delivery thread waits when AppSrc is full, so the ring fills up and the drop policy applies.
+//              if false, AppSrc queues images beyond appsrcMaxBytes.
+bool CInstantCameraAppSrc::SetPushMode(bool usePushMode, int ringDepth, EDropPolicy dropPolicy, guint64 appsrcMaxBytes, bool appsrcBlock)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change push mode while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+	if (ringDepth < 1)
+	{
+		cout << "Ring depth must be at least 1." << endl;
+		return false;
+	}
+
+	m_isPushMode = usePushMode;
+	m_ringDepth = ringDepth;
+	m_dropPolicy = dropPolicy;
+	m_appsrcMaxBytes = appsrcMaxBytes;
+	m_appsrcBlock = appsrcBlock;
+	return true;
+}
+
+// Let the application retrieve the images with PushImage(), instead of need-data or our own push mode threads.
+// CCameraArrayAppSrc uses this to retrieve the images of many cameras on one shared pool of threads.
+// AppSrc then never blocks: when it already holds appsrcMaxBytes (see SetPushMode()), the new image is dropped, so a slow pipeline doesn't hold up the other cameras.
+bool CInstantCameraAppSrc::SetExternalRetrieval(bool useExternalRetrieval)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change external retrieval while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+
+	m_isExternalRetrieval = useExternalRetrieval;
+	return true;
+}
+
+// The signal a triggered camera (see InitCamera(useTrigger)) takes its images on: ie: "Line1" (default), "Line3", or "Action1" for GigE action commands.
+// Run before InitCamera().
+bool CInstantCameraAppSrc::SetTriggerSource(string triggerSource)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change trigger source while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+
+	m_triggerSource = triggerSource;
+	return true;
+}
+
+// How often the frame counts and stream grabber statistics are published while grabbing (see publish_stats()). 0 publishes them only once, when the camera stops.
+// metricsFile: if set, the statistics are also written to this file in the Prometheus text format (ie: for node_exporter's textfile collector).
+//              Give each camera its own file (ie: /var/lib/node_exporter/camera_<serial>.prom), as each camera rewrites the whole file.
+bool CInstantCameraAppSrc::SetStatsInterval(int intervalMs, string metricsFile)
+{
+	if (IsGrabbing() == true)
+	{
+		cout << "Cannot change stats interval while grabbing. Run StopCamera() first." << endl;
+		return false;
+	}
+	if (intervalMs < 0)
+	{
+		cout << "Stats interval cannot be negative." << endl;
+		return false;
+	}
+
+	m_statsIntervalMs = intervalMs;
+	m_metricsFile = metricsFile;
+	return true;
+}
+
+// Publish the frame counts and stream grabber statistics now (see publish_stats()).
+// With SetStatsInterval(0), an application sampling many cameras from one thread of its own calls this instead (see CCameraArrayAppSrc).
+void CInstantCameraAppSrc::PublishStats()
+{
+	publish_stats();
+}
+
+// How many images were successfully retrieved from the Grab Engine since StartCamera()
+uint64_t CInstantCameraAppSrc::GetNumFramesGrabbed()
+{
+	return m_numFramesGrabbed;
+}
+
+// How many new images were pushed to the pipeline since StartCamera() (repeats of the last good image are not counted)
+uint64_t CInstantCameraAppSrc::GetNumFramesPushed()
+{
+	return m_numFramesPushed;
+}
+
+// How many images were thrown away since StartCamera(): skipped by the Grab Engine (LatestImageOnly, LatestImages), or dropped by a full push mode ring.
+uint64_t CInstantCameraAppSrc::GetNumFramesDropped()
+{
+	return m_numFramesDropped;
+}
+
+// How many images the Grab Engine threw away in favor of newer ones since StartCamera() (LatestImageOnly, LatestImages)
+uint64_t CInstantCameraAppSrc::GetNumFramesSkipped()
+{
+	return m_numFramesSkipped;
+}
+
+// How many images the camera numbered but never delivered since StartCamera(), from gaps in the block IDs or frame counter (see count_lost_frames())
+uint64_t CInstantCameraAppSrc::GetNumFramesLost()
+{
+	return m_numFramesLost;
+}
+
+// How many grabs failed without any image data since StartCamera()
+uint64_t CInstantCameraAppSrc::GetNumFramesFailed()
+{
+	return m_numFramesFailed;
+}
+
+// How many images arrived with data missing (ie: lost packets) since StartCamera()
+uint64_t CInstantCameraAppSrc::GetNumFramesIncomplete()
+{
+	return m_numFramesIncomplete;
+}
+
+// How many times the last good image (or a blank one) was pushed again, in place of an image that didn't come in time (pull mode)
+uint64_t CInstantCameraAppSrc::GetNumFramesDuplicated()
+{
+	return m_numFramesDuplicated;
+}
+
 // Open the camera and adjust some settings
-bool CInstantCameraAppSrc::InitCamera(int width, int height, int framesPerSecond, bool useOnDemand, bool useTrigger, int scaledWidth, int scaledHeight, int rotation, int numFramesToGrab)
+// grabStrategy: how the Grab Engine hands images to us. LatestImageOnly is best for display, OneByOne for recording every image.
+// numGrabBuffers: for LatestImages, how many of the latest images are kept. Otherwise the number of Grab Engine buffers (-1 = sized for the strategy).
+bool CInstantCameraAppSrc::InitCamera(int width, int height, int framesPerSecond, bool useOnDemand, bool useTrigger, int scaledWidth, int scaledHeight, int rotation, int numFramesToGrab, Pylon::EGrabStrategy grabStrategy, int numGrabBuffers)
 {
 	try
 	{
@@ -175,6 +718,8 @@ bool CInstantCameraAppSrc::InitCamera(int width, int height, int framesPerSecond
 		m_scaledHeight = scaledHeight;
 		m_rotation = rotation;
 		m_numFramesToGrab = numFramesToGrab;
+		m_grabStrategy = grabStrategy;
+		m_numGrabBuffers = numGrabBuffers;
 
 		// since Image On Demand uses software trigger, it cannot be used with isTriggered
 		if (m_isOnDemand == true && m_isTriggered == true)
@@ -247,7 +792,7 @@ bool CInstantCameraAppSrc::InitCamera(int width, int height, int framesPerSecond
 					if (m_isOnDemand == true)
 						GenApi::CEnumerationPtr(GetNodeMap().GetNode("TriggerSource"))->FromString("Software");
 					if (m_isTriggered == true)
-						GenApi::CEnumerationPtr(GetNodeMap().GetNode("TriggerSource"))->FromString("Line1");
+						GenApi::CEnumerationPtr(GetNodeMap().GetNode("TriggerSource"))->FromString(m_triggerSource.c_str());
 				}
 				else
 				{
@@ -265,86 +810,1545 @@ bool CInstantCameraAppSrc::InitCamera(int width, int height, int framesPerSecond
 		}
 
 
-		// now setup some unique-to-usb and unique-to-gige features
-		if (GetDeviceInfo().GetDeviceClass() == "BaslerUsb")
-		{
-			// some usb-specific settings for performance
-			GenApi::CIntegerPtr(GetStreamGrabberNodeMap().GetNode("NumMaxQueuedUrbs"))->SetValue(100);
+		// now setup some unique-to-usb and unique-to-gige features
+		if (GetDeviceInfo().GetDeviceClass() == "BaslerUsb")
+		{
+			// some usb-specific settings for performance
+			GenApi::CIntegerPtr(GetStreamGrabberNodeMap().GetNode("NumMaxQueuedUrbs"))->SetValue(100);
+		}
+		else if (GetDeviceInfo().GetDeviceClass() == "BaslerGigE")
+		{
+			// some gige-specific settings for performance
+			GenApi::CIntegerPtr(GetNodeMap().GetNode("GevSCPSPacketSize"))->SetValue(1500); // set a usually-known-good gige packet size, like 1500.
+		}
+
+		// The UpcomingImage strategy is not supported by usb cameras
+		if (m_grabStrategy == Pylon::GrabStrategy_UpcomingImage && GetDeviceInfo().GetDeviceClass() == "BaslerUsb")
+		{
+			cout << "UpcomingImage grab strategy not available for usb cameras. Using LatestImageOnly." << endl;
+			m_grabStrategy = Pylon::GrabStrategy_LatestImageOnly;
+		}
+
+
+		// Performance tip: If using a color camera, try using RGB format in the camera. Debayering, conversion to RGB, and PGI enhancement will be all done inside the camera.
+		//                  This means the host doesn't have to do anything (in this sample, GStreamer is expecting RGB format for color).
+		//                  Using other color formats will mean needing at least a conversion on the host (e.g with the CImageFormatConverter),
+		//                  or at most a debayering and a conversion (e.g. BayerRG8).
+		//if (colorCamera == true && GenApi::IsAvailable(PixelFormat->GetEntryByName("RGB8")) == true)
+		//PixelFormat->FromString("RGB8");
+
+		// Configure the Pylon image format converter
+		// We're going to use GStreamer's RGB format in pipelines, so we may need to use Pylon to convert the camera's image to RGB (depending on the camera used)
+		EPixelType pixelType = Pylon::EPixelType::PixelType_RGB8packed;
+		m_FormatConverter.SetOutputPixelFormat(pixelType);
+
+		// Check the current pixelFormat of the camera to see if the camera should be treated as color or mono, and what we push to the pipeline.
+		update_pixel_types();
+
+		// Downscale on the camera where we can. It raises the camera's maximum frame rate, so do it before setting the frame rate.
+		configure_binning();
+
+		// Flip and rotate by 180 degrees on the camera where we can.
+		configure_reverse();
+
+		// if only connected as usb 2, reduce bandwidth to something stable (see CBandwidthPlanner). The image size is final now.
+		// Cameras sharing a link are planned together by CCameraArrayAppSrc::PlanBandwidth().
+		if (GetDeviceInfo().GetDeviceClass() == "BaslerUsb" && GenApi::CEnumerationPtr(GetNodeMap().GetNode("BslUSBSpeedMode"))->ToString() == "HighSpeed")
+		{
+			CBandwidthPlanner planner;
+			planner.AddCamera(this, m_frameRate);
+			planner.Plan();
+		}
+
+		// setup some settings common to most cameras (it's always best to check if a feature is available before setting it)
+		if (m_isTriggered == false)
+		{
+			if (m_frameRate == -1)
+			{
+				m_frameRate = this->GetFrameRate();
+			}
+
+			if (IsWritable(GetNodeMap().GetNode("AcquisitionFrameRateEnable")))
+				GenApi::CBooleanPtr(GetNodeMap().GetNode("AcquisitionFrameRateEnable"))->SetValue(true);
+			if (IsWritable(GetNodeMap().GetNode("AcquisitionFrameRateAbs")))
+				GenApi::CFloatPtr(GetNodeMap().GetNode("AcquisitionFrameRateAbs"))->SetValue(m_frameRate); // this is called "AcquisitionFrameRate" (not abs) in usb cameras. Migration mode lets us use the old name though.
+			if (IsWritable(GetNodeMap().GetNode("AcquisitionFrameRate")))
+				GenApi::CFloatPtr(GetNodeMap().GetNode("AcquisitionFrameRate"))->SetValue(m_frameRate); // BCON and USB use SFNC3 names.
+		}
+
+		m_isInitialized = true;
+
+		return true;
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in InitCamera(): " << endl << e.GetDescription() << e.GetSourceFileName() << endl;
+		return false;
+
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in InitCamera(): " << endl << e.what() << endl;
+		return false;
+	}
+}
+
+// Read the camera's pixel format, and remember the pixel format of the images pushed to the pipeline. GetSource() derives the caps from it.
+// Color images are converted to RGB (or YUV, see uses_bayer_to_yuv()), mono images are pushed in the camera's own format.
+// Packed mono formats are unpacked to 16 bits per pixel (eg: Mono12p -> Mono12), see CPixelKernels::UnpackTo16().
+// YUV 4:2:2 (cameras that demosaic on the sensor) is pushed as it is. It's half the size of RGB and encoders only need to subsample its chroma.
+void CInstantCameraAppSrc::update_pixel_types()
+{
+	GenApi::CEnumerationPtr PixelFormat = GetNodeMap().GetNode("PixelFormat");
+	m_cameraPixelType = Pylon::CPixelTypeMapper::GetPylonPixelTypeByName(PixelFormat->ToString());
+	m_isColor = (Pylon::IsMonoImage(m_cameraPixelType) == false);
+
+	if (m_cameraPixelType == Pylon::PixelType_YUV422packed || m_cameraPixelType == Pylon::PixelType_YUV422_YUYV_Packed || m_cameraPixelType == Pylon::PixelType_YUV422planar)
+		m_pixelType = m_cameraPixelType;
+	else if (m_isColor == true)
+		m_pixelType = Pylon::EPixelType::PixelType_RGB8packed; // see InitCamera()
+	else if (CPixelKernels::GetUnpackedPixelType(m_cameraPixelType) != Pylon::PixelType_Undefined)
+		m_pixelType = CPixelKernels::GetUnpackedPixelType(m_cameraPixelType);
+	else
+		m_pixelType = m_cameraPixelType;
+}
+
+// Set the camera's binning and decimation back to 1. The AOI covers the same part of the sensor afterwards, in sensor pixels.
+void CInstantCameraAppSrc::reset_binning()
+{
+	const char *factorNames[4] = { "BinningHorizontal", "DecimationHorizontal", "BinningVertical", "DecimationVertical" };
+	int sensorSizes[2] = { this->GetWidth(), this->GetHeight() };
+	for (int i = 0; i < 4; i++)
+	{
+		GenApi::CIntegerPtr ptrFactor = GetNodeMap().GetNode(factorNames[i]);
+		if (IsWritable(ptrFactor) == false)
+			continue;
+		sensorSizes[i / 2] *= (int)ptrFactor->GetValue();
+		ptrFactor->SetValue(1);
+	}
+
+	set_image_format(sensorSizes[0], sensorSizes[1], "");
+	m_isCameraBinned = false;
+}
+
+// Pick the camera's binning and decimation for the rescaling asked for in InitCamera() (see SetCameraBinning()).
+// For each direction, the largest factor that doesn't take the image below the scaled size. Binning comes first, because it averages
+// neighbouring pixels (less noise, less aliasing), where decimation skips them. Color cameras only bin, as decimation may break the Bayer pattern.
+// The AOI covers the same part of the sensor afterwards, in binned pixels.
+void CInstantCameraAppSrc::configure_binning()
+{
+	GenApi::CIntegerPtr ptrBinning[2] = { GetNodeMap().GetNode("BinningHorizontal"), GetNodeMap().GetNode("BinningVertical") };
+	GenApi::CIntegerPtr ptrDecimation[2] = { GetNodeMap().GetNode("DecimationHorizontal"), GetNodeMap().GetNode("DecimationVertical") };
+	const char *binningModeNames[2] = { "BinningHorizontalMode", "BinningVerticalMode" };
+	int scaledSizes[2] = { m_scaledWidth, m_scaledHeight };
+	int sensorSizes[2] = { this->GetWidth(), this->GetHeight() };
+	int binnings[2] = { 1, 1 };
+	int decimations[2] = { 1, 1 };
+
+	// leave the camera's own binning and decimation alone, unless we set them before
+	bool isScaling = m_isCameraBinning == true && m_scaledWidth >= 2 && m_scaledHeight >= 2 && (m_isColor == false || m_isRawBayer == false);
+	if (isScaling == false && m_isCameraBinned == false)
+		return;
+
+	for (int i = 0; i < 2; i++)
+	{
+		// the AOI in sensor pixels, and back to no binning or decimation
+		if (IsReadable(ptrBinning[i]))
+		{
+			sensorSizes[i] *= (int)ptrBinning[i]->GetValue();
+			if (IsWritable(ptrBinning[i]))
+				ptrBinning[i]->SetValue(1);
+		}
+		if (IsReadable(ptrDecimation[i]))
+		{
+			sensorSizes[i] *= (int)ptrDecimation[i]->GetValue();
+			if (IsWritable(ptrDecimation[i]))
+				ptrDecimation[i]->SetValue(1);
+		}
+
+		if (isScaling == false || sensorSizes[i] < 2 * scaledSizes[i])
+			continue;
+
+		int factor = sensorSizes[i] / scaledSizes[i];
+		int maxBinning = IsWritable(ptrBinning[i]) ? (int)ptrBinning[i]->GetMax() : 1;
+		int maxDecimation = (IsWritable(ptrDecimation[i]) && m_isColor == false) ? (int)ptrDecimation[i]->GetMax() : 1;
+		for (int binning = std::min(maxBinning, factor); binning >= 1; binning--)
+		{
+			int decimation = std::min(maxDecimation, factor / binning);
+			if (binning * decimation > binnings[i] * decimations[i])
+			{
+				binnings[i] = binning;
+				decimations[i] = decimation;
+			}
+		}
+	}
+
+	for (int i = 0; i < 2; i++)
+	{
+		// average binned pixels rather than sum them, so the images keep their brightness
+		if (binnings[i] > 1 && IsWritable(GetNodeMap().GetNode(binningModeNames[i])))
+		{
+			GenApi::CEnumerationPtr ptrBinningMode = GetNodeMap().GetNode(binningModeNames[i]);
+			if (IsAvailable(ptrBinningMode->GetEntryByName("Average")))
+				ptrBinningMode->FromString("Average");
+		}
+		if (binnings[i] > 1)
+			ptrBinning[i]->SetValue(binnings[i]);
+		if (decimations[i] > 1)
+			ptrDecimation[i]->SetValue(decimations[i]);
+	}
+
+	set_image_format(sensorSizes[0] / (binnings[0] * decimations[0]), sensorSizes[1] / (binnings[1] * decimations[1]), "");
+
+	m_isCameraBinned = binnings[0] * decimations[0] * binnings[1] * decimations[1] > 1;
+	if (m_isCameraBinned == true)
+	{
+		cout << "Camera binning           : " << binnings[0] << " x " << binnings[1] << ", decimation " << decimations[0] << " x " << decimations[1]
+			<< " -> " << this->GetWidth() << " x " << this->GetHeight() << ", rescaled to " << m_scaledWidth << " x " << m_scaledHeight << " on the host" << endl;
+	}
+}
+
+// Split the flips (see SetFlip()) and rotation between the camera and the host.
+// Cameras with ReverseX and ReverseY mirror the image in the sensor readout, for free. A 180 degree rotation is a horizontal plus a vertical flip,
+// so the camera can do that too. What the camera can't do, and 90 and 270 degree rotations, is left to the host (see SetFusedTransform()), after the camera's flips.
+void CInstantCameraAppSrc::configure_reverse()
+{
+	// check the rotation. We offer -1 to the user to remain consistent with other options where -1 = no effect
+	if (m_rotation != -1 && m_rotation != 0 && m_rotation != 90 && m_rotation != 180 && m_rotation != 270)
+	{
+		cerr << "Only rotation angles of 90, 180, 270 are supported! Will not rotate image!" << endl;
+		m_rotation = 0;
+	}
+
+	bool isReversed[2] = { m_isFlippedX != (m_rotation == 180), m_isFlippedY != (m_rotation == 180) };
+	bool isHostFlipped[2] = { isReversed[0], isReversed[1] };
+	bool *pIsCameraReversed[2] = { &m_isCameraReversedX, &m_isCameraReversedY };
+	const char *reverseNames[2] = { "ReverseX", "ReverseY" };
+	m_hostRotation = (m_rotation == 90 || m_rotation == 270) ? m_rotation : 0;
+
+	for (int i = 0; i < 2; i++)
+	{
+		// leave the camera's own setting alone, unless we need it or set it before
+		if (isReversed[i] == false && *pIsCameraReversed[i] == false)
+			continue;
+		if (IsWritable(GetNodeMap().GetNode(reverseNames[i])) == false)
+		{
+			*pIsCameraReversed[i] = false;
+			continue;
+		}
+
+		GenApi::CBooleanPtr(GetNodeMap().GetNode(reverseNames[i]))->SetValue(isReversed[i]);
+		*pIsCameraReversed[i] = isReversed[i];
+		isHostFlipped[i] = false;
+	}
+
+	m_isHostFlippedX = isHostFlipped[0];
+	m_isHostFlippedY = isHostFlipped[1];
+
+	// Mirroring a Bayer sensor can shift its color filter pattern, which the camera then reports in PixelFormat.
+	update_pixel_types();
+
+	if (m_isCameraReversedX == true || m_isCameraReversedY == true)
+		cout << "Camera mirroring         : " << (m_isCameraReversedX ? "ReverseX " : "") << (m_isCameraReversedY ? "ReverseY" : "") << endl;
+}
+
+// Enable the chunks CChunkMeta decodes (see SetChunkData()), as far as the camera has them
+void CInstantCameraAppSrc::configure_chunks()
+{
+	// leave the camera's own chunk settings alone, unless we turned chunk mode on before
+	if (m_isChunkData == false && m_isChunkModeActive == false)
+		return;
+
+	if (IsWritable(GetNodeMap().GetNode("ChunkModeActive")) == false)
+	{
+		cout << "Chunk data not available. Continuing without it." << endl;
+		return;
+	}
+
+	GenApi::CBooleanPtr(GetNodeMap().GetNode("ChunkModeActive"))->SetValue(m_isChunkData);
+	m_isChunkModeActive = m_isChunkData;
+	if (m_isChunkData == false)
+		return;
+
+	// gige, usb and BCON cameras name some chunks differently (see CChunkMeta::Add())
+	GenApi::CEnumerationPtr ptrChunkSelector = GetNodeMap().GetNode("ChunkSelector");
+	const char *chunkNames[] = { "Framecounter", "FrameID", "CounterValue", "Timestamp", "ExposureTime", "Gain", "GainAll", "LineStatusAll", "PayloadCRC16" };
+	for (size_t i = 0; i < sizeof(chunkNames) / sizeof(chunkNames[0]); i++)
+	{
+		if (IsAvailable(ptrChunkSelector->GetEntryByName(chunkNames[i])) == false)
+			continue;
+		ptrChunkSelector->FromString(chunkNames[i]);
+		if (IsWritable(GetNodeMap().GetNode("ChunkEnable")))
+			GenApi::CBooleanPtr(GetNodeMap().GetNode("ChunkEnable"))->SetValue(true);
+	}
+}
+
+// Start the image grabbing of camera and driver
+bool CInstantCameraAppSrc::StartCamera()
+{
+	try
+	{
+		if (m_isInitialized == false)
+		{
+			cout << "Camera not initialized. Run InitCamera() first." << endl;
+			return false;
+		}
+		if ((m_isPushMode == true || m_isExternalRetrieval == true) && m_appsrc == NULL)
+		{
+			cout << "Push mode needs the source element. Run GetSource() first." << endl;
+			return false;
+		}
+		if (m_isPushMode == true && m_isExternalRetrieval == true)
+		{
+			cout << "Push mode and external retrieval cannot be used together." << endl;
+			return false;
+		}
+
+		// Start grabbing images with the camera and pylon.
+		// By default we use Pylon's GrabStrategy_LatestImageOnly.
+		// This is good for display, and for benchmarking (because any "lag" between images is solely due to how fast the application can call app->grabFrame())
+		// For recording, OneByOne keeps every image until the pipeline takes it (as long as the Grab Engine has free buffers).
+
+		cout << "Starting Camera image acquistion and Pylon driver Grab Engine..." << endl;
+		if (m_isTriggered == true)
+		{
+			cout << "Camera will now expect a hardware trigger on: " << GenApi::CEnumerationPtr(GetNodeMap().GetNode("TriggerSource"))->ToString() << "..." << endl;
+		}
+
+		// Preallocate the frame buffers that converted and copied images are written into.
+		if (create_buffer_pool() == false)
+			return false;
+
+		// Size the Grab Engine's buffers for the grab strategy.
+		configure_grab_buffers();
+
+		// Have the camera append the chunks we decode into CChunkMeta.
+		configure_chunks();
+
+		m_numFramesGrabbed = 0;
+		m_numFramesPushed = 0;
+		m_numFramesDropped = 0;
+		m_numFramesSkipped = 0;
+		m_numFramesLost = 0;
+		m_numFramesFailed = 0;
+		m_numFramesIncomplete = 0;
+		m_numFramesDuplicated = 0;
+		m_lastBlockId = UINT64_MAX;
+		m_lastFrameCounter = UINT64_MAX;
+		m_numFramesUncounted = 0;
+
+		// Start a new mapping of camera timestamps to the pipeline clock.
+		double tickFrequency = 1e9; // usb and BCON cameras count their timestamps in ns
+		if (IsReadable(GetNodeMap().GetNode("GevTimestampTickFrequency")))
+			tickFrequency = (double)GenApi::CIntegerPtr(GetNodeMap().GetNode("GevTimestampTickFrequency"))->GetValue();
+		m_timestampMapper.Reset(tickFrequency);
+		m_tickFrequency = tickFrequency;
+		m_lastPts = GST_CLOCK_TIME_NONE;
+
+		// Tell the pipeline how old the images are when they leave the source.
+		configure_latency();
+
+		// Prepare the stripes and worker threads for color conversion.
+		configure_conversion();
+
+		StartGrabbing(m_grabStrategy);
+
+		// In push mode, our own threads retrieve images and push them to AppSrc from here on.
+		if (m_isPushMode == true)
+			start_push_threads();
+
+		// With external retrieval, the application calls PushImage() from here on, and AppSrc only holds a few images.
+		if (m_isExternalRetrieval == true)
+			g_object_set(G_OBJECT(m_appsrc), "max-bytes", get_appsrc_max_bytes(), "block", FALSE, NULL);
+
+		// Sample the frame counts and stream grabber statistics in the background.
+		start_stats_thread();
+
+		// Note: At this point, the camera is acquiring and transmitting images, and the driver's Grab Engine is grabbing them.
+		//       When the Grab Engine has an image, it places it into it's Output Queue for retrieval by CInstantCamera::RetrieveResult().
+		//		 When the AppSrc needs an image to push to the GStreamer pipeline, it fires the "need-data" callback, which runs cb_need_data().
+		//		 cb_need_data() calls RetrieveImage(), which in turn calls RetrieveResult(), which retrieves an image from the Grab Engine Output Queue
+		//       If you like, you can see how many images are waiting for retrieval by checking camera.NumReadyBuffers.GetValue().
+		//
+		// Note: When using GrabStrategy_LatestImageOnly, there will always be only one image waiting in the Output Queue by design - the latest image to come in from the camera.
+		//		 LatestImageOnly is good for display applications and for benchmarking the application/host...
+		//		 ...because any "lag" or "stutter" seen in the display is purely dependent on how fast the application is retrieving images (slower application = more stutter).
+		//		 With GrabStrategy_OneByOne, images wait in the Output Queue in the order they arrived. A slow pipeline then adds latency instead of skipping images.
+
+		// Check that we are actually getting images before proceeding
+		//while (true)
+		//{
+		//	if (NumReadyBuffers.GetValue() > 0)
+		//	{
+		//		cout << "Images have begun arriving at Grab Engine and are ready to be retrieved and pushed to pipeline!" << endl;
+		//		break;
+		//	}
+		//}
+
+		return true;
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in StartCamera(): " << endl << e.GetDescription() << endl;
+		return false;
+
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in StartCamera(): " << endl << e.what() << endl;
+		return false;
+	}
+}
+
+// Retrieve an image from the driver and push it to AppSrc (pull mode)
+bool CInstantCameraAppSrc::retrieve_image()
+{
+	try
+	{
+		// Reconfigure() holds the lock while the camera is stopped
+		std::lock_guard<std::mutex> lock(m_grabMutex);
+
+		if (IsGrabbing() == false)
+		{
+			cout << "Camera is not Grabbing. Run StartCamera() first." << endl;
+			return false;
+		}
+
+		// Retrieve a Grab Result from the Grab Engine's Output Queue. If nothing comes to the output queue in 5 seconds, throw a timeout exception.
+		// In low-latency mode, wait no more than two frame periods, and push the last good image again rather than stall the pipeline.
+		// (With a hardware trigger, images come whenever the trigger comes, so we keep waiting for them.)
+		GstBuffer *buffer = NULL;
+		if (m_isLowLatency == true && m_isTriggered == false && m_frameRateNum > 0)
+		{
+			unsigned int timeoutMs = (unsigned int)std::max<guint64>(gst_util_uint64_scale_int(2000, m_frameRateDen, m_frameRateNum), 10);
+			buffer = grab_image(timeoutMs, Pylon::ETimeoutHandling::TimeoutHandling_Return);
+		}
+		else
+			buffer = grab_image(5000, Pylon::ETimeoutHandling::TimeoutHandling_ThrowException);
+		bool isNewImage = (buffer != NULL);
+		if (isNewImage == false)
+			m_numFramesDuplicated++;
+
+		if (buffer != NULL)
+		{
+			// keep a reference to the latest good image, in case the next grab fails.
+			if (m_lastBuffer != NULL)
+				gst_buffer_unref(m_lastBuffer);
+			m_lastBuffer = gst_buffer_ref(buffer);
+		}
+		else if (m_lastBuffer != NULL)
+		{
+			// a new buffer sharing the image, without the old timestamps, so AppSrc timestamps it now.
+			// Counted in m_numFramesDuplicated, not printed, as printing here would hold up the streaming thread.
+			buffer = gst_buffer_copy(m_lastBuffer);
+			GST_BUFFER_PTS(buffer) = GST_CLOCK_TIME_NONE;
+			GST_BUFFER_DTS(buffer) = GST_CLOCK_TIME_NONE;
+			CFrameTraceMeta::Remove(buffer);
+
+			// With hardware timestamps, AppSrc's push time would be later than the capture time of the next real image.
+			// Place the repeat one frame after the last image instead, so the timeline keeps increasing.
+			if (m_isHardwareTimestamped == true && m_lastPts != GST_CLOCK_TIME_NONE)
+			{
+				GstClockTime duration = GST_BUFFER_DURATION(buffer);
+				m_lastPts += (duration != GST_CLOCK_TIME_NONE && duration > 0) ? duration : 1;
+				GST_BUFFER_PTS(buffer) = m_lastPts;
+				GST_BUFFER_DTS(buffer) = m_lastPts;
+			}
+		}
+		else
+		{
+			// on the off chance that the very first image can't be supplied by the instant camera (ie: missing trigger signal), push a blank image.
+			buffer = acquire_pooled_buffer();
+			if (buffer == NULL)
+				return false;
+			gst_buffer_memset(buffer, 0, 0, m_frameSize);
+		}
+
+		CFrameTraceMeta *pTrace = CFrameTraceMeta::Get(buffer);
+		if (pTrace != NULL)
+			pTrace->pushedTime = get_clock_time();
+
+		// Push the gst buffer wrapping the image buffer to the source pads of the AppSrc element, where it's picked up by the rest of the pipeline
+		// The push-buffer signal takes its own reference, so we release ours afterwards (this is what eventually releases a wrapped grab result).
+		GstFlowReturn ret;
+		g_signal_emit_by_name(m_appsrc, "push-buffer", buffer, &ret);
+		gst_buffer_unref(buffer);
+
+		if (isNewImage == true)
+			m_numFramesPushed++;
+
+		return true;
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in retrieve_image(): " << endl << e.GetDescription() << endl;
+		return false;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in retrieve_image(): " << endl << e.what() << endl;
+		return false;
+	}
+}
+
+// With SetExternalRetrieval(): retrieve the next image (waiting up to timeoutMs for it), and push it to AppSrc.
+// Returns false if no new image was pushed. If the camera was removed, AppSrc is sent end-of-stream.
+bool CInstantCameraAppSrc::PushImage(unsigned int timeoutMs)
+{
+	GstBuffer *buffer = GrabImage(timeoutMs);
+	if (buffer == NULL)
+		return false;
+
+	return PushBuffer(buffer);
+}
+
+// With SetExternalRetrieval(): retrieve the next image (waiting up to timeoutMs for it), without pushing it yet.
+// The caller owns the buffer, and hands it to PushBuffer() or unrefs it. CCameraArrayAppSrc uses this to push the images of many cameras as matched sets.
+// pDeviceTime: if set, receives the camera's timestamp of the image in ns (on the PTP clock, if the camera is synchronized).
+// Returns NULL if no good image was retrieved. If the camera was removed, AppSrc is sent end-of-stream.
+GstBuffer* CInstantCameraAppSrc::GrabImage(unsigned int timeoutMs, guint64 *pDeviceTime)
+{
+	try
+	{
+		// Reconfigure() holds the lock while the camera is stopped
+		std::lock_guard<std::mutex> lock(m_grabMutex);
+
+		if (m_isExternalRetrieval == false || IsGrabbing() == false)
+			return NULL;
+
+		if (IsCameraDeviceRemoved() == true)
+		{
+			cout << "Camera Removed!" << endl;
+			GstFlowReturn ret;
+			g_signal_emit_by_name(m_appsrc, "end-of-stream", &ret);
+			return NULL;
+		}
+
+		GstBuffer *buffer = grab_image(timeoutMs, Pylon::ETimeoutHandling::TimeoutHandling_Return);
+		if (buffer != NULL && pDeviceTime != NULL)
+			*pDeviceTime = m_lastDeviceTime;
+
+		return buffer;
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in GrabImage(): " << endl << e.GetDescription() << endl;
+		return NULL;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in GrabImage(): " << endl << e.what() << endl;
+		return NULL;
+	}
+}
+
+// With SetExternalRetrieval(): push an image from GrabImage() to AppSrc. Takes ownership of the buffer.
+// Returns false if the image was dropped, because AppSrc is full.
+bool CInstantCameraAppSrc::PushBuffer(GstBuffer *buffer)
+{
+	if (buffer == NULL)
+		return false;
+
+	// never block the caller's thread on a pipeline that falls behind. Drop the new image instead.
+	guint64 queuedBytes = 0;
+	g_object_get(G_OBJECT(m_appsrc), "current-level-bytes", &queuedBytes, NULL);
+	if (queuedBytes >= get_appsrc_max_bytes())
+	{
+		gst_buffer_unref(buffer);
+		m_numFramesDropped++;
+		return false;
+	}
+
+	CFrameTraceMeta *pTrace = CFrameTraceMeta::Get(buffer);
+	if (pTrace != NULL)
+		pTrace->pushedTime = get_clock_time();
+
+	GstFlowReturn ret;
+	g_signal_emit_by_name(m_appsrc, "push-buffer", buffer, &ret);
+	gst_buffer_unref(buffer);
+	m_numFramesPushed++;
+
+	return true;
+}
+
+// Retrieve an image from the driver and place it into a gst buffer. Returns NULL if no good image was retrieved.
+GstBuffer* CInstantCameraAppSrc::grab_image(unsigned int timeoutMs, Pylon::ETimeoutHandling timeoutHandling)
+{
+	// Description of "Grabbing" procedure:
+	// In this sample, the camera is always free-running and sending images to the Pylon driver's "Grab Engine".
+	// The Pylon Grab Engine is thus always spinning. It "Grabs" incoming data, places it into an empty buffer from its "Input Queue", and places the "Grab Result£ into its "Output Queue".
+	// Depending on the Pylon "Grab Strategy" used, buffers are recycled in different ways.
+	//  In this sample, the LatestImageOnly strategy is used. This means that only one Grab Result is kept in the Output Queue at a time.
+	//  If a new image comes from the camera before the previous is retrieved from the output queue, the previous one is overwritten with the newer one.
+	// The application retrieves a Grab Result by calling RetrieveResult. If the Grab Result is successful, then a good image is in the buffer. If it is not, there was a problem.
+
+	// The CGrabResultPtr smart pointer contains information about the grab in question, as well as access to the buffer of pixel data.
+	Pylon::CGrabResultPtr ptrGrabResult;
+
+	if (m_isOnDemand == true)
+	{
+		ExecuteSoftwareTrigger(); // TODO: Check for bug or broken camera on 21949158. It would "Grab Timeout" when used in the twocameras_compositor sample. Other camera combinations worked just fine.
+	}
+
+	if (RetrieveResult(timeoutMs, ptrGrabResult, timeoutHandling) == false)
+		return NULL;
+
+	// the pipeline clock times for the latency trace (see SetLatencyTracing())
+	GstClockTime retrievedTime = (m_isLatencyTraced == true) ? get_clock_time() : GST_CLOCK_TIME_NONE;
+
+	// With LatestImageOnly and LatestImages, the Grab Engine tells us how many older images it threw away in favor of this one.
+	uint64_t numSkipped = (uint64_t)ptrGrabResult->GetNumberOfSkippedImages();
+	m_numFramesDropped += numSkipped;
+	m_numFramesSkipped += numSkipped;
+
+	// if the Grab Result indicates success, then we have a good image within the result.
+	if (ptrGrabResult->GrabSucceeded() == false)
+	{
+		// If a Grab Failed, the Grab Result is tagged with information about why it failed (technically you could even still access the pixel data to look at the bad image too).
+		cout << "Pylon: Grab Result Failed! Error: " << ptrGrabResult->GetErrorDescription() << endl;
+		// Part of the image arrived, but data went missing on the way (ie: lost packets), or nothing of it arrived at all.
+		// Buffers canceled by StopGrabbing() are neither: the camera and link did nothing wrong.
+		if (ptrGrabResult->GetStatus() != Pylon::Canceled)
+		{
+			if (ptrGrabResult->GetPayloadSize() > 0)
+				m_numFramesIncomplete++;
+			else
+				m_numFramesFailed++;
+		}
+		count_lost_frames(ptrGrabResult, NULL, numSkipped);
+		return NULL;
+	}
+
+	m_numFramesGrabbed++;
+	m_lastDeviceTime = (guint64)((double)ptrGrabResult->GetTimeStamp() * 1e9 / m_tickFrequency);
+
+	// in zero-copy mode, an image that already has the pipeline's format is wrapped and pushed as it is.
+	// otherwise the image is converted (if color) or copied (if RGB or mono) into a buffer from the pool.
+	// Each pushed image gets its own buffer, so we never overwrite an image that is still going through the pipeline.
+	GstBuffer *buffer = NULL;
+	if ((m_isZeroCopy == true || m_isGstBufferFactory == true) && is_zero_copy_compatible(ptrGrabResult) == true)
+		buffer = wrap_grab_result(ptrGrabResult);
+	else
+		buffer = fill_pooled_buffer(ptrGrabResult);
+
+	if (buffer == NULL)
+	{
+		count_lost_frames(ptrGrabResult, NULL, numSkipped);
+		return NULL;
+	}
+
+	GstClockTime convertedTime = (retrievedTime != GST_CLOCK_TIME_NONE) ? get_clock_time() : GST_CLOCK_TIME_NONE;
+
+	// decode the chunks once, here on the acquisition side, for everyone downstream
+	if (m_isChunkData == true)
+		CChunkMeta::Add(buffer, ptrGrabResult);
+
+	timestamp_buffer(buffer, ptrGrabResult);
+
+	// with hardware timestamps, the buffer's timestamp is when the exposure started.
+	if (retrievedTime != GST_CLOCK_TIME_NONE)
+	{
+		GstClockTime exposureTime = GST_CLOCK_TIME_NONE;
+		if (m_isHardwareTimestamped == true && GST_BUFFER_PTS(buffer) != GST_CLOCK_TIME_NONE)
+			exposureTime = GST_BUFFER_PTS(buffer) + gst_element_get_base_time(m_appsrc);
+		CFrameTraceMeta::Add(buffer, exposureTime, retrievedTime, convertedTime);
+	}
+
+	count_lost_frames(ptrGrabResult, buffer, numSkipped);
+
+	return buffer;
+}
+
+// Count the images lost before this grab result, from gaps in the numbers the camera gives its images.
+// Block IDs number every image the camera sends. Without them (some transport layers), we use the frame counter chunk of the good images (see SetChunkData()),
+// less the images skipped or failed in between, which have no frame counter of their own.
+void CInstantCameraAppSrc::count_lost_frames(Pylon::CGrabResultPtr &ptrGrabResult, GstBuffer *buffer, uint64_t numSkipped)
+{
+	uint64_t blockId = ptrGrabResult->GetBlockID();
+	if (blockId != UINT64_MAX)
+	{
+		// a lower block ID means the camera started counting again (or the 16-bit GigE block ID wrapped around), so there is no gap to count.
+		if (m_lastBlockId != UINT64_MAX && blockId > m_lastBlockId + 1 + numSkipped)
+			m_numFramesLost += blockId - m_lastBlockId - 1 - numSkipped;
+		m_lastBlockId = blockId;
+		return;
+	}
+
+	m_numFramesUncounted += numSkipped;
+	CChunkMeta *pChunkMeta = (buffer != NULL) ? CChunkMeta::Get(buffer) : NULL;
+	if (pChunkMeta == NULL || pChunkMeta->Has(CChunkMeta::Field_FrameCounter) == false)
+	{
+		m_numFramesUncounted++;
+		return;
+	}
+
+	if (m_lastFrameCounter != UINT64_MAX && pChunkMeta->frameCounter > m_lastFrameCounter + 1 + m_numFramesUncounted)
+		m_numFramesLost += pChunkMeta->frameCounter - m_lastFrameCounter - 1 - m_numFramesUncounted;
+	m_lastFrameCounter = pChunkMeta->frameCounter;
+	m_numFramesUncounted = 0;
+}
+
+// Post the frame counts since StartCamera() on the bus, as an element message from AppSrc.
+// Applications find them in their bus watch as a "camera-frame-stats" structure with the camera's serial number:
+//   serial (string), grabbed, pushed, dropped, skipped, lost, failed, incomplete, duplicated (guint64)
+void CInstantCameraAppSrc::post_frame_stats()
+{
+	if (m_appsrc == NULL)
+		return;
+
+	GstStructure *stats = gst_structure_new("camera-frame-stats",
+		"serial", G_TYPE_STRING, GetDeviceInfo().GetSerialNumber().c_str(),
+		"grabbed", G_TYPE_UINT64, (guint64)m_numFramesGrabbed,
+		"pushed", G_TYPE_UINT64, (guint64)m_numFramesPushed,
+		"dropped", G_TYPE_UINT64, (guint64)m_numFramesDropped,
+		"skipped", G_TYPE_UINT64, (guint64)m_numFramesSkipped,
+		"lost", G_TYPE_UINT64, (guint64)m_numFramesLost,
+		"failed", G_TYPE_UINT64, (guint64)m_numFramesFailed,
+		"incomplete", G_TYPE_UINT64, (guint64)m_numFramesIncomplete,
+		"duplicated", G_TYPE_UINT64, (guint64)m_numFramesDuplicated,
+		NULL);
+	gst_element_post_message(m_appsrc, gst_message_new_element(GST_OBJECT(m_appsrc), stats));
+}
+
+// The stream grabber statistics we sample, where the transport layer has them
+static const char* const streamStatistics[] =
+{
+	"Statistic_Total_Buffer_Count",
+	"Statistic_Failed_Buffer_Count",
+	"Statistic_Buffer_Underrun_Count",     // GigE: the Grab Engine had no free buffer for an image
+	"Statistic_Total_Packet_Count",        // GigE
+	"Statistic_Failed_Packet_Count",       // GigE
+	"Statistic_Resend_Request_Count",      // GigE: packets asked for again
+	"Statistic_Resend_Packet_Count",       // GigE: packets that came again
+	"Statistic_Missed_Frame_Count",        // USB: images the camera couldn't send
+	"Statistic_Resynchronization_Count",   // USB: the stream lost and found its place again
+	NULL
+};
+
+// Start sampling the statistics in the background, every m_statsIntervalMs (see SetStatsInterval())
+void CInstantCameraAppSrc::start_stats_thread()
+{
+	if (m_statsIntervalMs == 0)
+		return;
+
+	m_isSampling = true;
+	m_statsThread = std::thread(&CInstantCameraAppSrc::stats_loop, this);
+}
+
+// Stop sampling the statistics
+void CInstantCameraAppSrc::stop_stats_thread()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		m_isSampling = false;
+	}
+	m_statsCondition.notify_all();
+
+	if (m_statsThread.joinable())
+		m_statsThread.join();
+}
+
+// Publish the statistics every m_statsIntervalMs, on our own thread, so reading the stream grabber's node map never delays need-data or the acquisition thread.
+void CInstantCameraAppSrc::stats_loop()
+{
+	std::unique_lock<std::mutex> lock(m_statsMutex);
+	while (m_isSampling == true)
+	{
+		m_statsCondition.wait_for(lock, std::chrono::milliseconds(m_statsIntervalMs));
+		if (m_isSampling == true)
+			publish_stats();
+	}
+}
+
+// Sample the stream grabber statistics, and publish them with the frame counts on the bus and to the metrics file
+void CInstantCameraAppSrc::publish_stats()
+{
+	try
+	{
+		std::vector<std::pair<string, int64_t>> streamStats = sample_stream_stats();
+		post_frame_stats();
+		post_stream_stats(streamStats);
+		write_metrics_file(streamStats);
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in publish_stats(): " << endl << e.GetDescription() << endl;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in publish_stats(): " << endl << e.what() << endl;
+	}
+}
+
+// Read the stream grabber statistics this camera's transport layer has (GigE, USB, ...), as pairs of lower case name (without "Statistic_") and value.
+// The statistics count from when the camera was opened.
+std::vector<std::pair<string, int64_t>> CInstantCameraAppSrc::sample_stream_stats()
+{
+	std::vector<std::pair<string, int64_t>> streamStats;
+	GenApi::INodeMap &nodeMap = GetStreamGrabberNodeMap();
+	for (int i = 0; streamStatistics[i] != NULL; i++)
+	{
+		if (IsReadable(nodeMap.GetNode(streamStatistics[i])) == false)
+			continue;
+
+		string name = string(streamStatistics[i]).substr(strlen("Statistic_"));
+		std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+		streamStats.push_back(std::make_pair(name, (int64_t)GenApi::CIntegerPtr(nodeMap.GetNode(streamStatistics[i]))->GetValue()));
+	}
+
+	return streamStats;
+}
+
+// Post the stream grabber statistics on the bus, as a "camera-stream-stats" element message from AppSrc with the camera's serial number (string),
+// and a gint64 field for each statistic the transport layer has (ie: "failed-buffer-count", "resend-request-count", "missed-frame-count").
+void CInstantCameraAppSrc::post_stream_stats(const std::vector<std::pair<string, int64_t>> &streamStats)
+{
+	if (m_appsrc == NULL || streamStats.empty() == true)
+		return;
+
+	GstStructure *stats = gst_structure_new("camera-stream-stats",
+		"serial", G_TYPE_STRING, GetDeviceInfo().GetSerialNumber().c_str(),
+		NULL);
+	for (size_t i = 0; i < streamStats.size(); i++)
+	{
+		string field = streamStats[i].first;
+		std::replace(field.begin(), field.end(), '_', '-');
+		gst_structure_set(stats, field.c_str(), G_TYPE_INT64, (gint64)streamStats[i].second, NULL);
+	}
+	gst_element_post_message(m_appsrc, gst_message_new_element(GST_OBJECT(m_appsrc), stats));
+}
+
+// Write the frame counts and stream grabber statistics to m_metricsFile in the Prometheus text format, labeled with the camera's serial number.
+// The file is written under a temporary name and renamed over the old one, so a scraper never reads half a file.
+void CInstantCameraAppSrc::write_metrics_file(const std::vector<std::pair<string, int64_t>> &streamStats)
+{
+	if (m_metricsFile == "")
+		return;
+
+	string label = string("{serial=\"") + GetDeviceInfo().GetSerialNumber().c_str() + "\"}";
+	std::vector<std::pair<string, uint64_t>> frameStats;
+	frameStats.push_back(std::make_pair(string("grabbed"), (uint64_t)m_numFramesGrabbed));
+	frameStats.push_back(std::make_pair(string("pushed"), (uint64_t)m_numFramesPushed));
+	frameStats.push_back(std::make_pair(string("dropped"), (uint64_t)m_numFramesDropped));
+	frameStats.push_back(std::make_pair(string("skipped"), (uint64_t)m_numFramesSkipped));
+	frameStats.push_back(std::make_pair(string("lost"), (uint64_t)m_numFramesLost));
+	frameStats.push_back(std::make_pair(string("failed"), (uint64_t)m_numFramesFailed));
+	frameStats.push_back(std::make_pair(string("incomplete"), (uint64_t)m_numFramesIncomplete));
+	frameStats.push_back(std::make_pair(string("duplicated"), (uint64_t)m_numFramesDuplicated));
+
+	string tempFile = m_metricsFile + ".tmp";
+	std::ofstream file(tempFile.c_str(), std::ios::trunc);
+	if (!file)
+	{
+		cerr << "Cannot write metrics file " << tempFile << endl;
+		return;
+	}
+
+	for (size_t i = 0; i < frameStats.size(); i++)
+	{
+		string metric = "pylon_frames_" + frameStats[i].first + "_total";
+		file << "# TYPE " << metric << " counter" << endl;
+		file << metric << label << " " << frameStats[i].second << endl;
+	}
+	for (size_t i = 0; i < streamStats.size(); i++)
+	{
+		string metric = "pylon_stream_" + streamStats[i].first;
+		file << "# TYPE " << metric << " counter" << endl;
+		file << metric << label << " " << streamStats[i].second << endl;
+	}
+	file.close();
+
+	if (std::rename(tempFile.c_str(), m_metricsFile.c_str()) != 0)
+		cerr << "Cannot replace metrics file " << m_metricsFile << endl;
+}
+
+// The pipeline clock's time now, or GST_CLOCK_TIME_NONE until the pipeline is playing
+GstClockTime CInstantCameraAppSrc::get_clock_time()
+{
+	if (m_appsrc == NULL)
+		return GST_CLOCK_TIME_NONE;
+
+	GstClock *clock = gst_element_get_clock(m_appsrc);
+	if (clock == NULL)
+		return GST_CLOCK_TIME_NONE;
+	GstClockTime time = gst_clock_get_time(clock);
+	gst_object_unref(clock);
+	return time;
+}
+
+// Stamp a buffer with the moment the camera captured the image, on the pipeline's running time.
+// The camera's timestamp is free of the transfer, retrieval and conversion delays that the arrival time on the host includes.
+// CTimestampMapper estimates the offset and drift between the camera's clock and the pipeline clock as images come in.
+void CInstantCameraAppSrc::timestamp_buffer(GstBuffer *buffer, Pylon::CGrabResultPtr &ptrGrabResult)
+{
+	if (m_frameRateNum > 0)
+		GST_BUFFER_DURATION(buffer) = gst_util_uint64_scale_int(GST_SECOND, m_frameRateDen, m_frameRateNum);
+
+	// without hardware timestamps, AppSrc timestamps the buffer when it is pushed (do-timestamp).
+	if (m_isHardwareTimestamped == false || m_appsrc == NULL)
+		return;
+
+	// The pipeline clock is only there once the pipeline is playing. Until then, AppSrc timestamps the buffer too.
+	GstClockTime hostTime = get_clock_time();
+	if (hostTime == GST_CLOCK_TIME_NONE)
+		return;
+	GstClockTime baseTime = gst_element_get_base_time(m_appsrc);
+
+	// Prefer the timestamp chunk if the camera sends one, otherwise use the timestamp the driver got from the camera.
+	guint64 cameraTicks = ptrGrabResult->GetTimeStamp();
+	CChunkMeta *pChunkMeta = CChunkMeta::Get(buffer);
+	if (pChunkMeta != NULL)
+	{
+		if (pChunkMeta->Has(CChunkMeta::Field_Timestamp) == true)
+			cameraTicks = pChunkMeta->timestamp;
+	}
+	else if (ptrGrabResult->IsChunkDataAvailable() == true)
+	{
+		GenApi::CIntegerPtr chunkTimestamp = ptrGrabResult->GetChunkDataNodeMap().GetNode("ChunkTimestamp");
+		if (IsReadable(chunkTimestamp))
+			cameraTicks = (guint64)chunkTimestamp->GetValue();
+	}
+
+	m_timestampMapper.AddObservation(cameraTicks, hostTime);
+	GstClockTime arrivalTime = m_timestampMapper.ToHostTime(cameraTicks);
+
+	// The mapping lines the camera's clock up with the earliest arrival on the host.
+	// The camera timestamps the start of exposure, so the image was captured the exposure and readout time before that (see configure_latency()).
+	if (arrivalTime == GST_CLOCK_TIME_NONE)
+		return;
+
+	// An image captured before the pipeline started running starts the timeline at 0, rather than mixing in AppSrc's push time.
+	GstClockTime pts = 0;
+	if (arrivalTime >= baseTime + m_captureLatency)
+		pts = arrivalTime - m_captureLatency - baseTime;
+
+	// keep timestamps increasing, even when the estimated mapping moves.
+	if (m_lastPts != GST_CLOCK_TIME_NONE && pts <= m_lastPts)
+		pts = m_lastPts + 1;
+	m_lastPts = pts;
+
+	// raw video is never reordered, so the decoding timestamp is the same.
+	GST_BUFFER_PTS(buffer) = pts;
+	GST_BUFFER_DTS(buffer) = pts;
+}
+
+// Start the acquisition and delivery threads of push mode
+void CInstantCameraAppSrc::start_push_threads()
+{
+	// In push mode AppSrc is fed continuously, so it needs a limit on how much it queues.
+	g_object_set(G_OBJECT(m_appsrc),
+		"max-bytes", get_appsrc_max_bytes(),
+		"block", m_appsrcBlock ? TRUE : FALSE,
+		NULL);
+
+	m_frameRing.Reset(m_ringDepth);
+	m_isPushing = true;
+	m_acquisitionThread = std::thread(&CInstantCameraAppSrc::acquisition_loop, this);
+	m_deliveryThread = std::thread(&CInstantCameraAppSrc::delivery_loop, this);
+}
+
+// How many bytes AppSrc may queue in push mode
+guint64 CInstantCameraAppSrc::get_appsrc_max_bytes()
+{
+	if (m_appsrcMaxBytes != 0)
+		return m_appsrcMaxBytes;
+	if (m_isLowLatency == true)
+		return m_frameSize;
+	return (guint64)m_ringDepth * m_frameSize;
+}
+
+// Stop the push mode threads and release any images left in the ring
+void CInstantCameraAppSrc::stop_push_threads()
+{
+	m_isPushing = false;
+	m_frameRing.Interrupt();
+
+	if (m_acquisitionThread.joinable())
+		m_acquisitionThread.join();
+	if (m_deliveryThread.joinable())
+		m_deliveryThread.join();
+
+	GstBuffer *buffer;
+	while (m_frameRing.Pop(buffer) == true)
+		gst_buffer_unref(buffer);
+}
+
+// Push mode: retrieve and convert images as they arrive, and hand them to the delivery thread
+void CInstantCameraAppSrc::acquisition_loop()
+{
+	while (m_isPushing == true)
+	{
+		try
+		{
+			// If we discover the camera is removed, send the EOS signal.
+			if (IsCameraDeviceRemoved() == true)
+			{
+				cout << "Camera Removed!" << endl;
+				GstFlowReturn ret;
+				g_signal_emit_by_name(m_appsrc, "end-of-stream", &ret);
+				return;
+			}
+
+			// Use a short timeout, so we notice when to stop.
+			GstBuffer *buffer = grab_image(100, Pylon::ETimeoutHandling::TimeoutHandling_Return);
+			if (buffer == NULL)
+				continue;
+
+			bool isQueued = m_frameRing.Push(buffer);
+			while (isQueued == false && m_dropPolicy == DropPolicy_Wait && m_isPushing == true)
+			{
+				m_frameRing.WaitForSpace(100);
+				isQueued = m_frameRing.Push(buffer);
+			}
+
+			// the ring is full and we drop the new image (or we are stopping)
+			if (isQueued == false)
+			{
+				gst_buffer_unref(buffer);
+				m_numFramesDropped++;
+			}
+		}
+		catch (GenICam::GenericException &e)
+		{
+			cerr << "An exception occured in acquisition_loop(): " << endl << e.GetDescription() << endl;
+			// wait the grab timeout before trying again, so a lasting failure doesn't spin this thread.
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+		catch (std::exception &e)
+		{
+			cerr << "An exception occurred in acquisition_loop(): " << endl << e.what() << endl;
+			// wait the grab timeout before trying again, so a lasting failure doesn't spin this thread.
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+	}
+}
+
+// Push mode: push the images from the ring to AppSrc
+void CInstantCameraAppSrc::delivery_loop()
+{
+	while (m_isPushing == true)
+	{
+		GstBuffer *buffer;
+		if (m_frameRing.Pop(buffer) == false)
+		{
+			m_frameRing.WaitForItem(100);
+			continue;
+		}
+
+		CFrameTraceMeta *pTrace = CFrameTraceMeta::Get(buffer);
+		if (pTrace != NULL)
+			pTrace->pushedTime = get_clock_time();
+
+		// If AppSrc is full and "block" is set, this waits until the pipeline has taken enough images.
+		GstFlowReturn ret;
+		g_signal_emit_by_name(m_appsrc, "push-buffer", buffer, &ret);
+		gst_buffer_unref(buffer);
+		m_numFramesPushed++;
+	}
+}
+
+// Work out how old images are when they leave the source, and how long they may wait in queues on the way.
+// AppSrc reports this in latency queries, so live sinks can schedule rendering with the right latency budget.
+void CInstantCameraAppSrc::configure_latency()
+{
+	// The exposure and readout have to finish before an image can arrive on the host.
+	double exposureTime = 0; // us
+	if (IsReadable(GetNodeMap().GetNode("ExposureTime")))
+		exposureTime = GenApi::CFloatPtr(GetNodeMap().GetNode("ExposureTime"))->GetValue(); // BCON and USB use SFNC3 names.
+	else if (IsReadable(GetNodeMap().GetNode("ExposureTimeAbs")))
+		exposureTime = GenApi::CFloatPtr(GetNodeMap().GetNode("ExposureTimeAbs"))->GetValue();
+
+	double readoutTime = 0; // us
+	if (IsReadable(GetNodeMap().GetNode("SensorReadoutTime")))
+		readoutTime = GenApi::CFloatPtr(GetNodeMap().GetNode("SensorReadoutTime"))->GetValue(); // usb
+	else if (IsReadable(GetNodeMap().GetNode("ReadoutTimeAbs")))
+		readoutTime = GenApi::CFloatPtr(GetNodeMap().GetNode("ReadoutTimeAbs"))->GetValue(); // gige
+
+	m_captureLatency = (GstClockTime)((exposureTime + readoutTime) * GST_USECOND);
+
+	// With hardware timestamps, the timestamp is the capture time, so images are already that old when they are pushed.
+	// Without, AppSrc timestamps the images when they are pushed.
+	m_minLatency = (m_isHardwareTimestamped == true) ? m_captureLatency : 0;
+
+	// After that, an image may wait in the Grab Engine's Output Queue, and in push mode in the ring and AppSrc's queue, one frame period per image.
+	GstClockTime framePeriod = (m_frameRateNum > 0) ? gst_util_uint64_scale_int(GST_SECOND, m_frameRateDen, m_frameRateNum) : 0;
+	guint64 numQueued = 1;
+	if (m_grabStrategy == Pylon::GrabStrategy_LatestImages)
+		numQueued = OutputQueueSize.GetValue();
+	else if (m_grabStrategy == Pylon::GrabStrategy_OneByOne)
+		numQueued = MaxNumBuffer.GetValue();
+	if (m_isPushMode == true && m_frameSize > 0)
+		numQueued += m_ringDepth + get_appsrc_max_bytes() / m_frameSize;
+	else if (m_isExternalRetrieval == true && m_frameSize > 0)
+		numQueued += get_appsrc_max_bytes() / m_frameSize;
+
+	m_maxLatency = m_minLatency + numQueued * framePeriod;
+
+	if (m_appsrc != NULL)
+	{
+		g_object_set(G_OBJECT(m_appsrc),
+			"min-latency", (gint64)m_minLatency,
+			"max-latency", (gint64)m_maxLatency,
+			NULL);
+	}
+
+	cout << "Source latency           : " << (double)m_minLatency / GST_MSECOND << " ms to " << (double)m_maxLatency / GST_MSECOND << " ms" << endl;
+}
+
+// Set up the striped color conversion (see SetConversionStripes()), and the host rescaling and rotation (see SetFusedTransform())
+void CInstantCameraAppSrc::configure_conversion()
+{
+	m_isTransforming = uses_fused_transform();
+
+	// mono images, raw Bayer and images already in the pushed format (eg: RGB8, YUV422) are never converted, only unpacked if they are packed
+	int numStripes = 1;
+	if ((m_isColor == true && uses_raw_bayer() == false && m_cameraPixelType != m_pixelType) || CPixelKernels::GetUnpackedPixelType(m_cameraPixelType) != Pylon::PixelType_Undefined || m_isTransforming == true)
+	{
+		numStripes = m_numConversionStripes;
+		if (numStripes == 0)
+			numStripes = std::max((int)std::thread::hardware_concurrency(), 1);
+	}
+
+	if (numStripes > 1 && m_pWorkerPool == NULL)
+	{
+		m_pWorkerPool = new CWorkerPool(numStripes - 1);
+		m_ownsWorkerPool = true;
+	}
+
+	m_FormatConverter.SetWorkerPool(m_pWorkerPool);
+	m_FormatConverter.SetNumStripes(numStripes);
+
+	m_transformBuffer.clear();
+	if (m_isTransforming == false)
+		return;
+
+	// Rescale the image first and rotate the rescaled image, like videoscale and videoflip did. I420's chroma planes are half the size in both directions.
+	uint32_t width = this->GetWidth();
+	uint32_t height = this->GetHeight();
+	bool hasScaledSize = m_scaledWidth >= 2 && m_scaledHeight >= 2;
+	uint32_t scaledWidth = (hasScaledSize == true) ? m_scaledWidth : width;
+	uint32_t scaledHeight = (hasScaledSize == true) ? m_scaledHeight : height;
+	m_lumaTransform.SetWorkerPool(m_pWorkerPool);
+	m_lumaTransform.SetNumStripes(numStripes);
+	m_lumaTransform.Configure(width, height, scaledWidth, scaledHeight, m_hostRotation, m_isHostFlippedX, m_isHostFlippedY);
+
+	if (m_isColor == true)
+	{
+		m_chromaTransform.SetWorkerPool(m_pWorkerPool);
+		m_chromaTransform.SetNumStripes(numStripes);
+		m_chromaTransform.Configure(width / 2, height / 2, (scaledWidth + 1) / 2, (scaledHeight + 1) / 2, m_hostRotation, m_isHostFlippedX, m_isHostFlippedY);
+		m_transformBuffer.resize(CPixelKernels::GetYuv420Layout(width, height, false).size);
+	}
+	else if (CPixelKernels::GetUnpackedPixelType(m_cameraPixelType) != Pylon::PixelType_Undefined)
+	{
+		m_transformBuffer.resize((size_t)width * height * 2);
+	}
+
+	cout << "Rescaling and rotating   : " << width << " x " << height << " -> " << get_output_width() << " x " << get_output_height() << " on the host" << endl;
+}
+
+// Check if the images are demosaiced straight to YUV (see SetBayerToYuv()). The kernels need an even width and height.
+bool CInstantCameraAppSrc::uses_bayer_to_yuv()
+{
+	return m_isColor == true && m_isBayerToYuv == true && uses_raw_bayer() == false && CPixelKernels::IsBayer8(m_cameraPixelType) == true && (this->GetWidth() % 2) == 0 && (this->GetHeight() % 2) == 0;
+}
+
+// Check if Bayer images are pushed as they are (see SetRawBayer()). Packed Bayer formats are unpacked to 16 bits per pixel first.
+bool CInstantCameraAppSrc::uses_raw_bayer()
+{
+	return m_isColor == true && m_isRawBayer == true && Pylon::IsBayer(m_cameraPixelType) == true &&
+		((Pylon::BitPerPixel(m_cameraPixelType) % 8) == 0 || CPixelKernels::GetUnpackedPixelType(m_cameraPixelType) != Pylon::PixelType_Undefined);
+}
+
+// The pixel format of the images pushed to the pipeline, unless they are demosaiced to YUV
+Pylon::EPixelType CInstantCameraAppSrc::get_output_pixel_type()
+{
+	if (uses_raw_bayer() == false)
+		return m_pixelType;
+	if (CPixelKernels::GetUnpackedPixelType(m_cameraPixelType) != Pylon::PixelType_Undefined)
+		return CPixelKernels::GetUnpackedPixelType(m_cameraPixelType);
+	return m_cameraPixelType;
+}
+
+// Check if images are rescaled and rotated on the host (see SetFusedTransform()).
+// CScaleRotate works on planes of 8 or 16-bit pixels, so only I420 (from the Bayer kernels) and mono images qualify.
+bool CInstantCameraAppSrc::uses_fused_transform()
+{
+	if (m_isFusedTransform == false || uses_raw_bayer() == true)
+		return false;
+
+	bool isScaling = m_scaledWidth >= 2 && m_scaledHeight >= 2 && (m_scaledWidth != this->GetWidth() || m_scaledHeight != this->GetHeight());
+	bool isRotating = m_hostRotation != 0 || m_isHostFlippedX == true || m_isHostFlippedY == true;
+	if (isScaling == false && isRotating == false)
+		return false;
+
+	if (m_isColor == true)
+		return uses_bayer_to_yuv() == true && m_isNV12 == false && this->GetWidth() >= 4 && this->GetHeight() >= 4;
+	return m_pixelType == Pylon::PixelType_Mono8 || (Pylon::BitPerPixel(m_pixelType) == 16 && Pylon::IsMonoImage(m_pixelType) == true);
+}
+
+// The size of the images pushed to the pipeline: the camera's, or rescaled and rotated (see uses_fused_transform())
+int CInstantCameraAppSrc::get_output_width()
+{
+	if (uses_fused_transform() == false)
+		return this->GetWidth();
+	bool hasScaledSize = m_scaledWidth >= 2 && m_scaledHeight >= 2;
+	if (m_hostRotation == 90 || m_hostRotation == 270)
+		return (hasScaledSize == true) ? m_scaledHeight : this->GetHeight();
+	return (hasScaledSize == true) ? m_scaledWidth : this->GetWidth();
+}
+
+int CInstantCameraAppSrc::get_output_height()
+{
+	if (uses_fused_transform() == false)
+		return this->GetHeight();
+	bool hasScaledSize = m_scaledWidth >= 2 && m_scaledHeight >= 2;
+	if (m_hostRotation == 90 || m_hostRotation == 270)
+		return (hasScaledSize == true) ? m_scaledWidth : this->GetWidth();
+	return (hasScaledSize == true) ? m_scaledHeight : this->GetHeight();
+}
+
+// Size the Grab Engine's buffers (MaxNumBuffer) and output queue for the grab strategy used.
+void CInstantCameraAppSrc::configure_grab_buffers()
+{
+	// In zero-copy mode, buffers travelling through the pipeline still belong to the Grab Engine, so it needs that many extra.
+	int numPipelineBuffers = (m_isZeroCopy == true || m_isGstBufferFactory == true) ? m_bufferPoolDepth : 0;
+
+	switch (m_grabStrategy)
+	{
+	case Pylon::GrabStrategy_OneByOne:
+		// Every image waits in the Output Queue until we retrieve it. Give the Grab Engine about one second of images to bridge pipeline hiccups.
+		if (m_numGrabBuffers > 0)
+			MaxNumBuffer.SetValue(m_numGrabBuffers + numPipelineBuffers);
+		else
+			MaxNumBuffer.SetValue(std::max((int)m_frameRate, 10) + numPipelineBuffers);
+		break;
+	case Pylon::GrabStrategy_LatestImages:
+		// Keep the latest N images. Two more buffers let the Grab Engine keep grabbing while N images are waiting.
+		{
+			int numLatest = (m_numGrabBuffers > 0) ? m_numGrabBuffers : 1;
+			OutputQueueSize.SetValue(numLatest);
+			MaxNumBuffer.SetValue(numLatest + 2 + numPipelineBuffers);
+		}
+		break;
+	case Pylon::GrabStrategy_UpcomingImage:
+	case Pylon::GrabStrategy_LatestImageOnly:
+	default:
+		// Only one image is ever waiting, a few buffers are plenty.
+		if (m_numGrabBuffers > 0)
+			MaxNumBuffer.SetValue(m_numGrabBuffers + numPipelineBuffers);
+		else
+			MaxNumBuffer.SetValue(10 + numPipelineBuffers);
+		break;
+	}
+}
+
+// Check if a grab result can be pushed into the pipeline without conversion (ie: it already has the format announced in the caps)
+bool CInstantCameraAppSrc::is_zero_copy_compatible(Pylon::CGrabResultPtr &ptrGrabResult)
+{
+	EPixelType pixelType = ptrGrabResult->GetPixelType();
+
+	if (pixelType != get_output_pixel_type() || m_isTransforming == true)
+		return false;
+
+	// MSB alignment changes every pixel
+	if (m_isMsbAligned == true && Pylon::BitDepth(pixelType) > 8 && Pylon::BitDepth(pixelType) < 16)
+		return false;
+
+	// Packed formats are unpacked first (see GetUnpackedPixelType()) and padded lines don't match the caps' line stride.
+	switch (pixelType)
+	{
+		case Pylon::PixelType_Mono8:
+		case Pylon::PixelType_Mono10:
+		case Pylon::PixelType_Mono12:
+		case Pylon::PixelType_Mono16:
+		case Pylon::PixelType_RGB8packed:
+		case Pylon::PixelType_YUV422packed:
+		case Pylon::PixelType_YUV422_YUYV_Packed:
+			return ptrGrabResult->GetPaddingX() == 0;
+		case Pylon::PixelType_YUV422planar:
+			// GStreamer pads the chroma rows unless the width is a multiple of 8 (see CPixelKernels::GetY42BLayout())
+			return ptrGrabResult->GetPaddingX() == 0 && (ptrGrabResult->GetWidth() % 8) == 0;
+		default:
+			// raw Bayer (see SetRawBayer())
+			return Pylon::IsBayer(pixelType) == true && (Pylon::BitPerPixel(pixelType) % 8) == 0 && ptrGrabResult->GetPaddingX() == 0;
+	}
+}
+
+// Create and activate the pool of frame buffers for the images pushed to the pipeline
+bool CInstantCameraAppSrc::create_buffer_pool()
+{
+	destroy_buffer_pool();
+
+	// The size of one image in the format pushed to the pipeline (see GetSource()).
+	if (uses_bayer_to_yuv() == true)
+		m_frameSize = CPixelKernels::GetYuv420Layout(get_output_width(), get_output_height(), m_isNV12).size;
+	else if (m_pixelType == Pylon::PixelType_YUV422planar)
+		m_frameSize = CPixelKernels::GetY42BLayout(this->GetWidth(), this->GetHeight()).size;
+	else
+		m_frameSize = ((size_t)get_output_width() * get_output_height() * Pylon::BitPerPixel(get_output_pixel_type()) + 7) / 8;
+
+	m_bufferPool = gst_buffer_pool_new();
+	GstStructure *config = gst_buffer_pool_get_config(m_bufferPool);
+
+	// Preallocate m_bufferPoolDepth buffers. Allow the pool to grow (max = 0) rather than blocking the streaming thread if the pipeline holds on to them all.
+	gst_buffer_pool_config_set_params(config, NULL, (guint)m_frameSize, m_bufferPoolDepth, 0);
+
+	// Align the buffers to cache lines, which also suits SIMD loads and stores downstream.
+	GstAllocationParams params;
+	gst_allocation_params_init(&params);
+	params.align = 63;
+	gst_buffer_pool_config_set_allocator(config, NULL, &params);
+
+	if (gst_buffer_pool_set_config(m_bufferPool, config) == FALSE || gst_buffer_pool_set_active(m_bufferPool, TRUE) == FALSE)
+	{
+		cerr << "Could not create a pool of " << m_bufferPoolDepth << " frame buffers of " << m_frameSize << " bytes." << endl;
+		destroy_buffer_pool();
+		return false;
+	}
+
+	return true;
+}
+
+// Release the pool. Buffers still in the pipeline are freed when the pipeline releases them.
+void CInstantCameraAppSrc::destroy_buffer_pool()
+{
+	if (m_lastBuffer != NULL)
+	{
+		gst_buffer_unref(m_lastBuffer);
+		m_lastBuffer = NULL;
+	}
+	if (m_bufferPool != NULL)
+	{
+		gst_buffer_pool_set_active(m_bufferPool, FALSE);
+		gst_object_unref(m_bufferPool);
+		m_bufferPool = NULL;
+	}
+}
+
+// Take a free frame buffer from the pool
+GstBuffer* CInstantCameraAppSrc::acquire_pooled_buffer()
+{
+	GstBuffer *buffer = NULL;
+
+	if (m_bufferPool == NULL || gst_buffer_pool_acquire_buffer(m_bufferPool, &buffer, NULL) != GST_FLOW_OK)
+	{
+		cerr << "Could not acquire a frame buffer from the pool." << endl;
+		return NULL;
+	}
+
+	return buffer;
+}
+
+// Convert (if color) or copy (if RGB or mono) the image of a grab result into a frame buffer from the pool
+GstBuffer* CInstantCameraAppSrc::fill_pooled_buffer(Pylon::CGrabResultPtr &ptrGrabResult)
+{
+	GstBuffer *buffer = acquire_pooled_buffer();
+	if (buffer == NULL)
+		return NULL;
+
+	GstMapInfo map;
+	if (gst_buffer_map(buffer, &map, GST_MAP_WRITE) == FALSE)
+	{
+		gst_buffer_unref(buffer);
+		return NULL;
+	}
+
+	// if we rescale and rotate on the host, convert or unpack the image at full size first, then rescale and rotate it into the frame buffer
+	if (m_isTransforming == true)
+	{
+		transform_image(ptrGrabResult, map.data, map.size);
+	}
+	// if we have a color image, and the image is not RGB, convert it to RGB directly into the frame buffer
+	// (8-bit Bayer images are demosaiced straight to YUV instead. The kernel refuses images it can't convert, eg: odd sizes)
+	else if (m_isColor == true && uses_raw_bayer() == false && ptrGrabResult->GetPixelType() != m_pixelType && m_FormatConverter.ImageHasDestinationFormat(ptrGrabResult) == false)
+	{
+		if (m_isBayerToYuv == false || m_FormatConverter.ConvertBayerToYuv420(map.data, map.size, ptrGrabResult, m_isNV12) == false)
+			m_FormatConverter.Convert(map.data, map.size, ptrGrabResult);
+	}
+	// else if we have a packed image (eg: Mono12p), unpack it to 16 bits per pixel directly into the frame buffer
+	else if (CPixelKernels::GetUnpackedPixelType(ptrGrabResult->GetPixelType()) != Pylon::PixelType_Undefined)
+	{
+		m_FormatConverter.UnpackTo16(map.data, map.size, ptrGrabResult, m_isMsbAligned);
+	}
+	// else if we have planar YUV 4:2:2, copy each plane into GStreamer's Y42B layout, whose rows may be longer than Pylon's
+	else if (ptrGrabResult->GetPixelType() == Pylon::PixelType_YUV422planar)
+	{
+		uint32_t width = ptrGrabResult->GetWidth();
+		uint32_t height = ptrGrabResult->GetHeight();
+		CPixelKernels::SYuvLayout layout = CPixelKernels::GetY42BLayout(width, height);
+		const uint8_t *pSource = (const uint8_t*)ptrGrabResult->GetBuffer();
+		size_t planeWidths[3] = { width, width / 2, width / 2 };
+
+		if (layout.size <= map.size && (size_t)width * height * 2 <= ptrGrabResult->GetImageSize())
+		{
+			for (int plane = 0; plane < 3; plane++)
+			{
+				for (uint32_t row = 0; row < height; row++)
+					memcpy(map.data + layout.offset[plane] + row * layout.stride[plane], pSource + row * planeWidths[plane], planeWidths[plane]);
+				pSource += planeWidths[plane] * height;
+			}
+		}
+	}
+	// else if we have an RGB image, a YUV 4:2:2 image, a Mono image or raw Bayer, simply copy the image (line by line if the lines are padded)
+	else
+	{
+		const uint8_t *pSource = (const uint8_t*)ptrGrabResult->GetBuffer();
+		size_t paddingX = ptrGrabResult->GetPaddingX();
+
+		if (paddingX == 0)
+		{
+			memcpy(map.data, pSource, min(map.size, ptrGrabResult->GetImageSize()));
+		}
+		else
+		{
+			size_t lineSize = ((size_t)ptrGrabResult->GetWidth() * Pylon::BitPerPixel(ptrGrabResult->GetPixelType()) + 7) / 8;
+			size_t numLines = min((size_t)ptrGrabResult->GetHeight(), map.size / lineSize);
+			for (size_t line = 0; line < numLines; line++)
+				memcpy(map.data + line * lineSize, pSource + line * (lineSize + paddingX), lineSize);
+		}
+
+		uint32_t bitDepth = Pylon::BitDepth(ptrGrabResult->GetPixelType());
+		if (m_isMsbAligned == true && Pylon::BitPerPixel(ptrGrabResult->GetPixelType()) == 16 && bitDepth < 16)
+			CPixelKernels::AlignMsb16((uint16_t*)map.data, map.size / 2, bitDepth);
+	}
+
+	gst_buffer_unmap(buffer, &map);
+
+	return buffer;
+}
+
+// Rescale and rotate the image of a grab result into a frame buffer (see SetFusedTransform()).
+// Bayer images are demosaiced to I420 at full size, and packed mono images unpacked, into m_transformBuffer first. Each plane is then transformed on its own.
+void CInstantCameraAppSrc::transform_image(Pylon::CGrabResultPtr &ptrGrabResult, uint8_t *pDestination, size_t destinationSize)
+{
+	uint32_t width = ptrGrabResult->GetWidth();
+	uint32_t height = ptrGrabResult->GetHeight();
+	uint32_t outputWidth = m_lumaTransform.GetOutputWidth();
+	uint32_t outputHeight = m_lumaTransform.GetOutputHeight();
+
+	if (m_isColor == true)
+	{
+		if (m_FormatConverter.ConvertBayerToYuv420(m_transformBuffer.data(), m_transformBuffer.size(), ptrGrabResult, false) == false)
+			return;
+
+		CPixelKernels::SYuvLayout source = CPixelKernels::GetYuv420Layout(width, height, false);
+		CPixelKernels::SYuvLayout destination = CPixelKernels::GetYuv420Layout(outputWidth, outputHeight, false);
+		if (destination.size > destinationSize)
+			return;
+
+		m_lumaTransform.Transform(m_transformBuffer.data(), source.stride[0], pDestination, destination.stride[0]);
+		for (int plane = 1; plane < 3; plane++)
+			m_chromaTransform.Transform(m_transformBuffer.data() + source.offset[plane], source.stride[plane], pDestination + destination.offset[plane], destination.stride[plane]);
+		return;
+	}
+
+	const uint8_t *pSource = (const uint8_t*)ptrGrabResult->GetBuffer();
+	size_t sourceStride = ((size_t)width * Pylon::BitPerPixel(ptrGrabResult->GetPixelType()) + 7) / 8 + ptrGrabResult->GetPaddingX();
+	if (CPixelKernels::GetUnpackedPixelType(ptrGrabResult->GetPixelType()) != Pylon::PixelType_Undefined)
+	{
+		if (m_FormatConverter.UnpackTo16(m_transformBuffer.data(), m_transformBuffer.size(), ptrGrabResult, false) == false)
+			return;
+		pSource = m_transformBuffer.data();
+		sourceStride = (size_t)width * 2;
+	}
+
+	size_t bytesPerPixel = Pylon::BitPerPixel(m_pixelType) / 8;
+	if ((size_t)outputWidth * outputHeight * bytesPerPixel > destinationSize)
+		return;
+
+	if (bytesPerPixel == 1)
+	{
+		m_lumaTransform.Transform(pSource, sourceStride, pDestination, outputWidth);
+	}
+	else
+	{
+		m_lumaTransform.Transform((const uint16_t*)pSource, sourceStride, (uint16_t*)pDestination, outputWidth * 2);
+
+		uint32_t bitDepth = Pylon::BitDepth(m_pixelType);
+		if (m_isMsbAligned == true && bitDepth < 16)
+			CPixelKernels::AlignMsb16((uint16_t*)pDestination, (size_t)outputWidth * outputHeight, bitDepth);
+	}
+}
 
-			// if only connected as usb 2, reduce bandwidth to something stable, like 24MB/sec.
-			if (GenApi::CEnumerationPtr(GetNodeMap().GetNode("BslUSBSpeedMode"))->ToString() == "HighSpeed")
-			{
-				GenApi::CEnumerationPtr(GetNodeMap().GetNode("DeviceLinkThroughputLimitMode"))->FromString("On");
-				GenApi::CIntegerPtr(GetNodeMap().GetNode("DeviceLinkThroughputLimit"))->SetValue(24000000);
-			}
-		}
-		else if (GetDeviceInfo().GetDeviceClass() == "BaslerGigE")
-		{
-			// some gige-specific settings for performance
-			GenApi::CIntegerPtr(GetNodeMap().GetNode("GevSCPSPacketSize"))->SetValue(1500); // set a usually-known-good gige packet size, like 1500.
-		}
+// Wrap the buffer of a grab result in a gst buffer without copying it.
+// The gst buffer keeps its own reference to the grab result, so the Grab Engine gets the buffer back only when the pipeline is done with it.
+GstBuffer* CInstantCameraAppSrc::wrap_grab_result(Pylon::CGrabResultPtr &ptrGrabResult)
+{
+	Pylon::CGrabResultPtr *pHeldResult = new Pylon::CGrabResultPtr(ptrGrabResult);
 
+	// The driver grabbed into GStreamer memory (see SetGstBufferFactory()). Push a share of that memory, which holds the grab result.
+	// Holding it on the memory rather than the buffer also covers buffer copies downstream that still share the memory.
+	if (m_isGstBufferFactory == true)
+	{
+		GstMemory *memory = gst_memory_share(CGstBufferFactory::GetMemory(ptrGrabResult->GetBufferContext()), 0, ptrGrabResult->GetImageSize());
+		gst_mini_object_set_qdata(GST_MINI_OBJECT(memory), g_quark_from_static_string("PylonGrabResult"), pHeldResult, cb_release_grab_result);
 
-		// Check the current pixelFormat of the camera to see if the camera should be treated as color or mono
-		GenApi::CEnumerationPtr PixelFormat = GetNodeMap().GetNode("PixelFormat");
-		if (Pylon::IsMonoImage(Pylon::CPixelTypeMapper::GetPylonPixelTypeByName(PixelFormat->ToString())) == true)
-			m_isColor = false;
-		else
-			m_isColor = true;
+		GstBuffer *buffer = gst_buffer_new();
+		gst_buffer_append_memory(buffer, memory);
+		return buffer;
+	}
 
-		// Performance tip: If using a color camera, try using RGB format in the camera. Debayering, conversion to RGB, and PGI enhancement will be all done inside the camera.
-		//                  This means the host doesn't have to do anything (in this sample, GStreamer is expecting RGB format for color).
-		//                  Using other color formats will mean needing at least a conversion on the host (e.g with the CImageFormatConverter),
-		//                  or at most a debayering and a conversion (e.g. BayerRG8).
-		//if (colorCamera == true && GenApi::IsAvailable(PixelFormat->GetEntryByName("RGB8")) == true)
-		//PixelFormat->FromString("RGB8");
+	return gst_buffer_new_wrapped_full(
+		(GstMemoryFlags)GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS,
+		ptrGrabResult->GetBuffer(),
+		ptrGrabResult->GetImageSize(),
+		0,
+		ptrGrabResult->GetImageSize(),
+		pHeldResult,
+		cb_release_grab_result);
+}
 
-		// Configure some Pylon driver settings
-		//MaxNumBuffer.SetValue(20); // in case we use a grab strategy besides 'latest image only'
+// Stop the image grabbing of camera and driver
+bool CInstantCameraAppSrc::StopCamera()
+{
+	try
+	{
+		// send an EOS event to effectively stop need-data signals. Otherwise the clearing of grab engine buffers by stopgrabbing()
+		// may occur during a subsequent retrieve_image(), which could lead to a null grabresult pointer ("no grab result data referenced error")
+		cout << "Sending EOS event..." << endl;
+		gst_element_send_event(m_appsrc, gst_event_new_eos());
 
-		// Configure the Pylon image format converter
-		// We're going to use GStreamer's RGB format in pipelines, so we may need to use Pylon to convert the camera's image to RGB (depending on the camera used)
-		EPixelType pixelType = Pylon::EPixelType::PixelType_RGB8packed;
-		m_FormatConverter.OutputPixelFormat.SetValue(pixelType);
+		// in push mode, also stop our own threads that retrieve and push images.
+		if (m_isPushing == true)
+			stop_push_threads();
 
-		// setup some settings common to most cameras (it's always best to check if a feature is available before setting it)
-		if (m_isTriggered == false)
-		{
-			if (m_frameRate == -1)
-			{
-				m_frameRate = this->GetFrameRate();
-			}
+		// publish the statistics once more, while the stream grabber still has them
+		stop_stats_thread();
+		publish_stats();
 
-			if (IsWritable(GetNodeMap().GetNode("AcquisitionFrameRateEnable")))
-				GenApi::CBooleanPtr(GetNodeMap().GetNode("AcquisitionFrameRateEnable"))->SetValue(true);
-			if (IsWritable(GetNodeMap().GetNode("AcquisitionFrameRateAbs")))
-				GenApi::CFloatPtr(GetNodeMap().GetNode("AcquisitionFrameRateAbs"))->SetValue(m_frameRate); // this is called "AcquisitionFrameRate" (not abs) in usb cameras. Migration mode lets us use the old name though.
-			if (IsWritable(GetNodeMap().GetNode("AcquisitionFrameRate")))
-				GenApi::CFloatPtr(GetNodeMap().GetNode("AcquisitionFrameRate"))->SetValue(m_frameRate); // BCON and USB use SFNC3 names.
-		}
+		cout << "Stopping Camera image acquistion and Pylon image grabbing..." << endl;
+		StopGrabbing();
 
-		// Initialize the Pylon image to a blank image on the off chance that the very first m_Image can't be supplied by the instant camera (ie: missing trigger signal)
-		m_Image.Reset(pixelType, m_width, m_height);
+		if (m_isHardwareTimestamped == true)
+			cout << "Camera clock drift relative to pipeline clock: " << m_timestampMapper.GetDrift() << " ppm" << endl;
+		cout << "Frames grabbed: " << m_numFramesGrabbed << ", pushed: " << m_numFramesPushed << ", dropped: " << m_numFramesDropped << endl;
+		cout << "Frames skipped: " << m_numFramesSkipped << ", lost: " << m_numFramesLost << ", failed: " << m_numFramesFailed << ", incomplete: " << m_numFramesIncomplete << ", duplicated: " << m_numFramesDuplicated << endl;
 
-		m_isInitialized = true;
+		// release the frame buffers. Those still in the pipeline are freed when the pipeline is done with them.
+		destroy_buffer_pool();
 
 		return true;
 	}
 	catch (GenICam::GenericException &e)
 	{
-		cerr << "An exception occured in InitCamera(): " << endl << e.GetDescription() << e.GetSourceFileName() << endl;
+		cerr << "An exception occured in StopCamera(): " << endl << e.GetDescription() << endl;
 		return false;
 
 	}
 	catch (std::exception &e)
 	{
-		cerr << "An exception occurred in InitCamera(): " << endl << e.what() << endl;
+		cerr << "An exception occurred in StopCamera(): " << endl << e.what() << endl;
 		return false;
 	}
 }
 
-// Start the image grabbing of camera and driver
-bool CInstantCameraAppSrc::StartCamera()
+// Change the AOI, pixel format and/or frame rate while the pipeline keeps running. -1 or "" keeps the current setting.
+// Grabbing only stops while the camera is reconfigured. The frame buffers are resized and AppSrc's caps updated, so the rest of the pipeline
+// renegotiates instead of being torn down (its elements must accept new caps, as videoconvert, videoscale and most sinks and encoders do).
+// The source bin is not rebuilt. Settings that need elements the bin was built without (eg: a mono bin switching to a color format) are refused,
+// and the camera keeps its previous settings.
+bool CInstantCameraAppSrc::Reconfigure(int width, int height, double framesPerSecond, string pixelFormat)
 {
 	try
 	{
@@ -353,158 +2357,261 @@ bool CInstantCameraAppSrc::StartCamera()
 			cout << "Camera not initialized. Run InitCamera() first." << endl;
 			return false;
 		}
+		if (m_appsrc == NULL)
+		{
+			cout << "Reconfiguring needs the source element. Run GetSource() first." << endl;
+			return false;
+		}
 
-		// Start grabbing images with the camera and pylon.
-		// Here we use Pylon's GrabStrategy_LatestImageOnly.
-		// This is good for display, and for benchmarking (because any "lag" between images is solely due to how fast the application can call app->grabFrame())
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
 
-		cout << "Starting Camera image acquistion and Pylon driver Grab Engine..." << endl;
-		if (m_isTriggered == true)
+		// keep retrieve_image() from grabbing while the camera is reconfigured
+		std::lock_guard<std::mutex> lock(m_grabMutex);
+
+		bool wasGrabbing = IsGrabbing();
+		bool wasPushing = m_isPushing;
+		if (wasPushing == true)
+			stop_push_threads();
+		if (wasGrabbing == true)
 		{
-			cout << "Camera will now expect a hardware trigger on: " << GenApi::CEnumerationPtr(GetNodeMap().GetNode("TriggerSource"))->ToString() << "..." << endl;
+			stop_stats_thread();
+			StopGrabbing();
 		}
-		StartGrabbing(Pylon::EGrabStrategy::GrabStrategy_LatestImageOnly);
 
-		// Note: At this point, the camera is acquiring and transmitting images, and the driver's Grab Engine is grabbing them.
-		//       When the Grab Engine has an image, it places it into it's Output Queue for retrieval by CInstantCamera::RetrieveResult().
-		//		 When the AppSrc needs an image to push to the GStreamer pipeline, it fires the "need-data" callback, which runs cb_need_data().
-		//		 cb_need_data() calls RetrieveImage(), which in turn calls RetrieveResult(), which retrieves an image from the Grab Engine Output Queue
-		//       If you like, you can see how many images are waiting for retrieval by checking camera.NumReadyBuffers.GetValue().
-		//
-		// Note: When using GrabStrategy_LatestImageOnly, there will always be only one image waiting in the Output Queue by design - the latest image to come in from the camera.
-		//		 LatestImageOnly is good for display applications and for benchmarking the application/host...
-		//		 ...because any "lag" or "stutter" seen in the display is purely dependent on how fast the application is retrieving images (slower application = more stutter).
+		// The new size is in sensor pixels, as in InitCamera(). Undo our binning, and choose it again for the new size below.
+		if (m_isCameraBinned == true)
+			reset_binning();
+
+		// remember the current settings, to go back to them if the source bin can't take the new ones
+		int previousWidth = this->GetWidth();
+		int previousHeight = this->GetHeight();
+		string previousPixelFormat = GenApi::CEnumerationPtr(GetNodeMap().GetNode("PixelFormat"))->ToString().c_str();
+
+		bool isApplied = set_image_format(width, height, pixelFormat);
+		update_pixel_types();
+		configure_binning();
+		configure_reverse();
+
+		// Without elements after AppSrc, the new images just flow out of the bin. Otherwise their format must still suit those elements.
+		bool needsConverter, needsRescaler, needsRotator;
+		get_source_bin_elements(needsConverter, needsRescaler, needsRotator);
+		bool hasElements = m_binHasConverter == true || m_binHasRescaler == true || m_binHasRotator == true;
+		if (isApplied == true &&
+			(uses_raw_bayer() != m_binIsRawBayer ||
+			(needsConverter == true && m_binHasConverter == false) ||
+			(needsRescaler == true && m_binHasRescaler == false) ||
+			(needsRotator == true && m_binHasRotator == false) ||
+			(hasElements == true && get_final_format() != m_binFinalFormat)))
+		{
+			cerr << "The source bin was built without the elements the new settings need. Build a new pipeline (GetSource()) to use them." << endl;
+			isApplied = false;
+		}
 
-		// Check that we are actually getting images before proceeding
-		//while (true)
-		//{
-		//	if (NumReadyBuffers.GetValue() > 0)
-		//	{
-		//		cout << "Images have begun arriving at Grab Engine and are ready to be retrieved and pushed to pipeline!" << endl;
-		//		break;
-		//	}
-		//}
+		if (isApplied == false)
+		{
+			if (m_isCameraBinned == true)
+				reset_binning();
+			set_image_format(previousWidth, previousHeight, previousPixelFormat);
+			update_pixel_types();
+			configure_binning();
+			configure_reverse();
+		}
+		else if (framesPerSecond != -1 && m_isTriggered == false)
+		{
+			SetFrameRate(framesPerSecond);
+			m_frameRate = this->GetFrameRate(); // what the camera accepted
+		}
 
-		return true;
+		// the camera may have rounded the AOI to its increments, and the frame rate to what the AOI allows
+		m_width = this->GetWidth();
+		m_height = this->GetHeight();
+		gst_util_double_to_fraction(this->GetFrameRate(), &m_frameRateNum, &m_frameRateDen);
+		set_appsrc_caps();
+		update_source_bin();
+
+		if (wasGrabbing == true)
+		{
+			if (create_buffer_pool() == false)
+				return false;
+			configure_grab_buffers();
+			configure_latency();
+			configure_conversion();
+			StartGrabbing(m_grabStrategy);
+			if (wasPushing == true)
+				start_push_threads();
+			if (m_isExternalRetrieval == true)
+				g_object_set(G_OBJECT(m_appsrc), "max-bytes", get_appsrc_max_bytes(), NULL);
+			start_stats_thread();
+		}
+
+		double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+		cout << "Reconfigured camera      : " << get_output_width() << " x " << get_output_height() << " " << get_appsrc_format() << " at " << this->GetFrameRate() << " fps in " << elapsedMs << " ms" << endl;
+
+		return isApplied;
 	}
 	catch (GenICam::GenericException &e)
 	{
-		cerr << "An exception occured in StartCamera(): " << endl << e.GetDescription() << endl;
+		cerr << "An exception occured in Reconfigure(): " << endl << e.GetDescription() << endl;
 		return false;
-
 	}
 	catch (std::exception &e)
 	{
-		cerr << "An exception occurred in StartCamera(): " << endl << e.what() << endl;
+		cerr << "An exception occurred in Reconfigure(): " << endl << e.what() << endl;
 		return false;
 	}
 }
 
-// Retrieve an image from the driver and place it into an image container
-bool CInstantCameraAppSrc::retrieve_image()
+// Set the camera's pixel format and AOI (centered, like InitCamera() does). -1 and "" keep the current setting. The camera must not be grabbing.
+bool CInstantCameraAppSrc::set_image_format(int width, int height, string pixelFormat)
 {
-	try
+	if (pixelFormat != "")
 	{
-		if (IsGrabbing() == false)
+		GenApi::CEnumerationPtr PixelFormat = GetNodeMap().GetNode("PixelFormat");
+		if (IsWritable(PixelFormat) == false || IsAvailable(PixelFormat->GetEntryByName(pixelFormat.c_str())) == false)
 		{
-			cout << "Camera is not Grabbing. Run StartCamera() first." << endl;
+			cerr << "Pixel format " << pixelFormat << " is not available." << endl;
 			return false;
 		}
+		PixelFormat->FromString(pixelFormat.c_str());
+	}
+
+	if (width == -1 && height == -1)
+		return true;
 
-		// Description of "Grabbing" procedure:
-		// In this sample, the camera is always free-running and sending images to the Pylon driver's "Grab Engine".
-		// The Pylon Grab Engine is thus always spinning. It "Grabs" incoming data, places it into an empty buffer from its "Input Queue", and places the "Grab Result£ into its "Output Queue".
-		// Depending on the Pylon "Grab Strategy" used, buffers are recycled in different ways.
-		//  In this sample, the LatestImageOnly strategy is used. This means that only one Grab Result is kept in the Output Queue at a time.
-		//  If a new image comes from the camera before the previous is retrieved from the output queue, the previous one is overwritten with the newer one.
-		// The application retrieves a Grab Result by calling RetrieveResult. If the Grab Result is successful, then a good image is in the buffer. If it is not, there was a problem.
+	// With the offsets at 0, any size up to the maximum fits. The camera centers the AOI again afterwards.
+	if (IsWritable(GetNodeMap().GetNode("CenterX")))
+		GenApi::CBooleanPtr(GetNodeMap().GetNode("CenterX"))->SetValue(false);
+	if (IsWritable(GetNodeMap().GetNode("CenterY")))
+		GenApi::CBooleanPtr(GetNodeMap().GetNode("CenterY"))->SetValue(false);
+	if (IsWritable(GetNodeMap().GetNode("OffsetX")))
+		GenApi::CIntegerPtr(GetNodeMap().GetNode("OffsetX"))->SetValue(0);
+	if (IsWritable(GetNodeMap().GetNode("OffsetY")))
+		GenApi::CIntegerPtr(GetNodeMap().GetNode("OffsetY"))->SetValue(0);
+
+	// round the size down to the camera's increments, within its limits
+	const char *sizeNames[2] = { "Width", "Height" };
+	int sizes[2] = { width, height };
+	for (int i = 0; i < 2; i++)
+	{
+		GenApi::CIntegerPtr ptrSize = GetNodeMap().GetNode(sizeNames[i]);
+		if (sizes[i] == -1 || IsWritable(ptrSize) == false)
+			continue;
+		int64_t size = std::min<int64_t>(std::max<int64_t>(sizes[i], ptrSize->GetMin()), ptrSize->GetMax());
+		size -= (size - ptrSize->GetMin()) % ptrSize->GetInc();
+		ptrSize->SetValue(size);
+	}
 
-		// The CGrabResultPtr smart pointer contains information about the grab in question, as well as access to the buffer of pixel data.
-		Pylon::CGrabResultPtr ptrGrabResult;
+	set_aoi_offsets();
 
-		if (m_isOnDemand == true)
-		{
-			ExecuteSoftwareTrigger(); // TODO: Check for bug or broken camera on 21949158. It would "Grab Timeout" when used in the twocameras_compositor sample. Other camera combinations worked just fine.
-		}
-		// Retrieve a Grab Result from the Grab Engine's Output Queue. If nothing comes to the output queue in 5 seconds, throw a timeout exception.
-		RetrieveResult(5000, ptrGrabResult, Pylon::ETimeoutHandling::TimeoutHandling_ThrowException);
-		// if the Grab Result indicates success, then we have a good image within the result.
-		if (ptrGrabResult->GrabSucceeded())
+	return true;
+}
+
+// Place the AOI on the sensor at m_offsetX, m_offsetY (see SetRegion()), or centered if -1.
+// The offsets are rounded down to the camera's increments and kept within the sensor.
+void CInstantCameraAppSrc::set_aoi_offsets()
+{
+	const char *centerNames[2] = { "CenterX", "CenterY" };
+	const char *offsetNames[2] = { "OffsetX", "OffsetY" };
+	int offsets[2] = { m_offsetX, m_offsetY };
+	for (int i = 0; i < 2; i++)
+	{
+		if (offsets[i] == -1)
 		{
-			// if we have a color image, and the image is not RGB, convert it to RGB and place it into the CInstantCameraAppSrc::image for GStreamer
-			if (m_isColor == true && m_FormatConverter.ImageHasDestinationFormat(ptrGrabResult) == false)
-			{
-				m_FormatConverter.Convert(m_Image, ptrGrabResult);
-			}
-			// else if we have an RGB image or a Mono image, simply copy the image to CInstantCameraAppSrc::image
-			// (push a copy of the image to the pipeline instead of a pointer in case we retrieve another image while the first is still going through the pipeline).
-			else if (m_FormatConverter.ImageHasDestinationFormat(ptrGrabResult) == true || Pylon::IsMonoImage(ptrGrabResult->GetPixelType()))
-			{
-				m_Image.CopyImage(ptrGrabResult);
-			}
+			if (IsWritable(GetNodeMap().GetNode(centerNames[i])))
+				GenApi::CBooleanPtr(GetNodeMap().GetNode(centerNames[i]))->SetValue(true);
+			continue;
 		}
-		else
+
+		if (IsWritable(GetNodeMap().GetNode(centerNames[i])))
+			GenApi::CBooleanPtr(GetNodeMap().GetNode(centerNames[i]))->SetValue(false);
+		GenApi::CIntegerPtr ptrOffset = GetNodeMap().GetNode(offsetNames[i]);
+		if (IsWritable(ptrOffset) == false)
+			continue;
+		int64_t offset = std::min<int64_t>(std::max<int64_t>(offsets[i], ptrOffset->GetMin()), ptrOffset->GetMax());
+		offset -= (offset - ptrOffset->GetMin()) % ptrOffset->GetInc();
+		ptrOffset->SetValue(offset);
+	}
+}
+
+// Digital pan and zoom: move (and resize) the camera's AOI on the sensor while streaming, eg: to follow a region.
+// Only the region then crosses the usb or gige link and is processed on the host, instead of full images cropped downstream (eg: videocrop).
+// offsetX, offsetY: the AOI's top left corner on the sensor. -1 = centered. width, height: -1 = keep the current size.
+// Moving the AOI keeps the images' size, so the camera keeps grabbing. Resizing it goes through Reconfigure().
+bool CInstantCameraAppSrc::SetRegion(int offsetX, int offsetY, int width, int height)
+{
+	try
+	{
+		if (m_isInitialized == false)
 		{
-			// If a Grab Failed, the Grab Result is tagged with information about why it failed (technically you could even still access the pixel data to look at the bad image too).
-			cout << "Pylon: Grab Result Failed! Error: " << ptrGrabResult->GetErrorDescription() << endl;
-			cout << "Will push last good image instead..." << endl;
+			cout << "Camera not initialized. Run InitCamera() first." << endl;
+			return false;
 		}
 
+		m_offsetX = offsetX;
+		m_offsetY = offsetY;
 
-		// create a gst buffer wrapping the image container's buffer
-		m_gstBuffer = gst_buffer_new_wrapped_full(
-			(GstMemoryFlags)GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS,
-			(gpointer)m_Image.GetBuffer(),
-			m_Image.GetImageSize(),
-			0,
-			m_Image.GetImageSize(),
-			NULL,
-			NULL);
+		bool isResizing = (width != -1 && width != this->GetWidth()) || (height != -1 && height != this->GetHeight());
+		if (isResizing == true && m_appsrc != NULL)
+			return Reconfigure(width, height);
 
-		// Push the gst buffer wrapping the image buffer to the source pads of the AppSrc element, where it's picked up by the rest of the pipeline
-		GstFlowReturn ret;
-		g_signal_emit_by_name(m_appsrc, "push-buffer", m_gstBuffer, &ret);
+		if (isResizing == true)
+		{
+			// nothing is streaming yet, so GetSource() will pick up the new size
+			if (IsGrabbing() == true)
+			{
+				cout << "Resizing the AOI while grabbing needs the source element. Run GetSource() first." << endl;
+				return false;
+			}
+			set_image_format(width, height, "");
+			m_width = this->GetWidth();
+			m_height = this->GetHeight();
+			return true;
+		}
 
+		set_aoi_offsets();
 		return true;
 	}
 	catch (GenICam::GenericException &e)
 	{
-		cerr << "An exception occured in retrieve_image(): " << endl << e.GetDescription() << endl;
+		cerr << "An exception occured in SetRegion(): " << endl << e.GetDescription() << endl;
 		return false;
 	}
 	catch (std::exception &e)
 	{
-		cerr << "An exception occurred in retrieve_image(): " << endl << e.what() << endl;
+		cerr << "An exception occurred in SetRegion(): " << endl << e.what() << endl;
 		return false;
 	}
 }
 
-// Stop the image grabbing of camera and driver
-bool CInstantCameraAppSrc::StopCamera()
+// Pass the messages from the application's bus watch on to the camera. Returns true if the message was for this camera.
+// Application messages named "camera-region" move and resize the AOI (see SetRegion()). Fields left out keep their current value,
+// and the "serial" field picks one camera when several share a pipeline. eg:
+//   gst_element_post_message(pipeline, gst_message_new_application(NULL, gst_structure_new("camera-region",
+//       "offset-x", G_TYPE_INT, 320, "offset-y", G_TYPE_INT, 240, "width", G_TYPE_INT, 640, "height", G_TYPE_INT, 480, NULL)));
+bool CInstantCameraAppSrc::HandleBusMessage(GstMessage *message)
 {
-	try
-	{
-		// send an EOS event to effectively stop need-data signals. Otherwise the clearing of grab engine buffers by stopgrabbing()
-		// may occur during a subsequent retrieve_image(), which could lead to a null grabresult pointer ("no grab result data referenced error")
-		cout << "Sending EOS event..." << endl;
-		gst_element_send_event(m_appsrc, gst_event_new_eos());
-
-		cout << "Stopping Camera image acquistion and Pylon image grabbing..." << endl;
-		StopGrabbing();
+	if (GST_MESSAGE_TYPE(message) != GST_MESSAGE_APPLICATION)
+		return false;
 
-		return true;
-	}
-	catch (GenICam::GenericException &e)
-	{
-		cerr << "An exception occured in StopCamera(): " << endl << e.GetDescription() << endl;
+	const GstStructure *structure = gst_message_get_structure(message);
+	if (structure == NULL || gst_structure_has_name(structure, "camera-region") == FALSE)
 		return false;
 
-	}
-	catch (std::exception &e)
-	{
-		cerr << "An exception occurred in StopCamera(): " << endl << e.what() << endl;
+	const gchar *serialNumber = gst_structure_get_string(structure, "serial");
+	if (serialNumber != NULL && string(serialNumber) != string(this->GetDeviceInfo().GetSerialNumber().c_str()))
 		return false;
-	}
+
+	int offsetX = m_offsetX;
+	int offsetY = m_offsetY;
+	int width = -1;
+	int height = -1;
+	gst_structure_get_int(structure, "offset-x", &offsetX);
+	gst_structure_get_int(structure, "offset-y", &offsetY);
+	gst_structure_get_int(structure, "width", &width);
+	gst_structure_get_int(structure, "height", &height);
+
+	SetRegion(offsetX, offsetY, width, height);
+	return true;
 }
 
 // Close the camera and do any other cleanup needed
@@ -662,316 +2769,96 @@ GstElement* CInstantCameraAppSrc::GetSource()
 			"format", GST_FORMAT_TIME,
 			"is-live", TRUE,
 			"num-buffers", m_numFramesToGrab,
-			"do-timestamp", TRUE, // required for H264 streaming
+			"do-timestamp", TRUE, // required for H264 streaming. With hardware timestamps, this only stamps buffers we couldn't stamp ourselves.
 			NULL);
 
-		// setup the appsrc caps (what kind of video is coming out of the source element?
+		// The camera's frame rate is rarely a whole number (eg: 29.97), so give the caps the exact fraction.
+		gst_util_double_to_fraction(this->GetFrameRate(), &m_frameRateNum, &m_frameRateDen);
 
-		// First, align the defintion of the Pylon image's pixel format to those available in the videoconvert element
-		// See Pylon's documentation for pixeltype definitions 
-		// See this link for gstreamer video format definitions (https://gstreamer.freedesktop.org/documentation/additional/design/mediatype-video-raw.html?gi-language=c)
-		// Videoconvert's format: { I420, YV12, YUY2, UYVY, AYUV, VUYA, RGBx, BGRx, xRGB, xBGR, RGBA, BGRA, ARGB, ABGR, RGB, BGR, Y41B, Y42B, YVYU, Y444, v210, v216, Y210, Y410, NV12, NV21, GRAY8, GRAY16_BE, GRAY16_LE, v308, RGB16, BGR16, RGB15, BGR15, UYVP, A420, RGB8P, YUV9, YVU9, IYU1, ARGB64, AYUV64, r210, I420_10BE, I420_10LE, I422_10BE, I422_10LE, Y444_10BE, Y444_10LE, GBR, GBR_10BE, GBR_10LE, NV16, NV24, NV12_64Z32, A420_10BE, A420_10LE, A422_10BE, A422_10LE, A444_10BE, A444_10LE, NV61, P010_10BE, P010_10LE, IYU2, VYUY, GBRA, GBRA_10BE, GBRA_10LE, BGR10A2_LE, RGB10A2_LE, GBR_12BE, GBR_12LE, GBRA_12BE, GBRA_12LE, I420_12BE, I420_12LE, I422_12BE, I422_12LE, Y444_12BE, Y444_12LE, GRAY10_LE32, NV12_10LE32, NV16_10LE32, NV12_10LE40 }
-		string format = "";
-		EPixelType pixelType = m_Image.GetPixelType();
-		switch (pixelType)
-		{
-			case Pylon::PixelType_Undefined:
-				// todo
-				break;
-			case Pylon::PixelType_Mono1packed:
-				format = "GRAY8";
-				break;
-			case Pylon::PixelType_Mono2packed:
-				format = "GRAY8";
-				break;
-			case Pylon::PixelType_Mono4packed:
-				format = "GRAY8";
-				break;
-			case Pylon::PixelType_Mono8:
-				format = "GRAY8";
-				break;
-			case Pylon::PixelType_Mono8signed:
-				format = "GRAY8";
-				break;
-			case Pylon::PixelType_Mono10:
-				format = "GRAY16_LE";
-				break;
-			case Pylon::PixelType_Mono10packed:
-				format = "GRAY16_LE";
-				break;
-			case Pylon::PixelType_Mono10p:
-				format = "GRAY16_LE";
-				break;
-			case Pylon::PixelType_Mono12:
-				format = "GRAY16_LE";
-				break;
-			case Pylon::PixelType_Mono12packed:
-				format = "GRAY16_LE";
-				break;
-			case Pylon::PixelType_Mono12p:
-				format = "GRAY16_LE";
-				break;
-			case Pylon::PixelType_Mono16:
-				format = "GRAY16_LE";
-				break;
-			case Pylon::PixelType_BayerGR8:
-				// todo
-				break;
-			case Pylon::PixelType_BayerRG8:
-				// todo
-				break;
-			case Pylon::PixelType_BayerGB8:
-				// todo
-				break;
-			case Pylon::PixelType_BayerBG8:
-				// todo
-				break;
-			case Pylon::PixelType_BayerGR10:
-				// todo
-				break;
-			case Pylon::PixelType_BayerRG10:
-				// todo
-				break;
-			case Pylon::PixelType_BayerGB10:
-				// todo
-				break;
-			case Pylon::PixelType_BayerBG10:
-				// todo
-				break;
-			case Pylon::PixelType_BayerGR12:
-				// todo
-				break;
-			case Pylon::PixelType_BayerRG12:
-				// todo
-				break;
-			case Pylon::PixelType_BayerGB12:
-				// todo
-				break;
-			case Pylon::PixelType_BayerBG12:
-				// todo
-				break;
-			case Pylon::PixelType_RGB8packed:
-				format = "RGB";
-				break;
-			case Pylon::PixelType_BGR8packed:
-				format = "BGR";
-				break;
-			case Pylon::PixelType_RGBA8packed:
-				format = "RGBA";
-				break;
-			case Pylon::PixelType_BGRA8packed:
-				format = "BGRA";
-				break;
-			case Pylon::PixelType_RGB10packed:
-				// todo
-				break;
-			case Pylon::PixelType_BGR10packed:
-				// todo
-				break;
-			case Pylon::PixelType_RGB12packed:
-				// todo
-				break;
-			case Pylon::PixelType_BGR12packed:
-				// todo
-				break;
-			case Pylon::PixelType_RGB16packed:
-				// todo
-				break;
-			case Pylon::PixelType_BGR10V1packed:
-				// todo
-				break;
-			case Pylon::PixelType_BGR10V2packed:
-				// todo
-				break;
-			case Pylon::PixelType_YUV411packed:
-				// todo
-				break;
-			case Pylon::PixelType_YUV422packed:
-				// todo
-				break;
-			case Pylon::PixelType_YUV444packed:
-				// todo
-				break;
-			case Pylon::PixelType_RGB8planar:
-				// todo
-				break;
-			case Pylon::PixelType_RGB10planar:
-				// todo
-				break;
-			case Pylon::PixelType_RGB12planar:
-				// todo
-				break;
-			case Pylon::PixelType_RGB16planar:
-				// todo
-				break;
-			case Pylon::PixelType_YUV422_YUYV_Packed:
-				// todo
-				break;
-			case Pylon::PixelType_YUV444planar:
-				// todo
-				break;
-			case Pylon::PixelType_YUV422planar:
-				// todo
-				break;
-			case Pylon::PixelType_YUV420planar:
-				format = "I420";
-				break;
-			case Pylon::PixelType_BayerGR12Packed:
-				// todo
-				break;
-			case Pylon::PixelType_BayerRG12Packed:
-				// todo
-				break;
-			case Pylon::PixelType_BayerGB12Packed:
-				// todo
-				break;
-			case Pylon::PixelType_BayerBG12Packed:
-				// todo
-				break;
-			case Pylon::PixelType_BayerGR10p:
-				// todo
-				break;
-			case Pylon::PixelType_BayerRG10p:
-				// todo
-				break;
-			case Pylon::PixelType_BayerGB10p:
-				// todo
-				break;
-			case Pylon::PixelType_BayerBG10p:
-				// todo
-				break;
-			case Pylon::PixelType_BayerGR12p:
-				// todo
-				break;
-			case Pylon::PixelType_BayerRG12p:
-				// todo
-				break;
-			case Pylon::PixelType_BayerGB12p:
-				// todo
-				break;
-			case Pylon::PixelType_BayerBG12p:
-				// todo
-				break;
-			case Pylon::PixelType_BayerGR16:
-				// todo
-				break;
-			case Pylon::PixelType_BayerRG16:
-				// todo
-				break;
-			case Pylon::PixelType_BayerGB16:
-				// todo
-				break;
-			case Pylon::PixelType_BayerBG16:
-				// todo
-				break;
-			case Pylon::PixelType_RGB12V1packed:
-				// todo
-				break;
-			case Pylon::PixelType_Double:
-				// todo
-				break;
-			default:
-				// todo
-				break;
-		}
-
-		g_object_set(G_OBJECT(m_appsrc), "caps",
-			gst_caps_new_simple("video/x-raw",
-			"format", G_TYPE_STRING, format.c_str(),
-			"width", G_TYPE_INT, this->GetWidth(), // just in case the camera used a different value than our desired, due to increment constraints
-			"height", G_TYPE_INT, this->GetHeight(),
-			"framerate", GST_TYPE_FRACTION, (int)this->GetFrameRate(), 1, NULL), NULL); // just in case we desired an u
+		// setup the appsrc caps (what kind of video is coming out of the source element?
+		set_appsrc_caps();
 
 		// connect the appsrc to the cb_need_data callback function. When appsrc sends the need-data signal, cb_need_data will run.
 		g_signal_connect(m_appsrc, "need-data", G_CALLBACK(cb_need_data), this);
 
-		// we can also bin the source with a videoscaler and videoflip element to offer easy rescaling and rotation to the user
-		GstElement *rescaler;
-		GstElement *rescalerCaps;
-		GstElement *rotator;
-		GstElement *converter;
-		GstElement *finalConverter;
-		GstElement *finalFilter;
-		GstCaps	   *finalFilter_caps;
-		rescaler = gst_element_factory_make("videoscale", "rescaler");
-		rescalerCaps = gst_element_factory_make("capsfilter", "rescalerCaps");
-		rotator = gst_element_factory_make("videoflip", "rotator");
-		converter = gst_element_factory_make("videoconvert", "converter");
-		finalConverter = gst_element_factory_make("videoconvert", "finalConverter");
-		finalFilter = gst_element_factory_make("capsfilter", "filter");
-
-		// configure the videoscaler and videoscaler caps elements
-		if (m_scaledWidth == -1 || m_scaledHeight == -1)
-		{
-			// don't do any rescaling
-			m_scaledWidth = this->GetWidth();
-			m_scaledHeight = this->GetHeight();
-		}
-		else if (m_scaledWidth < 2 || m_scaledHeight < 2)
-		{
-			// rescaling to widths less that 2 could cause buffer pool errors
-			cerr << "Scaling width and height must be greater than 2x2! Will not scale image!" << endl;
-			m_scaledWidth = this->GetWidth();
-			m_scaledHeight = this->GetHeight();
-		}
-
-		// configure the capsfilter after the videoscaler element, so it will apply scaling.
-		g_object_set(G_OBJECT(rescalerCaps), "caps",
-			gst_caps_new_simple("video/x-raw",
-			"format", G_TYPE_STRING, format.c_str(),
-			"width", G_TYPE_INT, m_scaledWidth,
-			"height", G_TYPE_INT, m_scaledHeight,
-			"framerate", GST_TYPE_FRACTION, (int)this->GetFrameRate(), 1, NULL), NULL);
-
-		// configure the videoflip element for rotation
-		if (m_rotation == -1 || m_rotation == 0)
-			m_rotation = 0; // GST_VIDEO_FLIP_METHOD_IDENTITY (none). We offer it as -1 to the user to remain consistent with other options where -1 = no effect
-		else if (m_rotation == 90)
-			m_rotation = 1; // GST_VIDEO_FLIP_METHOD_90R
-		else if (m_rotation == 180)
-			m_rotation = 2; // GST_VIDEO_FLIP_METHOD_180
-		else if (m_rotation == 270)
-			m_rotation = 3; // GST_VIDEO_FLIP_METHOD_90L
+		// combine the appsrc, rescaler, and rotator elements into a single binned element
+		// Give this "sourceBin" a unique name by adding the camera serial number, so that multiple cameras can be placed in the same pipeline.
+		string sourceBinName = "sourcebin";
+		sourceBinName.append(this->GetDeviceInfo().GetSerialNumber());
+		m_sourceBin = gst_bin_new(sourceBinName.c_str());
+
+		// Only add the elements the images need. Without conversion, rescaling or rotation, the bin is just AppSrc, which saves a pass over each image per element.
+		gst_bin_add(GST_BIN(m_sourceBin), m_appsrc);
+		GstElement *lastElement = m_appsrc;
+
+		if (uses_raw_bayer() == true)
+		{
+			// videoconvert, videoscale and videoflip don't take Bayer. Push it out of the bin as it is and let downstream demosaic (eg: bayer2rgb).
+			if ((m_scaledWidth != -1 && m_scaledHeight != -1) || m_hostRotation != 0 || m_isHostFlippedX == true || m_isHostFlippedY == true)
+				cerr << "Rescaling, and rotation the camera can't do, are not available with raw Bayer output. Rescale or rotate after demosaicing (eg: bayer2rgb)." << endl;
+		}
 		else
 		{
-			cerr << "Only rotation angles of 90, 180, 270 are supported! Will not rotate image!" << endl;
-			m_rotation = 0;
+			// check the rescaling. -1 = don't do any rescaling, so the images keep the camera's size, even when it changes (see Reconfigure()).
+			if (m_scaledWidth != -1 && m_scaledHeight != -1 && (m_scaledWidth < 2 || m_scaledHeight < 2))
+			{
+				// rescaling to widths less that 2 could cause buffer pool errors
+				cerr << "Scaling width and height must be greater than 2x2! Will not scale image!" << endl;
+				m_scaledWidth = -1;
+				m_scaledHeight = -1;
+			}
 		}
 
-		g_object_set(G_OBJECT(rotator), "method", m_rotation, NULL);
-		
-		// configure the final filter caps so that we output the common I420 format (if color)
-		if (m_isColor == true)
+		// convert first, so rescaling and rotation work on the (usually smaller) final format
+		string finalFormat = get_final_format();
+		get_source_bin_elements(m_binHasConverter, m_binHasRescaler, m_binHasRotator);
+		m_binIsRawBayer = uses_raw_bayer();
+		m_binFinalFormat = finalFormat;
+
+		if (m_binHasConverter == true)
 		{
-			finalFilter_caps = gst_caps_new_simple("video/x-raw",
-				"format", G_TYPE_STRING, "I420",
-				NULL);
+			lastElement = add_to_source_bin(lastElement, "videoconvert", "converter");
+			lastElement = add_to_source_bin(lastElement, "capsfilter", "filter");
+			set_caps_filter(lastElement, finalFormat, -1, -1);
 		}
-		else
+
+		if (m_binHasRescaler == true)
 		{
-			finalFilter_caps = gst_caps_new_simple("video/x-raw",
-				"format", G_TYPE_STRING, format.c_str(),
-				NULL);
+			// the capsfilter after the videoscaler element makes it apply the scaling
+			lastElement = add_to_source_bin(lastElement, "videoscale", "rescaler");
+			lastElement = add_to_source_bin(lastElement, "capsfilter", "rescalerCaps");
+			set_caps_filter(lastElement, finalFormat, m_scaledWidth, m_scaledHeight);
 		}
-			
-		g_object_set(G_OBJECT(finalFilter), "caps", finalFilter_caps, NULL);
-		gst_caps_unref(finalFilter_caps);
-		
-		// combine the appsrc, rescaler, and rotator elements into a single binned element
-		// Give this "sourceBin" a unique name by adding the camera serial number, so that multiple cameras can be placed in the same pipeline.
-		string sourceBinName = "sourcebin";
-		sourceBinName.append(this->GetDeviceInfo().GetSerialNumber());
-		m_sourceBin = gst_bin_new(sourceBinName.c_str());
 
-		gst_bin_add_many(GST_BIN(m_sourceBin), m_appsrc, converter, rescaler, rescalerCaps, rotator, finalConverter, finalFilter, NULL);
-		gst_element_link_many(m_appsrc, converter, rescaler, rescalerCaps, rotator, finalConverter, finalFilter, NULL);
+		if (m_binHasRotator == true)
+		{
+			// videoflip takes I420, packed YUV 4:2:2, RGB and GRAY8 in every GStreamer version. For other formats (eg: NV12, GRAY16_LE), videoconverts around it pick one it takes.
+			bool isFlippable = finalFormat == "I420" || finalFormat == "YUY2" || finalFormat == "UYVY" || finalFormat == "RGB" || finalFormat == "GRAY8";
+			if (isFlippable == false)
+				lastElement = add_to_source_bin(lastElement, "videoconvert", "rotatorConverter");
+
+			lastElement = add_to_source_bin(lastElement, "videoflip", "rotator");
+			g_object_set(G_OBJECT(lastElement), "method", get_flip_method(), NULL);
+
+			if (isFlippable == false)
+			{
+				lastElement = add_to_source_bin(lastElement, "videoconvert", "finalConverter");
+				lastElement = add_to_source_bin(lastElement, "capsfilter", "finalFilter");
+				set_caps_filter(lastElement, finalFormat, -1, -1);
+			}
+		}
 
 		// setup a ghost pad, so the src output of the last element in the bin attaches to the rest of the pipeline.
 		GstPad *binSrc;
-		binSrc = gst_element_get_static_pad(finalFilter, "src");
-		gst_element_add_pad(m_sourceBin, gst_ghost_pad_new("src", binSrc));
+		binSrc = gst_element_get_static_pad(lastElement, "src");
+		GstPad *ghostSrc = gst_ghost_pad_new("src", binSrc);
+		gst_element_add_pad(m_sourceBin, ghostSrc);
 		gst_object_unref(GST_OBJECT(binSrc));
 
+		// answer latency queries on the bin's src pad ourselves, with what we know about the camera (see configure_latency()).
+		g_object_set_data(G_OBJECT(ghostSrc), "camera", this);
+		gst_pad_set_query_function(ghostSrc, cb_query);
+
 		g_object_set(G_OBJECT(m_sourceBin),
 			"async-handling", TRUE,
 			"message-forward", TRUE,
@@ -991,6 +2878,359 @@ GstElement* CInstantCameraAppSrc::GetSource()
 	}
 }
 
+// The GStreamer format of the images pushed to AppSrc, derived from the pixel format (see InitCamera() and update_pixel_types())
+string CInstantCameraAppSrc::get_appsrc_format()
+{
+	// First, align the defintion of the Pylon image's pixel format to those available in the videoconvert element
+	// See Pylon's documentation for pixeltype definitions 
+	// See this link for gstreamer video format definitions (https://gstreamer.freedesktop.org/documentation/additional/design/mediatype-video-raw.html?gi-language=c)
+	// Videoconvert's format: { I420, YV12, YUY2, UYVY, AYUV, VUYA, RGBx, BGRx, xRGB, xBGR, RGBA, BGRA, ARGB, ABGR, RGB, BGR, Y41B, Y42B, YVYU, Y444, v210, v216, Y210, Y410, NV12, NV21, GRAY8, GRAY16_BE, GRAY16_LE, v308, RGB16, BGR16, RGB15, BGR15, UYVP, A420, RGB8P, YUV9, YVU9, IYU1, ARGB64, AYUV64, r210, I420_10BE, I420_10LE, I422_10BE, I422_10LE, Y444_10BE, Y444_10LE, GBR, GBR_10BE, GBR_10LE, NV16, NV24, NV12_64Z32, A420_10BE, A420_10LE, A422_10BE, A422_10LE, A444_10BE, A444_10LE, NV61, P010_10BE, P010_10LE, IYU2, VYUY, GBRA, GBRA_10BE, GBRA_10LE, BGR10A2_LE, RGB10A2_LE, GBR_12BE, GBR_12LE, GBRA_12BE, GBRA_12LE, I420_12BE, I420_12LE, I422_12BE, I422_12LE, Y444_12BE, Y444_12LE, GRAY10_LE32, NV12_10LE32, NV16_10LE32, NV12_10LE40 }
+	string format = "";
+	EPixelType pixelType = m_pixelType;
+	if (uses_raw_bayer() == true)
+		pixelType = get_output_pixel_type(); // pushed as it is (or unpacked), see below
+	else if (uses_bayer_to_yuv() == true)
+		pixelType = m_cameraPixelType; // demosaiced to YUV by CPixelKernels
+	switch (pixelType)
+	{
+		case Pylon::PixelType_Undefined:
+			// todo
+			break;
+		case Pylon::PixelType_Mono1packed:
+			format = "GRAY8";
+			break;
+		case Pylon::PixelType_Mono2packed:
+			format = "GRAY8";
+			break;
+		case Pylon::PixelType_Mono4packed:
+			format = "GRAY8";
+			break;
+		case Pylon::PixelType_Mono8:
+			format = "GRAY8";
+			break;
+		case Pylon::PixelType_Mono8signed:
+			format = "GRAY8";
+			break;
+		case Pylon::PixelType_Mono10:
+			format = "GRAY16_LE";
+			break;
+		case Pylon::PixelType_Mono10packed:
+			format = "GRAY16_LE";
+			break;
+		case Pylon::PixelType_Mono10p:
+			format = "GRAY16_LE";
+			break;
+		case Pylon::PixelType_Mono12:
+			format = "GRAY16_LE";
+			break;
+		case Pylon::PixelType_Mono12packed:
+			format = "GRAY16_LE";
+			break;
+		case Pylon::PixelType_Mono12p:
+			format = "GRAY16_LE";
+			break;
+		case Pylon::PixelType_Mono16:
+			format = "GRAY16_LE";
+			break;
+		case Pylon::PixelType_BayerGR8:
+			format = (uses_raw_bayer() == true) ? "grbg" : (m_isNV12 == true) ? "NV12" : "I420";
+			break;
+		case Pylon::PixelType_BayerRG8:
+			format = (uses_raw_bayer() == true) ? "rggb" : (m_isNV12 == true) ? "NV12" : "I420";
+			break;
+		case Pylon::PixelType_BayerGB8:
+			format = (uses_raw_bayer() == true) ? "gbrg" : (m_isNV12 == true) ? "NV12" : "I420";
+			break;
+		case Pylon::PixelType_BayerBG8:
+			format = (uses_raw_bayer() == true) ? "bggr" : (m_isNV12 == true) ? "NV12" : "I420";
+			break;
+		case Pylon::PixelType_BayerGR10:
+			format = "grbg10le";
+			break;
+		case Pylon::PixelType_BayerRG10:
+			format = "rggb10le";
+			break;
+		case Pylon::PixelType_BayerGB10:
+			format = "gbrg10le";
+			break;
+		case Pylon::PixelType_BayerBG10:
+			format = "bggr10le";
+			break;
+		case Pylon::PixelType_BayerGR12:
+			format = "grbg12le";
+			break;
+		case Pylon::PixelType_BayerRG12:
+			format = "rggb12le";
+			break;
+		case Pylon::PixelType_BayerGB12:
+			format = "gbrg12le";
+			break;
+		case Pylon::PixelType_BayerBG12:
+			format = "bggr12le";
+			break;
+		case Pylon::PixelType_RGB8packed:
+			format = "RGB";
+			break;
+		case Pylon::PixelType_BGR8packed:
+			format = "BGR";
+			break;
+		case Pylon::PixelType_RGBA8packed:
+			format = "RGBA";
+			break;
+		case Pylon::PixelType_BGRA8packed:
+			format = "BGRA";
+			break;
+		case Pylon::PixelType_RGB10packed:
+			// todo
+			break;
+		case Pylon::PixelType_BGR10packed:
+			// todo
+			break;
+		case Pylon::PixelType_RGB12packed:
+			// todo
+			break;
+		case Pylon::PixelType_BGR12packed:
+			// todo
+			break;
+		case Pylon::PixelType_RGB16packed:
+			// todo
+			break;
+		case Pylon::PixelType_BGR10V1packed:
+			// todo
+			break;
+		case Pylon::PixelType_BGR10V2packed:
+			// todo
+			break;
+		case Pylon::PixelType_YUV411packed:
+			// todo
+			break;
+		case Pylon::PixelType_YUV422packed:
+			format = "UYVY";
+			break;
+		case Pylon::PixelType_YUV444packed:
+			// todo
+			break;
+		case Pylon::PixelType_RGB8planar:
+			// todo
+			break;
+		case Pylon::PixelType_RGB10planar:
+			// todo
+			break;
+		case Pylon::PixelType_RGB12planar:
+			// todo
+			break;
+		case Pylon::PixelType_RGB16planar:
+			// todo
+			break;
+		case Pylon::PixelType_YUV422_YUYV_Packed:
+			format = "YUY2";
+			break;
+		case Pylon::PixelType_YUV444planar:
+			// todo
+			break;
+		case Pylon::PixelType_YUV422planar:
+			format = "Y42B";
+			break;
+		case Pylon::PixelType_YUV420planar:
+			format = "I420";
+			break;
+		case Pylon::PixelType_BayerGR12Packed:
+			// todo
+			break;
+		case Pylon::PixelType_BayerRG12Packed:
+			// todo
+			break;
+		case Pylon::PixelType_BayerGB12Packed:
+			// todo
+			break;
+		case Pylon::PixelType_BayerBG12Packed:
+			// todo
+			break;
+		case Pylon::PixelType_BayerGR10p:
+			// todo
+			break;
+		case Pylon::PixelType_BayerRG10p:
+			// todo
+			break;
+		case Pylon::PixelType_BayerGB10p:
+			// todo
+			break;
+		case Pylon::PixelType_BayerBG10p:
+			// todo
+			break;
+		case Pylon::PixelType_BayerGR12p:
+			// todo
+			break;
+		case Pylon::PixelType_BayerRG12p:
+			// todo
+			break;
+		case Pylon::PixelType_BayerGB12p:
+			// todo
+			break;
+		case Pylon::PixelType_BayerBG12p:
+			// todo
+			break;
+		case Pylon::PixelType_BayerGR16:
+			format = "grbg16le";
+			break;
+		case Pylon::PixelType_BayerRG16:
+			format = "rggb16le";
+			break;
+		case Pylon::PixelType_BayerGB16:
+			format = "gbrg16le";
+			break;
+		case Pylon::PixelType_BayerBG16:
+			format = "bggr16le";
+			break;
+		case Pylon::PixelType_RGB12V1packed:
+			// todo
+			break;
+		case Pylon::PixelType_Double:
+			// todo
+			break;
+		default:
+			// todo
+			break;
+	}
+
+	return format;
+}
+
+// The format of the images leaving the source bin: the common I420 format (if color), or NV12 if the Bayer kernels were asked for it. Mono and raw Bayer leave as they are.
+string CInstantCameraAppSrc::get_final_format()
+{
+	if (m_isColor == false || uses_raw_bayer() == true)
+		return get_appsrc_format();
+	return (uses_bayer_to_yuv() == true && m_isNV12 == true) ? "NV12" : "I420";
+}
+
+// Set AppSrc's caps from the current image size, format and frame rate.
+// While streaming, AppSrc queues the new caps behind the images already pushed, so the rest of the pipeline renegotiates right before the first image in the new format.
+void CInstantCameraAppSrc::set_appsrc_caps()
+{
+	// Bayer images pushed as they are have bayer caps (see SetRawBayer()). The high bit depths are 16-bit little endian, like GRAY16_LE.
+	string mediaType = "video/x-raw";
+	if (uses_raw_bayer() == true)
+		mediaType = "video/x-bayer";
+
+	GstCaps *caps = gst_caps_new_simple(mediaType.c_str(),
+		"format", G_TYPE_STRING, get_appsrc_format().c_str(),
+		"width", G_TYPE_INT, get_output_width(), // just in case the camera used a different value than our desired, due to increment constraints
+		"height", G_TYPE_INT, get_output_height(),
+		"framerate", GST_TYPE_FRACTION, m_frameRateNum, m_frameRateDen, NULL);
+	g_object_set(G_OBJECT(m_appsrc), "caps", caps, NULL);
+	gst_caps_unref(caps);
+}
+
+// Work out which elements the source bin needs after AppSrc. Images rescaled and rotated on the host (see SetFusedTransform()) already have their final size.
+void CInstantCameraAppSrc::get_source_bin_elements(bool &needsConverter, bool &needsRescaler, bool &needsRotator)
+{
+	needsConverter = false;
+	needsRescaler = false;
+	needsRotator = false;
+	if (uses_raw_bayer() == true)
+		return;
+
+	needsConverter = get_final_format() != get_appsrc_format();
+	if (uses_fused_transform() == true)
+		return;
+	needsRescaler = m_scaledWidth >= 2 && m_scaledHeight >= 2 && (m_scaledWidth != this->GetWidth() || m_scaledHeight != this->GetHeight());
+	needsRotator = get_flip_method() != 0;
+}
+
+// The videoflip method for the flips and rotation the camera doesn't do (see configure_reverse()), unless they are done on the host (see SetFusedTransform())
+int CInstantCameraAppSrc::get_flip_method()
+{
+	if (uses_fused_transform() == true)
+		return 0; // GST_VIDEO_FLIP_METHOD_IDENTITY (none)
+
+	// the images are flipped first, then rotated. A flip and a quarter turn make a diagonal flip, two flips make a half turn.
+	bool isFlippedX = m_isHostFlippedX;
+	bool isFlippedY = m_isHostFlippedY;
+	if (m_hostRotation == 90)
+	{
+		if (isFlippedX == true && isFlippedY == true)
+			return 3; // GST_VIDEO_FLIP_METHOD_90L
+		if (isFlippedX == true)
+			return 7; // GST_VIDEO_FLIP_METHOD_OTHER (upper-right-diagonal)
+		if (isFlippedY == true)
+			return 6; // GST_VIDEO_FLIP_METHOD_TRANS (upper-left-diagonal)
+		return 1; // GST_VIDEO_FLIP_METHOD_90R
+	}
+	if (m_hostRotation == 270)
+	{
+		if (isFlippedX == true && isFlippedY == true)
+			return 1; // GST_VIDEO_FLIP_METHOD_90R
+		if (isFlippedX == true)
+			return 6; // GST_VIDEO_FLIP_METHOD_TRANS (upper-left-diagonal)
+		if (isFlippedY == true)
+			return 7; // GST_VIDEO_FLIP_METHOD_OTHER (upper-right-diagonal)
+		return 3; // GST_VIDEO_FLIP_METHOD_90L
+	}
+	if (isFlippedX == true && isFlippedY == true)
+		return 2; // GST_VIDEO_FLIP_METHOD_180
+	if (isFlippedX == true)
+		return 4; // GST_VIDEO_FLIP_METHOD_HORIZ
+	if (isFlippedY == true)
+		return 5; // GST_VIDEO_FLIP_METHOD_VERT
+	return 0; // GST_VIDEO_FLIP_METHOD_IDENTITY (none)
+}
+
+// Bring the source bin's elements up to date after Reconfigure(): the rescaler's caps carry the frame rate,
+// and the rotator stands aside while the images are rotated on the host (see SetFusedTransform()), which depends on the AOI.
+void CInstantCameraAppSrc::update_source_bin()
+{
+	if (m_sourceBin == NULL)
+		return;
+
+	GstElement *rescalerCaps = gst_bin_get_by_name(GST_BIN(m_sourceBin), "rescalerCaps");
+	if (rescalerCaps != NULL)
+	{
+		set_caps_filter(rescalerCaps, get_final_format(), m_scaledWidth, m_scaledHeight);
+		gst_object_unref(rescalerCaps);
+	}
+
+	GstElement *rotator = gst_bin_get_by_name(GST_BIN(m_sourceBin), "rotator");
+	if (rotator != NULL)
+	{
+		g_object_set(G_OBJECT(rotator), "method", get_flip_method(), NULL);
+		gst_object_unref(rotator);
+	}
+}
+
+// Create an element, add it to the source bin and link it after lastElement. Returns the new element, or lastElement if it can't be created.
+GstElement* CInstantCameraAppSrc::add_to_source_bin(GstElement *lastElement, const char *factoryName, const char *elementName)
+{
+	GstElement *element = gst_element_factory_make(factoryName, elementName);
+	if (element == NULL)
+	{
+		cerr << "Could not create a " << factoryName << " element for the source bin." << endl;
+		return lastElement;
+	}
+
+	gst_bin_add(GST_BIN(m_sourceBin), element);
+	gst_element_link(lastElement, element);
+	return element;
+}
+
+// Set the caps of a capsfilter in the source bin. width and height -1 = any size (eg: after a converter, which keeps the size).
+void CInstantCameraAppSrc::set_caps_filter(GstElement *capsFilter, const string &format, int width, int height)
+{
+	GstCaps *caps = gst_caps_new_simple("video/x-raw",
+		"format", G_TYPE_STRING, format.c_str(),
+		NULL);
+	if (width != -1 && height != -1)
+	{
+		gst_caps_set_simple(caps,
+			"width", G_TYPE_INT, width,
+			"height", G_TYPE_INT, height,
+			"framerate", GST_TYPE_FRACTION, m_frameRateNum, m_frameRateDen, NULL);
+	}
+
+	g_object_set(G_OBJECT(capsFilter), "caps", caps, NULL);
+	gst_caps_unref(caps);
+}
+
 // the callback that's fired when the appsrc element sends the 'need-data' signal.
 void CInstantCameraAppSrc::cb_need_data(GstElement *appsrc, guint unused_size, gpointer user_data)
 {
@@ -999,6 +3239,10 @@ void CInstantCameraAppSrc::cb_need_data(GstElement *appsrc, guint unused_size, g
 		// remember, the "user data" the signal passes to the callback is really the address of the Instant Camera
 		CInstantCameraAppSrc *pCamera = (CInstantCameraAppSrc*)user_data;
 
+		// In push mode, images are pushed by the delivery thread as they arrive, so there is nothing to do here (the same with external retrieval).
+		if (pCamera->m_isPushMode == true || pCamera->m_isExternalRetrieval == true)
+			return;
+
 		// If we request data, and discover the camera is removed, send the EOS signal.
 		if (pCamera->IsCameraDeviceRemoved() == true)
 		{
@@ -1020,3 +3264,44 @@ void CInstantCameraAppSrc::cb_need_data(GstElement *appsrc, guint unused_size, g
 	}
 
 }
+
+// query handler of the sourceBin's src pad
+gboolean CInstantCameraAppSrc::cb_query(GstPad *pad, GstObject *parent, GstQuery *query)
+{
+	try
+	{
+		if (GST_QUERY_TYPE(query) != GST_QUERY_LATENCY)
+			return gst_proxy_pad_query_default(pad, parent, query);
+
+		CInstantCameraAppSrc *pCamera = (CInstantCameraAppSrc*)g_object_get_data(G_OBJECT(pad), "camera");
+
+		// Let the elements in the bin answer first, so their own latency is included.
+		gboolean isLive = TRUE;
+		GstClockTime minLatency = 0;
+		GstClockTime maxLatency = GST_CLOCK_TIME_NONE;
+		if (gst_proxy_pad_query_default(pad, parent, query) == TRUE)
+			gst_query_parse_latency(query, &isLive, &minLatency, &maxLatency);
+
+		// Images are never younger than the camera's capture latency, and may wait as long as our queues allow.
+		if (minLatency < pCamera->m_minLatency)
+			minLatency = pCamera->m_minLatency;
+		if (maxLatency != GST_CLOCK_TIME_NONE && pCamera->m_maxLatency != GST_CLOCK_TIME_NONE && maxLatency < pCamera->m_maxLatency)
+			maxLatency = pCamera->m_maxLatency;
+
+		// the camera is always a live source
+		gst_query_set_latency(query, TRUE, minLatency, maxLatency);
+		return TRUE;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in cb_query(): " << endl << e.what() << endl;
+		return FALSE;
+	}
+}
+
+// the destroy notify of gst buffers wrapping a grab result. Fired when the pipeline releases the buffer.
+void CInstantCameraAppSrc::cb_release_grab_result(gpointer data)
+{
+	// releasing the grab result returns its buffer to the Grab Engine
+	delete (Pylon::CGrabResultPtr*)data;
+}
@@ -23,6 +23,20 @@
 
 #include <pylon/PylonIncludes.h>
 #include <gst/gst.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "CFrameRing.h"
+#include "CTimestampMapper.h"
+#include "CGstBufferFactory.h"
+#include "CChunkMeta.h"
+#include "CFrameTraceMeta.h"
+#include "CStripedConverter.h"
+#include "CScaleRotate.h"
+#include "CWorkerPool.h"
 
 using namespace Pylon;
 using namespace GenApi;
@@ -33,7 +47,15 @@ using namespace std;
 class CInstantCameraAppSrc : public CInstantCamera
 {
 public:
+	// What the acquisition thread does with a new image when the ring to the pipeline is full (push mode only)
+	enum EDropPolicy
+	{
+		DropPolicy_Wait,       // wait for the pipeline to take an image. The Grab Engine keeps grabbing according to its grab strategy.
+		DropPolicy_DropNewest  // discard the new image
+	};
+
 	CInstantCameraAppSrc(string serialnumber = "");
+	CInstantCameraAppSrc(const Pylon::CDeviceInfo &deviceInfo);
 	~CInstantCameraAppSrc();
 
 	int GetWidth();
@@ -47,9 +69,14 @@ public:
 		int scaledWidth = -1,
 		int scaledHeight = -1,
 		int rotation = -1,
-		int numFramesToGrab = -1);
+		int numFramesToGrab = -1,
+		Pylon::EGrabStrategy grabStrategy = Pylon::GrabStrategy_LatestImageOnly,
+		int numGrabBuffers = -1);
 	bool StartCamera();
 	bool StopCamera();
+	bool Reconfigure(int width, int height, double framesPerSecond = -1, string pixelFormat = "");
+	bool SetRegion(int offsetX, int offsetY, int width = -1, int height = -1);
+	bool HandleBusMessage(GstMessage *message);
 	bool OpenCamera();
 	bool CloseCamera();
 	bool ResetCamera();
@@ -57,27 +84,187 @@ public:
 	bool AutoAdjustImage();
 	bool SaveSettingsToCamera(bool BootWithNewSettings = false);
 	double GetFrameRate();
+	bool SetZeroCopy(bool useZeroCopy);
+	bool SetBufferPoolDepth(int numBuffers);
+	bool SetConversionStripes(int numStripes, CWorkerPool *pWorkerPool = NULL);
+	bool SetBayerToYuv(bool useBayerToYuv, bool useNV12 = false);
+	bool SetRawBayer(bool useRawBayer);
+	bool SetMsbAligned(bool useMsbAlignment);
+	bool SetFusedTransform(bool useFusedTransform);
+	bool SetCameraBinning(bool useCameraBinning);
+	bool SetFlip(bool flipX, bool flipY);
+	bool SetGstBufferFactory(bool useGstBufferFactory, GstAllocator *allocator = NULL);
+	bool SetHardwareTimestamps(bool useHardwareTimestamps);
+	bool SetChunkData(bool useChunkData);
+	bool SetLowLatency(bool useLowLatency);
+	bool SetLatencyTracing(bool useLatencyTracing);
+	bool SetPushMode(bool usePushMode, int ringDepth = 4, EDropPolicy dropPolicy = DropPolicy_Wait, guint64 appsrcMaxBytes = 0, bool appsrcBlock = true);
+	bool SetExternalRetrieval(bool useExternalRetrieval);
+	bool PushImage(unsigned int timeoutMs = 0);
+	GstBuffer* GrabImage(unsigned int timeoutMs = 0, guint64 *pDeviceTime = NULL);
+	bool PushBuffer(GstBuffer *buffer);
+	bool SetTriggerSource(string triggerSource);
+	bool SetStatsInterval(int intervalMs, string metricsFile = "");
+	void PublishStats();
+	uint64_t GetNumFramesGrabbed();
+	uint64_t GetNumFramesPushed();
+	uint64_t GetNumFramesDropped();
+	uint64_t GetNumFramesSkipped();
+	uint64_t GetNumFramesLost();
+	uint64_t GetNumFramesFailed();
+	uint64_t GetNumFramesIncomplete();
+	uint64_t GetNumFramesDuplicated();
 	GstElement* GetSource();	
 	
 private:
 	int m_width;
 	int m_height;
-	int m_frameRate;
+	int m_offsetX; // -1 = centered (see SetRegion())
+	int m_offsetY;
+	double m_frameRate;
 	int m_scaledWidth;
 	int m_scaledHeight;
 	int m_rotation;
+	bool m_isFlippedX;
+	bool m_isFlippedY;
+	bool m_isCameraReversedX; // the flips the camera does (see configure_reverse())
+	bool m_isCameraReversedY;
+	bool m_isHostFlippedX;    // and those left to the host, before m_hostRotation
+	bool m_isHostFlippedY;
+	int m_hostRotation;
 	int m_numFramesToGrab;
+	Pylon::EGrabStrategy m_grabStrategy;
+	int m_numGrabBuffers;
 	bool m_isInitialized;
 	bool m_isColor;
 	bool m_isOnDemand;
 	bool m_isTriggered;
+	string m_triggerSource;
 	bool m_isOpen;
+	bool m_isZeroCopy;
+	bool m_isGstBufferFactory;
+	bool m_isHardwareTimestamped;
+	bool m_isChunkData;
+	bool m_isChunkModeActive; // we turned the camera's chunk mode on (see configure_chunks())
+	bool m_isLowLatency;
+	bool m_isLatencyTraced;
+	bool m_isPushMode;
+	bool m_isExternalRetrieval;
+	int m_ringDepth;
+	EDropPolicy m_dropPolicy;
+	guint64 m_appsrcMaxBytes;
+	bool m_appsrcBlock;
+	int m_bufferPoolDepth;
+	size_t m_frameSize;
 	string m_serialNumber;
-	Pylon::CPylonImage m_Image;
-	Pylon::CImageFormatConverter m_FormatConverter;
+	Pylon::EPixelType m_pixelType;
+	Pylon::EPixelType m_cameraPixelType;
+	bool m_isBayerToYuv;
+	bool m_isNV12;
+	bool m_isRawBayer;
+	bool m_isMsbAligned;
+	bool m_isFusedTransform;
+	bool m_isTransforming;
+	bool m_isCameraBinning;
+	bool m_isCameraBinned; // we set the camera's binning or decimation (see configure_binning())
+	CStripedConverter m_FormatConverter;
+	CScaleRotate m_lumaTransform;   // GRAY8/GRAY16 images, or the Y plane of I420
+	CScaleRotate m_chromaTransform; // the U and V planes of I420
+	std::vector<uint8_t> m_transformBuffer; // the converted (or unpacked) image at full size, before it is rescaled and rotated
+	int m_numConversionStripes;
+	CWorkerPool* m_pWorkerPool;
+	bool m_ownsWorkerPool;
 	GstElement* m_appsrc;
 	GstElement* m_sourceBin;
-	GstBuffer* m_gstBuffer;
+	bool m_binHasConverter; // the elements GetSource() put in the source bin after AppSrc
+	bool m_binHasRescaler;
+	bool m_binHasRotator;
+	bool m_binIsRawBayer;
+	string m_binFinalFormat;
+	std::mutex m_grabMutex;
+	GstBufferPool* m_bufferPool;
+	GstBuffer* m_lastBuffer;
+	CTimestampMapper m_timestampMapper;
+	double m_tickFrequency;
+	guint64 m_lastDeviceTime; // the camera timestamp of the last image we retrieved, in ns (see GrabImage())
+	GstClockTime m_lastPts;
+	int m_frameRateNum;
+	int m_frameRateDen;
+	GstClockTime m_captureLatency;
+	GstClockTime m_minLatency;
+	GstClockTime m_maxLatency;
+	CFrameRing<GstBuffer*> m_frameRing;
+	std::atomic<bool> m_isPushing;
+	std::thread m_acquisitionThread;
+	std::thread m_deliveryThread;
+	std::atomic<uint64_t> m_numFramesGrabbed;
+	std::atomic<uint64_t> m_numFramesPushed;
+	std::atomic<uint64_t> m_numFramesDropped;
+	std::atomic<uint64_t> m_numFramesSkipped;
+	std::atomic<uint64_t> m_numFramesLost;
+	std::atomic<uint64_t> m_numFramesFailed;
+	std::atomic<uint64_t> m_numFramesIncomplete;
+	std::atomic<uint64_t> m_numFramesDuplicated;
+	uint64_t m_lastBlockId;         // the numbers of the last image we retrieved (see count_lost_frames())
+	uint64_t m_lastFrameCounter;
+	uint64_t m_numFramesUncounted;  // images skipped or failed since m_lastFrameCounter
+	int m_statsIntervalMs;
+	string m_metricsFile;
+	std::thread m_statsThread;
+	std::mutex m_statsMutex;
+	std::condition_variable m_statsCondition;
+	bool m_isSampling;
+	void initialize(string serialnumber, const Pylon::CDeviceInfo *pDeviceInfo);
+	void update_pixel_types();
+	void configure_binning();
+	void reset_binning();
+	void configure_reverse();
+	bool set_image_format(int width, int height, string pixelFormat);
+	void set_aoi_offsets();
+	void configure_grab_buffers();
+	void configure_chunks();
+	void configure_conversion();
+	bool uses_bayer_to_yuv();
+	bool uses_raw_bayer();
+	Pylon::EPixelType get_output_pixel_type();
+	bool uses_fused_transform();
+	int get_output_width();
+	int get_output_height();
+	void transform_image(Pylon::CGrabResultPtr &ptrGrabResult, uint8_t *pDestination, size_t destinationSize);
+	void configure_latency();
+	guint64 get_appsrc_max_bytes();
 	bool retrieve_image();
+	GstBuffer* grab_image(unsigned int timeoutMs, Pylon::ETimeoutHandling timeoutHandling);
+	void count_lost_frames(Pylon::CGrabResultPtr &ptrGrabResult, GstBuffer *buffer, uint64_t numSkipped);
+	void start_stats_thread();
+	void stop_stats_thread();
+	void stats_loop();
+	void publish_stats();
+	std::vector<std::pair<string, int64_t>> sample_stream_stats();
+	void post_frame_stats();
+	void post_stream_stats(const std::vector<std::pair<string, int64_t>> &streamStats);
+	void write_metrics_file(const std::vector<std::pair<string, int64_t>> &streamStats);
+	void start_push_threads();
+	void stop_push_threads();
+	void acquisition_loop();
+	void delivery_loop();
+	bool create_buffer_pool();
+	void destroy_buffer_pool();
+	GstBuffer* acquire_pooled_buffer();
+	GstBuffer* fill_pooled_buffer(Pylon::CGrabResultPtr &ptrGrabResult);
+	bool is_zero_copy_compatible(Pylon::CGrabResultPtr &ptrGrabResult);
+	GstBuffer* wrap_grab_result(Pylon::CGrabResultPtr &ptrGrabResult);
+	GstClockTime get_clock_time();
+	void timestamp_buffer(GstBuffer *buffer, Pylon::CGrabResultPtr &ptrGrabResult);
+	string get_appsrc_format();
+	string get_final_format();
+	void set_appsrc_caps();
+	void get_source_bin_elements(bool &needsConverter, bool &needsRescaler, bool &needsRotator);
+	int get_flip_method();
+	void update_source_bin();
+	GstElement* add_to_source_bin(GstElement *lastElement, const char *factoryName, const char *elementName);
+	void set_caps_filter(GstElement *capsFilter, const string &format, int width, int height);
 	static void cb_need_data(GstElement *appsrc, guint unused_size, gpointer user_data);
+	static gboolean cb_query(GstPad *pad, GstObject *parent, GstQuery *query);
+	static void cb_release_grab_result(gpointer data);
 };
@@ -0,0 +1,176 @@
+/*  CLatencyTracer.cpp: Definition file for CLatencyTracer.
+    Latency histograms of each stage an image passes from the camera to the sink.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#include "CLatencyTracer.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+using namespace std;
+
+CLatencyHistogram::CLatencyHistogram()
+{
+	Reset();
+}
+
+// Values below 2 * SubBuckets have a bucket each.
+// Above, each power of two is split into SubBuckets buckets, keyed by the value's top SubBucketBits + 1 bits.
+int CLatencyHistogram::get_bucket(uint64_t value)
+{
+	if (value < 2 * SubBuckets)
+		return (int)value;
+
+	int msb = 0;
+	while ((value >> (msb + 1)) != 0)
+		msb++;
+	int shift = msb - SubBucketBits;
+	return 2 * SubBuckets + (shift - 1) * SubBuckets + (int)((value >> shift) - SubBuckets);
+}
+
+// The highest value that falls in a bucket
+uint64_t CLatencyHistogram::get_bucket_value(int bucket)
+{
+	if (bucket < 2 * SubBuckets)
+		return (uint64_t)bucket;
+
+	int shift = (bucket - 2 * SubBuckets) / SubBuckets + 1;
+	uint64_t subBucket = (uint64_t)((bucket - 2 * SubBuckets) % SubBuckets + SubBuckets);
+	return ((subBucket + 1) << shift) - 1;
+}
+
+void CLatencyHistogram::Record(GstClockTime latency)
+{
+	uint64_t value = latency / 1000;
+	if (value >= ((uint64_t)1 << MaxValueBits))
+		value = ((uint64_t)1 << MaxValueBits) - 1;
+
+	m_counts[get_bucket(value)].fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t max = m_max.load(std::memory_order_relaxed);
+	while (value > max && m_max.compare_exchange_weak(max, value, std::memory_order_relaxed) == false);
+}
+
+void CLatencyHistogram::Reset()
+{
+	for (int i = 0; i < NumBuckets; i++)
+		m_counts[i] = 0;
+	m_max = 0;
+}
+
+uint64_t CLatencyHistogram::GetCount()
+{
+	uint64_t count = 0;
+	for (int i = 0; i < NumBuckets; i++)
+		count += m_counts[i].load(std::memory_order_relaxed);
+	return count;
+}
+
+// The latency that percentile (0-100) of the recorded latencies were at or below, or GST_CLOCK_TIME_NONE if nothing was recorded.
+// Recording may go on meanwhile, so the result is as of roughly now.
+GstClockTime CLatencyHistogram::GetPercentile(double percentile)
+{
+	uint64_t count = GetCount();
+	if (count == 0)
+		return GST_CLOCK_TIME_NONE;
+
+	uint64_t rank = (uint64_t)(percentile / 100.0 * count + 0.5);
+	if (rank < 1)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for (int i = 0; i < NumBuckets; i++)
+	{
+		seen += m_counts[i].load(std::memory_order_relaxed);
+		if (seen >= rank)
+			return std::min<uint64_t>(get_bucket_value(i), m_max.load(std::memory_order_relaxed)) * 1000;
+	}
+	return m_max.load(std::memory_order_relaxed) * 1000;
+}
+
+GstClockTime CLatencyHistogram::GetMax()
+{
+	return m_max.load(std::memory_order_relaxed) * 1000;
+}
+
+// Record the latency of each stage the image passed, as it arrives at the sink at sinkTime (pipeline clock time)
+void CLatencyTracer::RecordFrame(const CFrameTraceMeta *pTrace, GstClockTime sinkTime)
+{
+	Record(Stage_Transfer, pTrace->exposureTime, pTrace->retrievedTime);
+	Record(Stage_Conversion, pTrace->retrievedTime, pTrace->convertedTime);
+	Record(Stage_Delivery, pTrace->convertedTime, pTrace->pushedTime);
+	Record(Stage_Pipeline, pTrace->pushedTime, sinkTime);
+	if (pTrace->exposureTime != GST_CLOCK_TIME_NONE)
+		Record(Stage_Total, pTrace->exposureTime, sinkTime);
+	else
+		Record(Stage_Total, pTrace->retrievedTime, sinkTime);
+}
+
+// Record the time between two stages, if the image passed both
+void CLatencyTracer::Record(EStage stage, GstClockTime startTime, GstClockTime endTime)
+{
+	if (startTime == GST_CLOCK_TIME_NONE || endTime == GST_CLOCK_TIME_NONE)
+		return;
+
+	// the exposure start is estimated from the camera's clock, so it may come out a little later than the next stage.
+	m_histograms[stage].Record(endTime > startTime ? endTime - startTime : 0);
+}
+
+void CLatencyTracer::Reset()
+{
+	for (int i = 0; i < NumStages; i++)
+		m_histograms[i].Reset();
+}
+
+// Print the percentiles of each stage's latency in ms
+void CLatencyTracer::Print()
+{
+	static const char* const stageNames[NumStages] =
+	{
+		"exposure -> retrieved",
+		"retrieved -> converted",
+		"converted -> pushed",
+		"pushed -> sink",
+		"total"
+	};
+
+	// leave cout's format as we found it for the rest of the application
+	std::ios::fmtflags flags = cout.flags();
+	std::streamsize precision = cout.precision();
+
+	cout << "Latency (ms)              images      p50      p99    p99.9      max" << endl;
+	for (int i = 0; i < NumStages; i++)
+	{
+		uint64_t count = m_histograms[i].GetCount();
+		if (count == 0)
+			continue;
+
+		cout << std::left << std::setw(24) << stageNames[i] << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(10) << count
+			<< std::setw(9) << m_histograms[i].GetPercentile(50) / 1e6
+			<< std::setw(9) << m_histograms[i].GetPercentile(99) / 1e6
+			<< std::setw(9) << m_histograms[i].GetPercentile(99.9) / 1e6
+			<< std::setw(9) << m_histograms[i].GetMax() / 1e6 << endl;
+	}
+
+	cout.flags(flags);
+	cout.precision(precision);
+}
@@ -0,0 +1,79 @@
+/*  CLatencyTracer.h: header file for CLatencyTracer.
+    Latency histograms of each stage an image passes from the camera to the sink.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#pragma once
+
+#include <gst/gst.h>
+#include <atomic>
+#include <stdint.h>
+#include "CFrameTraceMeta.h"
+
+// ******* CLatencyHistogram *******
+// A log-linear histogram of latencies in microseconds, in the style of HdrHistogram:
+// exact below 128 us, and within 1/64 (1.6%) of the value above, up to about 19 hours.
+// Recording is lock-free, so the streaming thread never waits for a reader.
+class CLatencyHistogram
+{
+public:
+	CLatencyHistogram();
+
+	void Record(GstClockTime latency);
+	void Reset();
+	uint64_t GetCount();
+	GstClockTime GetPercentile(double percentile);
+	GstClockTime GetMax();
+
+private:
+	static const int SubBucketBits = 6;
+	static const int SubBuckets = 1 << SubBucketBits;
+	static const int MaxValueBits = 36;
+	static const int NumBuckets = 2 * SubBuckets + (MaxValueBits - SubBucketBits - 1) * SubBuckets;
+	std::atomic<uint64_t> m_counts[NumBuckets];
+	std::atomic<uint64_t> m_max; // us
+	static int get_bucket(uint64_t value);
+	static uint64_t get_bucket_value(int bucket);
+};
+
+// ******* CLatencyTracer *******
+// Collects the latency of each stage from the CFrameTraceMeta of the images arriving at the sink, and prints their percentiles.
+// CPipelineHelper::trace_latency() feeds it from a pad probe on the sink, and prints it when the stream ends.
+class CLatencyTracer
+{
+public:
+	enum EStage
+	{
+		Stage_Transfer,    // exposure start -> RetrieveResult() (exposure, readout, transfer, Grab Engine queue)
+		Stage_Conversion,  // RetrieveResult() -> conversion done
+		Stage_Delivery,    // conversion done -> push-buffer (push mode ring, need-data)
+		Stage_Pipeline,    // push-buffer -> sink
+		Stage_Total,       // exposure start (or RetrieveResult() without hardware timestamps) -> sink
+		NumStages
+	};
+
+	void RecordFrame(const CFrameTraceMeta *pTrace, GstClockTime sinkTime);
+	void Record(EStage stage, GstClockTime startTime, GstClockTime endTime);
+	void Reset();
+	void Print();
+
+private:
+	CLatencyHistogram m_histograms[NumStages];
+};
@@ -0,0 +1,1041 @@
+/*  CPixelKernels.cpp: Definition file for CPixelKernels Class.
+    Hand-written (SIMD) pixel kernels for the conversions Pylon's image format converter does not offer.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#include "CPixelKernels.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PIXELKERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang compile each SIMD version for its own instruction set, so the rest of the program doesn't need -mavx2.
+// MSVC always allows the intrinsics.
+#if defined(__GNUC__)
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE41
+#define TARGET_AVX2
+#endif
+
+static CPixelKernels::EInstructionSet s_maxInstructionSet = CPixelKernels::InstructionSet_AVX2;
+
+// What the CPU (and OS) supports
+static CPixelKernels::EInstructionSet detect_instruction_set()
+{
+#if defined(PIXELKERNELS_X86)
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int numIds = info[0];
+	__cpuid(info, 1);
+	bool hasSSE41 = (info[2] & (1 << 19)) != 0;
+	bool hasOSXSave = (info[2] & (1 << 27)) != 0;
+	bool hasAVX2 = false;
+	if (numIds >= 7 && hasOSXSave == true && (_xgetbv(0) & 6) == 6)
+	{
+		__cpuidex(info, 7, 0);
+		hasAVX2 = (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	bool hasSSE41 = __builtin_cpu_supports("sse4.1") != 0;
+	bool hasAVX2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+	if (hasAVX2 == true)
+		return CPixelKernels::InstructionSet_AVX2;
+	if (hasSSE41 == true)
+		return CPixelKernels::InstructionSet_SSE41;
+#endif
+	return CPixelKernels::InstructionSet_Scalar;
+}
+
+// The instruction set the kernels use: the best the CPU supports, but no more than SetMaxInstructionSet() allows.
+CPixelKernels::EInstructionSet CPixelKernels::GetInstructionSet()
+{
+	static const EInstructionSet supported = detect_instruction_set();
+	return std::min(supported, s_maxInstructionSet);
+}
+
+// Limit the kernels to an instruction set, eg: to compare them in a benchmark.
+void CPixelKernels::SetMaxInstructionSet(EInstructionSet instructionSet)
+{
+	s_maxInstructionSet = instructionSet;
+}
+
+const char* CPixelKernels::GetInstructionSetName(EInstructionSet instructionSet)
+{
+	switch (instructionSet)
+	{
+	case InstructionSet_AVX2:
+		return "AVX2";
+	case InstructionSet_SSE41:
+		return "SSE4.1";
+	default:
+		return "Scalar";
+	}
+}
+
+bool CPixelKernels::IsBayer8(Pylon::EPixelType pixelType)
+{
+	switch (pixelType)
+	{
+	case Pylon::PixelType_BayerRG8:
+	case Pylon::PixelType_BayerGR8:
+	case Pylon::PixelType_BayerGB8:
+	case Pylon::PixelType_BayerBG8:
+		return true;
+	default:
+		return false;
+	}
+}
+
+CPixelKernels::SYuvLayout CPixelKernels::GetYuv420Layout(uint32_t width, uint32_t height, bool isNV12)
+{
+	SYuvLayout layout;
+	size_t evenHeight = (height + 1) & ~1u;
+
+	layout.stride[0] = (width + 3) & ~3u;
+	layout.offset[0] = 0;
+	if (isNV12 == true)
+	{
+		layout.stride[1] = layout.stride[0];
+		layout.stride[2] = layout.stride[0];
+		layout.offset[1] = layout.stride[0] * evenHeight;
+		layout.offset[2] = layout.offset[1] + 1;
+		layout.size = layout.offset[1] + layout.stride[1] * (evenHeight / 2);
+	}
+	else
+	{
+		layout.stride[1] = ((((width + 1) & ~1u) / 2) + 3) & ~3u;
+		layout.stride[2] = layout.stride[1];
+		layout.offset[1] = layout.stride[0] * evenHeight;
+		layout.offset[2] = layout.offset[1] + layout.stride[1] * (evenHeight / 2);
+		layout.size = layout.offset[2] + layout.stride[2] * (evenHeight / 2);
+	}
+	return layout;
+}
+
+// planar 4:2:2 (eg: Pylon's YUV422planar). GStreamer pads the Y rows to 4 bytes and the chroma rows to half of 8 bytes.
+CPixelKernels::SYuvLayout CPixelKernels::GetY42BLayout(uint32_t width, uint32_t height)
+{
+	SYuvLayout layout;
+
+	layout.stride[0] = (width + 3) & ~3u;
+	layout.stride[1] = ((width + 7) & ~7u) / 2;
+	layout.stride[2] = layout.stride[1];
+	layout.offset[0] = 0;
+	layout.offset[1] = layout.stride[0] * height;
+	layout.offset[2] = layout.offset[1] + layout.stride[1] * height;
+	layout.size = layout.offset[2] + layout.stride[2] * height;
+	return layout;
+}
+
+Pylon::EPixelType CPixelKernels::GetUnpackedPixelType(Pylon::EPixelType packedPixelType)
+{
+	switch (packedPixelType)
+	{
+	case Pylon::PixelType_Mono10packed:
+	case Pylon::PixelType_Mono10p:
+		return Pylon::PixelType_Mono10;
+	case Pylon::PixelType_Mono12packed:
+	case Pylon::PixelType_Mono12p:
+		return Pylon::PixelType_Mono12;
+	case Pylon::PixelType_BayerGR10p:
+		return Pylon::PixelType_BayerGR10;
+	case Pylon::PixelType_BayerRG10p:
+		return Pylon::PixelType_BayerRG10;
+	case Pylon::PixelType_BayerGB10p:
+		return Pylon::PixelType_BayerGB10;
+	case Pylon::PixelType_BayerBG10p:
+		return Pylon::PixelType_BayerBG10;
+	case Pylon::PixelType_BayerGR12Packed:
+	case Pylon::PixelType_BayerGR12p:
+		return Pylon::PixelType_BayerGR12;
+	case Pylon::PixelType_BayerRG12Packed:
+	case Pylon::PixelType_BayerRG12p:
+		return Pylon::PixelType_BayerRG12;
+	case Pylon::PixelType_BayerGB12Packed:
+	case Pylon::PixelType_BayerGB12p:
+		return Pylon::PixelType_BayerGB12;
+	case Pylon::PixelType_BayerBG12Packed:
+	case Pylon::PixelType_BayerBG12p:
+		return Pylon::PixelType_BayerBG12;
+	default:
+		return Pylon::PixelType_Undefined; // not a packed format we can unpack
+	}
+}
+
+// ******* Bayer to YUV 4:2:0 *******
+// Every Bayer row holds green and one other color (red or blue), which sits on every other column.
+// For a pixel of the row's color, green is the average of the 4 direct neighbours and the row's missing color the average of the 4 diagonals.
+// For a green pixel, the row's color is the average of left and right, the missing color the average of above and below.
+// Luma is computed for every pixel, chroma from the average color of each 2x2 block (BT.601, studio range).
+// Outside the image, rows and columns are mirrored (-1 -> 1, width -> width - 2), which keeps the Bayer pattern intact.
+
+struct SBayerJob
+{
+	const uint8_t *pSource;
+	size_t sourceStride;
+	uint32_t width;
+	uint32_t height;
+	bool isRow0Red;         // row 0 holds red (and green), row 1 holds blue. Otherwise the other way around.
+	uint32_t row0ColorColumn; // column parity of the red/blue pixels in row 0. Row 1 has them on the other parity.
+	uint8_t *pY;
+	size_t yStride;
+	uint8_t *pU;
+	uint8_t *pV;
+	size_t chromaStride;
+	int chromaStep; // 1 for I420 (planar), 2 for NV12 (interleaved)
+};
+
+static inline const uint8_t* source_row(const SBayerJob &job, int y)
+{
+	if (y < 0)
+		y = 1;
+	else if (y >= (int)job.height)
+		y = (int)job.height - 2;
+	return job.pSource + (size_t)y * job.sourceStride;
+}
+
+static inline uint8_t luma(int r, int g, int b)
+{
+	return (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static inline uint8_t chroma_u(int r, int g, int b)
+{
+	return (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+static inline uint8_t chroma_v(int r, int g, int b)
+{
+	return (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+// demosaic one pixel of row c (with rows a above and b below). rowColor = this row's red or blue, otherColor = the other one.
+static inline void demosaic_pixel(const uint8_t *a, const uint8_t *c, const uint8_t *b, int x, int width, bool isColorPixel, int &rowColor, int &green, int &otherColor)
+{
+	int l = (x > 0) ? x - 1 : x + 1;
+	int r = (x < width - 1) ? x + 1 : x - 1;
+
+	if (isColorPixel == true)
+	{
+		rowColor = c[x];
+		green = (a[x] + b[x] + c[l] + c[r] + 2) >> 2;
+		otherColor = (a[l] + a[r] + b[l] + b[r] + 2) >> 2;
+	}
+	else
+	{
+		green = c[x];
+		rowColor = (c[l] + c[r] + 1) >> 1;
+		otherColor = (a[x] + b[x] + 1) >> 1;
+	}
+}
+
+// convert the 2x2 blocks of row pair (y, y + 1) from column xBegin to xEnd (both even)
+static void bayer_to_yuv420_scalar(const SBayerJob &job, uint32_t y, uint32_t xBegin, uint32_t xEnd)
+{
+	const uint8_t *rows[4] = { source_row(job, y - 1), source_row(job, y), source_row(job, y + 1), source_row(job, y + 2) };
+	uint8_t *pY[2] = { job.pY + y * job.yStride, job.pY + (y + 1) * job.yStride };
+	uint8_t *pU = job.pU + (y / 2) * job.chromaStride;
+	uint8_t *pV = job.pV + (y / 2) * job.chromaStride;
+
+	for (uint32_t x = xBegin; x < xEnd; x += 2)
+	{
+		int sumR = 0, sumG = 0, sumB = 0;
+		for (int row = 0; row < 2; row++)
+		{
+			// y is even, so row 0 of the pair has the layout of row 0 of the image
+			bool isRed = (row == 0) ? job.isRow0Red : !job.isRow0Red;
+			uint32_t colorColumn = (row == 0) ? job.row0ColorColumn : 1 - job.row0ColorColumn;
+
+			for (uint32_t dx = 0; dx < 2; dx++)
+			{
+				int rowColor, green, otherColor;
+				demosaic_pixel(rows[row], rows[row + 1], rows[row + 2], x + dx, job.width, ((x + dx) & 1) == colorColumn, rowColor, green, otherColor);
+				int r = isRed ? rowColor : otherColor;
+				int b = isRed ? otherColor : rowColor;
+				pY[row][x + dx] = luma(r, green, b);
+				sumR += r;
+				sumG += green;
+				sumB += b;
+			}
+		}
+
+		int r = (sumR + 2) >> 2, g = (sumG + 2) >> 2, b = (sumB + 2) >> 2;
+		pU[(x / 2) * job.chromaStep] = chroma_u(r, g, b);
+		pV[(x / 2) * job.chromaStep] = chroma_v(r, g, b);
+	}
+}
+
+#if defined(PIXELKERNELS_X86)
+
+// Chroma of 8 blocks (SSE4.1 and AVX2 share this): r, g, b are 8 block averages (16-bit). Stores 8 U and 8 V (or 8 UV pairs).
+TARGET_SSE41 static inline void store_chroma8(__m128i r, __m128i g, __m128i b, uint8_t *pU, uint8_t *pV, int chromaStep, int numBlocks)
+{
+	const __m128i round = _mm_set1_epi16(128);
+	__m128i u = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(-38)), _mm_mullo_epi16(g, _mm_set1_epi16(-74))), _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(112)), round));
+	__m128i v = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(112)), _mm_mullo_epi16(g, _mm_set1_epi16(-94))), _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(-18)), round));
+	u = _mm_add_epi16(_mm_srai_epi16(u, 8), round);
+	v = _mm_add_epi16(_mm_srai_epi16(v, 8), round);
+	__m128i u8 = _mm_packus_epi16(u, u);
+	__m128i v8 = _mm_packus_epi16(v, v);
+
+	uint8_t bytes[16];
+	if (chromaStep == 2)
+	{
+		_mm_storeu_si128((__m128i*)bytes, _mm_unpacklo_epi8(u8, v8));
+		memcpy(pU, bytes, numBlocks * 2);
+	}
+	else
+	{
+		_mm_storel_epi64((__m128i*)bytes, u8);
+		memcpy(pU, bytes, numBlocks);
+		_mm_storel_epi64((__m128i*)bytes, v8);
+		memcpy(pV, bytes, numBlocks);
+	}
+}
+
+// 16-bit luma of 8 pixels
+TARGET_SSE41 static inline __m128i luma8(__m128i r, __m128i g, __m128i b)
+{
+	__m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129))), _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)), _mm_set1_epi16(128)));
+	return _mm_add_epi16(_mm_srli_epi16(sum, 8), _mm_set1_epi16(16));
+}
+
+TARGET_SSE41 static inline __m128i load8_sse41(const uint8_t *p)
+{
+	return _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)p));
+}
+
+// demosaic 8 pixels of row c starting at x. colorMask has all bits set on the lanes of the row's red/blue pixels.
+TARGET_SSE41 static inline void demosaic8_sse41(const uint8_t *a, const uint8_t *c, const uint8_t *b, uint32_t x, __m128i colorMask, __m128i &rowColor, __m128i &green, __m128i &otherColor)
+{
+	__m128i up = load8_sse41(a + x), upLeft = load8_sse41(a + x - 1), upRight = load8_sse41(a + x + 1);
+	__m128i center = load8_sse41(c + x), left = load8_sse41(c + x - 1), right = load8_sse41(c + x + 1);
+	__m128i down = load8_sse41(b + x), downLeft = load8_sse41(b + x - 1), downRight = load8_sse41(b + x + 1);
+
+	const __m128i two = _mm_set1_epi16(2);
+	__m128i cross = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_add_epi16(up, down), _mm_add_epi16(left, right)), two), 2);
+	__m128i diagonal = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_add_epi16(upLeft, upRight), _mm_add_epi16(downLeft, downRight)), two), 2);
+	__m128i horizontal = _mm_avg_epu16(left, right);
+	__m128i vertical = _mm_avg_epu16(up, down);
+
+	rowColor = _mm_blendv_epi8(horizontal, center, colorMask);
+	green = _mm_blendv_epi8(center, cross, colorMask);
+	otherColor = _mm_blendv_epi8(vertical, diagonal, colorMask);
+}
+
+// the average of each horizontal pair of two rows (8 lanes -> 4 lanes, in the low half)
+TARGET_SSE41 static inline __m128i block_average4_sse41(__m128i row0, __m128i row1)
+{
+	__m128i sums = _mm_madd_epi16(_mm_add_epi16(row0, row1), _mm_set1_epi16(1));
+	sums = _mm_srli_epi32(_mm_add_epi32(sums, _mm_set1_epi32(2)), 2);
+	return _mm_packs_epi32(sums, sums);
+}
+
+TARGET_SSE41 static void bayer_to_yuv420_sse41(const SBayerJob &job, uint32_t y, uint32_t xBegin, uint32_t xEnd)
+{
+	const uint8_t *rows[4] = { source_row(job, y - 1), source_row(job, y), source_row(job, y + 1), source_row(job, y + 2) };
+	uint8_t *pY[2] = { job.pY + y * job.yStride, job.pY + (y + 1) * job.yStride };
+	uint8_t *pU = job.pU + (y / 2) * job.chromaStride;
+	uint8_t *pV = job.pV + (y / 2) * job.chromaStride;
+
+	// x is always even, so the color pixels are on the even lanes if the color column is even
+	const __m128i evenLanes = _mm_set_epi16(0, -1, 0, -1, 0, -1, 0, -1);
+	const __m128i oddLanes = _mm_set_epi16(-1, 0, -1, 0, -1, 0, -1, 0);
+	__m128i colorMask[2] = { job.row0ColorColumn == 0 ? evenLanes : oddLanes, job.row0ColorColumn == 0 ? oddLanes : evenLanes };
+
+	for (uint32_t x = xBegin; x < xEnd; x += 8)
+	{
+		__m128i r[2], g[2], b[2];
+		for (int row = 0; row < 2; row++)
+		{
+			bool isRed = (row == 0) ? job.isRow0Red : !job.isRow0Red;
+			__m128i rowColor, otherColor;
+			demosaic8_sse41(rows[row], rows[row + 1], rows[row + 2], x, colorMask[row], rowColor, g[row], otherColor);
+			r[row] = isRed ? rowColor : otherColor;
+			b[row] = isRed ? otherColor : rowColor;
+		}
+
+		__m128i y8 = _mm_packus_epi16(luma8(r[0], g[0], b[0]), luma8(r[1], g[1], b[1]));
+		_mm_storel_epi64((__m128i*)(pY[0] + x), y8);
+		_mm_storel_epi64((__m128i*)(pY[1] + x), _mm_srli_si128(y8, 8));
+
+		store_chroma8(block_average4_sse41(r[0], r[1]), block_average4_sse41(g[0], g[1]), block_average4_sse41(b[0], b[1]),
+			pU + (x / 2) * job.chromaStep, pV + (x / 2) * job.chromaStep, job.chromaStep, 4);
+	}
+}
+
+TARGET_AVX2 static inline __m256i load16_avx2(const uint8_t *p)
+{
+	return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)p));
+}
+
+TARGET_AVX2 static inline void demosaic16_avx2(const uint8_t *a, const uint8_t *c, const uint8_t *b, uint32_t x, __m256i colorMask, __m256i &rowColor, __m256i &green, __m256i &otherColor)
+{
+	__m256i up = load16_avx2(a + x), upLeft = load16_avx2(a + x - 1), upRight = load16_avx2(a + x + 1);
+	__m256i center = load16_avx2(c + x), left = load16_avx2(c + x - 1), right = load16_avx2(c + x + 1);
+	__m256i down = load16_avx2(b + x), downLeft = load16_avx2(b + x - 1), downRight = load16_avx2(b + x + 1);
+
+	const __m256i two = _mm256_set1_epi16(2);
+	__m256i cross = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(_mm256_add_epi16(up, down), _mm256_add_epi16(left, right)), two), 2);
+	__m256i diagonal = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(_mm256_add_epi16(upLeft, upRight), _mm256_add_epi16(downLeft, downRight)), two), 2);
+	__m256i horizontal = _mm256_avg_epu16(left, right);
+	__m256i vertical = _mm256_avg_epu16(up, down);
+
+	rowColor = _mm256_blendv_epi8(horizontal, center, colorMask);
+	green = _mm256_blendv_epi8(center, cross, colorMask);
+	otherColor = _mm256_blendv_epi8(vertical, diagonal, colorMask);
+}
+
+TARGET_AVX2 static inline __m256i luma16_avx2(__m256i r, __m256i g, __m256i b)
+{
+	__m256i sum = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(66)), _mm256_mullo_epi16(g, _mm256_set1_epi16(129))), _mm256_add_epi16(_mm256_mullo_epi16(b, _mm256_set1_epi16(25)), _mm256_set1_epi16(128)));
+	return _mm256_add_epi16(_mm256_srli_epi16(sum, 8), _mm256_set1_epi16(16));
+}
+
+// 16 lanes of 16-bit -> 16 bytes, in order
+TARGET_AVX2 static inline __m128i pack16_avx2(__m256i v)
+{
+	return _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+// the average of each horizontal pair of two rows (16 lanes -> 8 lanes, in order)
+TARGET_AVX2 static inline __m128i block_average8_avx2(__m256i row0, __m256i row1)
+{
+	__m256i sums = _mm256_madd_epi16(_mm256_add_epi16(row0, row1), _mm256_set1_epi16(1));
+	sums = _mm256_srli_epi32(_mm256_add_epi32(sums, _mm256_set1_epi32(2)), 2);
+	return _mm_packs_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+}
+
+TARGET_AVX2 static void bayer_to_yuv420_avx2(const SBayerJob &job, uint32_t y, uint32_t xBegin, uint32_t xEnd)
+{
+	const uint8_t *rows[4] = { source_row(job, y - 1), source_row(job, y), source_row(job, y + 1), source_row(job, y + 2) };
+	uint8_t *pY[2] = { job.pY + y * job.yStride, job.pY + (y + 1) * job.yStride };
+	uint8_t *pU = job.pU + (y / 2) * job.chromaStride;
+	uint8_t *pV = job.pV + (y / 2) * job.chromaStride;
+
+	const __m256i evenLanes = _mm256_set_epi16(0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1);
+	const __m256i oddLanes = _mm256_set_epi16(-1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0);
+	__m256i colorMask[2] = { job.row0ColorColumn == 0 ? evenLanes : oddLanes, job.row0ColorColumn == 0 ? oddLanes : evenLanes };
+
+	for (uint32_t x = xBegin; x < xEnd; x += 16)
+	{
+		__m256i r[2], g[2], b[2];
+		for (int row = 0; row < 2; row++)
+		{
+			bool isRed = (row == 0) ? job.isRow0Red : !job.isRow0Red;
+			__m256i rowColor, otherColor;
+			demosaic16_avx2(rows[row], rows[row + 1], rows[row + 2], x, colorMask[row], rowColor, g[row], otherColor);
+			r[row] = isRed ? rowColor : otherColor;
+			b[row] = isRed ? otherColor : rowColor;
+		}
+
+		_mm_storeu_si128((__m128i*)(pY[0] + x), pack16_avx2(luma16_avx2(r[0], g[0], b[0])));
+		_mm_storeu_si128((__m128i*)(pY[1] + x), pack16_avx2(luma16_avx2(r[1], g[1], b[1])));
+
+		store_chroma8(block_average8_avx2(r[0], r[1]), block_average8_avx2(g[0], g[1]), block_average8_avx2(b[0], b[1]),
+			pU + (x / 2) * job.chromaStep, pV + (x / 2) * job.chromaStep, job.chromaStep, 8);
+	}
+}
+
+#endif // PIXELKERNELS_X86
+
+bool CPixelKernels::BayerToYuv420(const uint8_t *pSource, size_t sourceStride, Pylon::EPixelType pixelType, uint32_t width, uint32_t height,
+	uint8_t *pDestination, bool isNV12, uint32_t firstRow, uint32_t lastRow)
+{
+	if (IsBayer8(pixelType) == false || width < 2 || height < 2 || (width % 2) != 0 || (height % 2) != 0 || (firstRow % 2) != 0)
+		return false;
+	lastRow = std::min(lastRow, height);
+
+	SBayerJob job;
+	job.pSource = pSource;
+	job.sourceStride = sourceStride;
+	job.width = width;
+	job.height = height;
+	job.isRow0Red = (pixelType == Pylon::PixelType_BayerRG8 || pixelType == Pylon::PixelType_BayerGR8);
+	job.row0ColorColumn = (pixelType == Pylon::PixelType_BayerRG8 || pixelType == Pylon::PixelType_BayerBG8) ? 0 : 1;
+
+	SYuvLayout layout = GetYuv420Layout(width, height, isNV12);
+	job.pY = pDestination + layout.offset[0];
+	job.yStride = layout.stride[0];
+	job.pU = pDestination + layout.offset[1];
+	job.pV = pDestination + layout.offset[2];
+	job.chromaStride = layout.stride[1];
+	job.chromaStep = isNV12 ? 2 : 1;
+
+	// The SIMD versions read one pixel left and right of each vector, so they cover the columns from 2 up to where the right neighbour is still in the image.
+	// The plain version does the first and last columns, with mirroring.
+	EInstructionSet instructionSet = GetInstructionSet();
+	uint32_t vectorWidth = (instructionSet == InstructionSet_AVX2) ? 16 : (instructionSet == InstructionSet_SSE41) ? 8 : 0;
+	uint32_t vectorBegin = std::min<uint32_t>(2, width);
+	uint32_t vectorEnd = vectorBegin;
+	if (vectorWidth > 0 && width > vectorWidth + 2)
+		vectorEnd = vectorBegin + ((width - 1 - vectorBegin) / vectorWidth) * vectorWidth;
+
+	for (uint32_t y = firstRow; y + 1 < lastRow; y += 2)
+	{
+		bayer_to_yuv420_scalar(job, y, 0, vectorBegin);
+#if defined(PIXELKERNELS_X86)
+		if (instructionSet == InstructionSet_AVX2)
+			bayer_to_yuv420_avx2(job, y, vectorBegin, vectorEnd);
+		else if (instructionSet == InstructionSet_SSE41)
+			bayer_to_yuv420_sse41(job, y, vectorBegin, vectorEnd);
+#endif
+		bayer_to_yuv420_scalar(job, y, vectorEnd, width);
+	}
+
+	return true;
+}
+
+// ******* Unpacking 10 and 12-bit to 16-bit *******
+// The "p" formats (PFNC, eg: Mono12p) are one little-endian bit stream: 4 pixels in 5 bytes (10-bit) or 2 pixels in 3 bytes (12-bit).
+// The older "packed" formats (GigE Vision, eg: Mono12packed) put the upper 8 bits of 2 pixels in bytes 0 and 2 and both pixels' low bits in byte 1.
+// The SIMD versions shuffle each pixel's 2 source bytes into a 16-bit lane, then shift and mask them into place.
+
+enum EPacking
+{
+	Packing_10p,
+	Packing_12p,
+	Packing_10Packed,
+	Packing_12Packed
+};
+
+static inline uint32_t byte_at(const uint8_t *pSource, size_t sourceSize, size_t index)
+{
+	return (index < sourceSize) ? pSource[index] : 0;
+}
+
+// first must be a multiple of 4 pixels
+static void unpack_scalar(EPacking packing, const uint8_t *pSource, size_t sourceSize, size_t first, size_t last, uint16_t *pDestination)
+{
+	// whole groups (4 pixels in 5 bytes or 2 pixels in 3 bytes) that are inside the source
+	size_t groupPixels = (packing == Packing_10p) ? 4 : 2;
+	size_t groupBytes = (packing == Packing_10p) ? 5 : 3;
+	size_t i = first;
+	for (; i + groupPixels <= last && (i / groupPixels + 1) * groupBytes <= sourceSize; i += groupPixels)
+	{
+		const uint8_t *b = pSource + (i / groupPixels) * groupBytes;
+		uint16_t *d = pDestination + i;
+		switch (packing)
+		{
+		case Packing_10p:
+			d[0] = (uint16_t)(b[0] | ((b[1] & 0x03) << 8));
+			d[1] = (uint16_t)((b[1] >> 2) | ((b[2] & 0x0F) << 6));
+			d[2] = (uint16_t)((b[2] >> 4) | ((b[3] & 0x3F) << 4));
+			d[3] = (uint16_t)((b[3] >> 6) | (b[4] << 2));
+			break;
+		case Packing_12p:
+			d[0] = (uint16_t)(b[0] | ((b[1] & 0x0F) << 8));
+			d[1] = (uint16_t)((b[1] >> 4) | (b[2] << 4));
+			break;
+		case Packing_10Packed:
+			d[0] = (uint16_t)((b[0] << 2) | (b[1] & 0x03));
+			d[1] = (uint16_t)((b[2] << 2) | ((b[1] >> 4) & 0x03));
+			break;
+		case Packing_12Packed:
+			d[0] = (uint16_t)((b[0] << 4) | (b[1] & 0x0F));
+			d[1] = (uint16_t)((b[2] << 4) | (b[1] >> 4));
+			break;
+		}
+	}
+
+	// a partial group at the end, reading only what is there
+	for (; i < last; i++)
+	{
+		switch (packing)
+		{
+		case Packing_10p:
+		case Packing_12p:
+			{
+				size_t bits = (packing == Packing_10p) ? 10 : 12;
+				size_t bit = i * bits;
+				uint32_t value = byte_at(pSource, sourceSize, bit / 8) | (byte_at(pSource, sourceSize, bit / 8 + 1) << 8);
+				pDestination[i] = (uint16_t)((value >> (bit % 8)) & ((1u << bits) - 1));
+			}
+			break;
+		case Packing_10Packed:
+		case Packing_12Packed:
+			{
+				size_t pair = (i / 2) * 3;
+				uint32_t high = byte_at(pSource, sourceSize, pair + ((i % 2) * 2));
+				uint32_t low = byte_at(pSource, sourceSize, pair + 1) >> ((i % 2) * 4);
+				if (packing == Packing_12Packed)
+					pDestination[i] = (uint16_t)((high << 4) | (low & 0x0F));
+				else
+					pDestination[i] = (uint16_t)((high << 2) | (low & 0x03));
+			}
+			break;
+		}
+	}
+}
+
+#if defined(PIXELKERNELS_X86)
+
+// which source bytes go into each 16-bit lane (8 pixels)
+TARGET_SSE41 static inline __m128i unpack_shuffle(EPacking packing)
+{
+	switch (packing)
+	{
+	case Packing_10p:
+		return _mm_setr_epi8(0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9);
+	case Packing_12p:
+		return _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+	default:
+		// the "packed" formats: the high byte is the pixel's own byte, the low byte is the shared byte of low bits
+		return _mm_setr_epi8(1, 0, 1, 2, 4, 3, 4, 5, 7, 6, 7, 8, 10, 9, 10, 11);
+	}
+}
+
+template <EPacking packing>
+TARGET_SSE41 static inline __m128i unpack8_sse41(__m128i lanes, bool alignMsb)
+{
+	__m128i pixels;
+	if (packing == Packing_10p)
+	{
+		// lane j holds the pixel at bit 2 * (j % 4). Shift it up to the top of the lane, then down.
+		pixels = _mm_mullo_epi16(lanes, _mm_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1));
+		return alignMsb ? _mm_and_si128(pixels, _mm_set1_epi16((short)0xFFC0)) : _mm_srli_epi16(pixels, 6);
+	}
+	if (packing == Packing_12p)
+	{
+		pixels = _mm_mullo_epi16(lanes, _mm_setr_epi16(16, 1, 16, 1, 16, 1, 16, 1));
+		return alignMsb ? _mm_and_si128(pixels, _mm_set1_epi16((short)0xFFF0)) : _mm_srli_epi16(pixels, 4);
+	}
+	if (packing == Packing_12Packed)
+	{
+		__m128i even = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(lanes, 4), _mm_set1_epi16(0x0FF0)), _mm_and_si128(lanes, _mm_set1_epi16(0x000F)));
+		pixels = _mm_blend_epi16(even, _mm_srli_epi16(lanes, 4), 0xAA);
+		return alignMsb ? _mm_slli_epi16(pixels, 4) : pixels;
+	}
+	// Packing_10Packed
+	__m128i low = _mm_blend_epi16(lanes, _mm_srli_epi16(lanes, 4), 0xAA);
+	pixels = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(lanes, 6), _mm_set1_epi16(0x03FC)), _mm_and_si128(low, _mm_set1_epi16(0x0003)));
+	return alignMsb ? _mm_slli_epi16(pixels, 6) : pixels;
+}
+
+// Unpack from pixel i (a multiple of 8) while a full 16-byte load stays inside the source. Returns where it stopped.
+template <EPacking packing>
+TARGET_SSE41 static size_t unpack_sse41(const uint8_t *pSource, size_t sourceSize, size_t i, size_t numPixels, uint16_t *pDestination, bool alignMsb)
+{
+	const size_t bytesPer8 = (packing == Packing_10p) ? 10 : 12;
+	const __m128i shuffle = unpack_shuffle(packing);
+
+	for (; i + 8 <= numPixels && (i / 8) * bytesPer8 + 16 <= sourceSize; i += 8)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(pSource + (i / 8) * bytesPer8));
+		_mm_storeu_si128((__m128i*)(pDestination + i), unpack8_sse41<packing>(_mm_shuffle_epi8(bytes, shuffle), alignMsb));
+	}
+	return i;
+}
+
+template <EPacking packing>
+TARGET_AVX2 static inline __m256i unpack16_avx2(__m256i lanes, bool alignMsb)
+{
+	__m256i pixels;
+	if (packing == Packing_10p)
+	{
+		pixels = _mm256_mullo_epi16(lanes, _mm256_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1, 64, 16, 4, 1, 64, 16, 4, 1));
+		return alignMsb ? _mm256_and_si256(pixels, _mm256_set1_epi16((short)0xFFC0)) : _mm256_srli_epi16(pixels, 6);
+	}
+	if (packing == Packing_12p)
+	{
+		pixels = _mm256_mullo_epi16(lanes, _mm256_setr_epi16(16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1));
+		return alignMsb ? _mm256_and_si256(pixels, _mm256_set1_epi16((short)0xFFF0)) : _mm256_srli_epi16(pixels, 4);
+	}
+	if (packing == Packing_12Packed)
+	{
+		__m256i even = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(lanes, 4), _mm256_set1_epi16(0x0FF0)), _mm256_and_si256(lanes, _mm256_set1_epi16(0x000F)));
+		pixels = _mm256_blend_epi16(even, _mm256_srli_epi16(lanes, 4), 0xAA);
+		return alignMsb ? _mm256_slli_epi16(pixels, 4) : pixels;
+	}
+	__m256i low = _mm256_blend_epi16(lanes, _mm256_srli_epi16(lanes, 4), 0xAA);
+	pixels = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(lanes, 6), _mm256_set1_epi16(0x03FC)), _mm256_and_si256(low, _mm256_set1_epi16(0x0003)));
+	return alignMsb ? _mm256_slli_epi16(pixels, 6) : pixels;
+}
+
+// 16 pixels per step: each 128-bit half shuffles its own 8 pixels, loaded from where they start
+template <EPacking packing>
+TARGET_AVX2 static size_t unpack_avx2(const uint8_t *pSource, size_t sourceSize, size_t i, size_t numPixels, uint16_t *pDestination, bool alignMsb)
+{
+	const size_t bytesPer8 = (packing == Packing_10p) ? 10 : 12;
+	const __m256i shuffle = _mm256_broadcastsi128_si256(unpack_shuffle(packing));
+
+	for (; i + 16 <= numPixels && (i / 8) * bytesPer8 + bytesPer8 + 16 <= sourceSize; i += 16)
+	{
+		const uint8_t *pBytes = pSource + (i / 8) * bytesPer8;
+		__m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)pBytes)), _mm_loadu_si128((const __m128i*)(pBytes + bytesPer8)), 1);
+		_mm256_storeu_si256((__m256i*)(pDestination + i), unpack16_avx2<packing>(_mm256_shuffle_epi8(bytes, shuffle), alignMsb));
+	}
+	return i;
+}
+
+template <EPacking packing>
+static size_t unpack_simd(CPixelKernels::EInstructionSet instructionSet, const uint8_t *pSource, size_t sourceSize, size_t numPixels, uint16_t *pDestination, bool alignMsb)
+{
+	size_t i = 0;
+	if (instructionSet == CPixelKernels::InstructionSet_AVX2)
+		i = unpack_avx2<packing>(pSource, sourceSize, i, numPixels, pDestination, alignMsb);
+	if (instructionSet >= CPixelKernels::InstructionSet_SSE41)
+		i = unpack_sse41<packing>(pSource, sourceSize, i, numPixels, pDestination, alignMsb);
+	return i;
+}
+
+#endif // PIXELKERNELS_X86
+
+bool CPixelKernels::UnpackTo16(const uint8_t *pSource, size_t sourceSize, Pylon::EPixelType pixelType, size_t numPixels, uint16_t *pDestination, bool alignMsb)
+{
+	EPacking packing;
+	switch (pixelType)
+	{
+	case Pylon::PixelType_Mono10p:
+	case Pylon::PixelType_BayerGR10p:
+	case Pylon::PixelType_BayerRG10p:
+	case Pylon::PixelType_BayerGB10p:
+	case Pylon::PixelType_BayerBG10p:
+		packing = Packing_10p;
+		break;
+	case Pylon::PixelType_Mono12p:
+	case Pylon::PixelType_BayerGR12p:
+	case Pylon::PixelType_BayerRG12p:
+	case Pylon::PixelType_BayerGB12p:
+	case Pylon::PixelType_BayerBG12p:
+		packing = Packing_12p;
+		break;
+	case Pylon::PixelType_Mono10packed:
+		packing = Packing_10Packed;
+		break;
+	case Pylon::PixelType_Mono12packed:
+	case Pylon::PixelType_BayerGR12Packed:
+	case Pylon::PixelType_BayerRG12Packed:
+	case Pylon::PixelType_BayerGB12Packed:
+	case Pylon::PixelType_BayerBG12Packed:
+		packing = Packing_12Packed;
+		break;
+	default:
+		return false;
+	}
+
+	size_t i = 0;
+#if defined(PIXELKERNELS_X86)
+	EInstructionSet instructionSet = GetInstructionSet();
+	switch (packing)
+	{
+	case Packing_10p:
+		i = unpack_simd<Packing_10p>(instructionSet, pSource, sourceSize, numPixels, pDestination, alignMsb);
+		break;
+	case Packing_12p:
+		i = unpack_simd<Packing_12p>(instructionSet, pSource, sourceSize, numPixels, pDestination, alignMsb);
+		break;
+	case Packing_10Packed:
+		i = unpack_simd<Packing_10Packed>(instructionSet, pSource, sourceSize, numPixels, pDestination, alignMsb);
+		break;
+	case Packing_12Packed:
+		i = unpack_simd<Packing_12Packed>(instructionSet, pSource, sourceSize, numPixels, pDestination, alignMsb);
+		break;
+	}
+#endif
+
+	// the rest (and everything on other CPUs)
+	unpack_scalar(packing, pSource, sourceSize, i, numPixels, pDestination);
+	if (alignMsb == true)
+		AlignMsb16(pDestination + i, numPixels - i, (packing == Packing_10p || packing == Packing_10Packed) ? 10 : 12);
+
+	return true;
+}
+
+void CPixelKernels::AlignMsb16(uint16_t *pPixels, size_t numPixels, uint32_t bitDepth)
+{
+	if (bitDepth >= 16)
+		return;
+
+	// simple enough for the compiler to vectorize
+	uint32_t shift = 16 - bitDepth;
+	for (size_t i = 0; i < numPixels; i++)
+		pPixels[i] = (uint16_t)(pPixels[i] << shift);
+}
+
+// ******* Bilinear resampling and transposing *******
+// Bilinear scaling is split in two: BlendRows() blends the two source rows around an output row (contiguous, so plain SIMD),
+// then ResampleRow() blends the two columns around each output pixel, picked with a table of column indices and weights (a gather).
+// Weights are 0..256. 8-bit rows are blended into 15 bits, so the gather can fetch both columns of a pixel as one 32-bit lane of 16-bit halves
+// and weigh them with a single multiply-add. Transposing (for 90 and 270 degree rotation) is done in 8x8 blocks of registers.
+
+static void blend_rows_scalar(const uint8_t *pRow0, const uint8_t *pRow1, uint32_t weight, size_t first, size_t numPixels, int16_t *pDestination)
+{
+	for (size_t i = first; i < numPixels; i++)
+		pDestination[i] = (int16_t)((pRow0[i] * (256 - weight) + pRow1[i] * weight) >> 1);
+}
+
+static void blend_rows_scalar(const uint16_t *pRow0, const uint16_t *pRow1, uint32_t weight, size_t first, size_t numPixels, uint32_t *pDestination)
+{
+	for (size_t i = first; i < numPixels; i++)
+		pDestination[i] = pRow0[i] * (256 - weight) + pRow1[i] * weight;
+}
+
+static void resample_row_scalar(const int16_t *pBlended, int32_t firstIndex, const int32_t *pIndex, const uint32_t *pWeights, size_t first, size_t numPixels, uint8_t *pDestination)
+{
+	for (size_t i = first; i < numPixels; i++)
+	{
+		const int16_t *pPair = pBlended + (pIndex[i] - firstIndex);
+		pDestination[i] = (uint8_t)((pPair[0] * (int32_t)(pWeights[i] & 0xffff) + pPair[1] * (int32_t)(pWeights[i] >> 16) + (1 << 14)) >> 15);
+	}
+}
+
+static void resample_row_scalar(const uint32_t *pBlended, int32_t firstIndex, const int32_t *pIndex, const uint32_t *pWeights, size_t first, size_t numPixels, uint16_t *pDestination)
+{
+	for (size_t i = first; i < numPixels; i++)
+	{
+		const uint32_t *pPair = pBlended + (pIndex[i] - firstIndex);
+		pDestination[i] = (uint16_t)((pPair[0] * (uint64_t)(pWeights[i] & 0xffff) + pPair[1] * (uint64_t)(pWeights[i] >> 16) + (1 << 15)) >> 16);
+	}
+}
+
+template <typename T>
+static void transpose_scalar(const uint8_t *pSource, size_t sourceStride, uint8_t *pDestination, size_t destinationStride, uint32_t xBegin, uint32_t width, uint32_t yBegin, uint32_t height)
+{
+	for (uint32_t y = yBegin; y < height; y++)
+	{
+		const T *pRow = (const T*)(pSource + y * sourceStride);
+		for (uint32_t x = xBegin; x < width; x++)
+			((T*)(pDestination + x * destinationStride))[y] = pRow[x];
+	}
+}
+
+#if defined(PIXELKERNELS_X86)
+
+TARGET_SSE41 static size_t blend_rows_sse41(const uint8_t *pRow0, const uint8_t *pRow1, uint32_t weight, size_t numPixels, int16_t *pDestination)
+{
+	__m128i weight0 = _mm_set1_epi16((short)(256 - weight));
+	__m128i weight1 = _mm_set1_epi16((short)weight);
+	size_t i = 0;
+	for (; i + 8 <= numPixels; i += 8)
+	{
+		__m128i row0 = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(pRow0 + i)));
+		__m128i row1 = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(pRow1 + i)));
+		__m128i sum = _mm_add_epi16(_mm_mullo_epi16(row0, weight0), _mm_mullo_epi16(row1, weight1)); // up to 65280, unsigned
+		_mm_storeu_si128((__m128i*)(pDestination + i), _mm_srli_epi16(sum, 1));
+	}
+	return i;
+}
+
+TARGET_SSE41 static size_t blend_rows_sse41(const uint16_t *pRow0, const uint16_t *pRow1, uint32_t weight, size_t numPixels, uint32_t *pDestination)
+{
+	__m128i weight0 = _mm_set1_epi32((int)(256 - weight));
+	__m128i weight1 = _mm_set1_epi32((int)weight);
+	size_t i = 0;
+	for (; i + 4 <= numPixels; i += 4)
+	{
+		__m128i row0 = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)(pRow0 + i)));
+		__m128i row1 = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)(pRow1 + i)));
+		_mm_storeu_si128((__m128i*)(pDestination + i), _mm_add_epi32(_mm_mullo_epi32(row0, weight0), _mm_mullo_epi32(row1, weight1)));
+	}
+	return i;
+}
+
+TARGET_AVX2 static size_t blend_rows_avx2(const uint8_t *pRow0, const uint8_t *pRow1, uint32_t weight, size_t numPixels, int16_t *pDestination)
+{
+	__m256i weight0 = _mm256_set1_epi16((short)(256 - weight));
+	__m256i weight1 = _mm256_set1_epi16((short)weight);
+	size_t i = 0;
+	for (; i + 16 <= numPixels; i += 16)
+	{
+		__m256i row0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(pRow0 + i)));
+		__m256i row1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(pRow1 + i)));
+		__m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(row0, weight0), _mm256_mullo_epi16(row1, weight1));
+		_mm256_storeu_si256((__m256i*)(pDestination + i), _mm256_srli_epi16(sum, 1));
+	}
+	return i;
+}
+
+TARGET_AVX2 static size_t blend_rows_avx2(const uint16_t *pRow0, const uint16_t *pRow1, uint32_t weight, size_t numPixels, uint32_t *pDestination)
+{
+	__m256i weight0 = _mm256_set1_epi32((int)(256 - weight));
+	__m256i weight1 = _mm256_set1_epi32((int)weight);
+	size_t i = 0;
+	for (; i + 8 <= numPixels; i += 8)
+	{
+		__m256i row0 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(pRow0 + i)));
+		__m256i row1 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(pRow1 + i)));
+		_mm256_storeu_si256((__m256i*)(pDestination + i), _mm256_add_epi32(_mm256_mullo_epi32(row0, weight0), _mm256_mullo_epi32(row1, weight1)));
+	}
+	return i;
+}
+
+// 8 output pixels per step: one gather fetches each pixel's left and right blended column, one multiply-add weighs them.
+TARGET_AVX2 static size_t resample_row_avx2(const int16_t *pBlended, int32_t firstIndex, const int32_t *pIndex, const uint32_t *pWeights, size_t numPixels, uint8_t *pDestination)
+{
+	__m256i offset = _mm256_set1_epi32(firstIndex);
+	__m256i rounding = _mm256_set1_epi32(1 << 14);
+	size_t i = 0;
+	for (; i + 8 <= numPixels; i += 8)
+	{
+		__m256i index = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(pIndex + i)), offset);
+		__m256i pairs = _mm256_i32gather_epi32((const int*)pBlended, index, 2);
+		__m256i sum = _mm256_madd_epi16(pairs, _mm256_loadu_si256((const __m256i*)(pWeights + i)));
+		__m256i pixels = _mm256_srai_epi32(_mm256_add_epi32(sum, rounding), 15);
+		pixels = _mm256_packus_epi16(_mm256_packus_epi32(pixels, pixels), _mm256_setzero_si256());
+		uint32_t low = (uint32_t)_mm_cvtsi128_si32(_mm256_castsi256_si128(pixels));
+		uint32_t high = (uint32_t)_mm_cvtsi128_si32(_mm256_extracti128_si256(pixels, 1));
+		memcpy(pDestination + i, &low, 4);
+		memcpy(pDestination + i + 4, &high, 4);
+	}
+	return i;
+}
+
+TARGET_SSE41 static inline void transpose8x8_sse41(const uint8_t *pSource, size_t sourceStride, uint8_t *pDestination, size_t destinationStride)
+{
+	__m128i r[8];
+	for (int i = 0; i < 8; i++)
+		r[i] = _mm_loadl_epi64((const __m128i*)(pSource + i * sourceStride));
+
+	// interleave ever wider units, until each register holds two columns
+	__m128i t0 = _mm_unpacklo_epi8(r[0], r[1]);
+	__m128i t1 = _mm_unpacklo_epi8(r[2], r[3]);
+	__m128i t2 = _mm_unpacklo_epi8(r[4], r[5]);
+	__m128i t3 = _mm_unpacklo_epi8(r[6], r[7]);
+	__m128i u0 = _mm_unpacklo_epi16(t0, t1);
+	__m128i u1 = _mm_unpackhi_epi16(t0, t1);
+	__m128i u2 = _mm_unpacklo_epi16(t2, t3);
+	__m128i u3 = _mm_unpackhi_epi16(t2, t3);
+	__m128i columns[4] = { _mm_unpacklo_epi32(u0, u2), _mm_unpackhi_epi32(u0, u2), _mm_unpacklo_epi32(u1, u3), _mm_unpackhi_epi32(u1, u3) };
+
+	for (int i = 0; i < 4; i++)
+	{
+		_mm_storel_epi64((__m128i*)(pDestination + (2 * i) * destinationStride), columns[i]);
+		_mm_storel_epi64((__m128i*)(pDestination + (2 * i + 1) * destinationStride), _mm_unpackhi_epi64(columns[i], columns[i]));
+	}
+}
+
+TARGET_SSE41 static inline void transpose8x8_16_sse41(const uint8_t *pSource, size_t sourceStride, uint8_t *pDestination, size_t destinationStride)
+{
+	__m128i r[8];
+	for (int i = 0; i < 8; i++)
+		r[i] = _mm_loadu_si128((const __m128i*)(pSource + i * sourceStride));
+
+	__m128i t[8];
+	for (int i = 0; i < 4; i++)
+	{
+		t[2 * i] = _mm_unpacklo_epi16(r[2 * i], r[2 * i + 1]);
+		t[2 * i + 1] = _mm_unpackhi_epi16(r[2 * i], r[2 * i + 1]);
+	}
+	__m128i u[8];
+	for (int i = 0; i < 2; i++)
+	{
+		u[4 * i] = _mm_unpacklo_epi32(t[4 * i], t[4 * i + 2]);
+		u[4 * i + 1] = _mm_unpackhi_epi32(t[4 * i], t[4 * i + 2]);
+		u[4 * i + 2] = _mm_unpacklo_epi32(t[4 * i + 1], t[4 * i + 3]);
+		u[4 * i + 3] = _mm_unpackhi_epi32(t[4 * i + 1], t[4 * i + 3]);
+	}
+	for (int i = 0; i < 4; i++)
+	{
+		_mm_storeu_si128((__m128i*)(pDestination + (2 * i) * destinationStride), _mm_unpacklo_epi64(u[i], u[i + 4]));
+		_mm_storeu_si128((__m128i*)(pDestination + (2 * i + 1) * destinationStride), _mm_unpackhi_epi64(u[i], u[i + 4]));
+	}
+}
+
+#endif // PIXELKERNELS_X86
+
+void CPixelKernels::BlendRows(const uint8_t *pRow0, const uint8_t *pRow1, uint32_t weight, size_t numPixels, int16_t *pDestination)
+{
+	size_t i = 0;
+#if defined(PIXELKERNELS_X86)
+	EInstructionSet instructionSet = GetInstructionSet();
+	if (instructionSet == InstructionSet_AVX2)
+		i = blend_rows_avx2(pRow0, pRow1, weight, numPixels, pDestination);
+	else if (instructionSet == InstructionSet_SSE41)
+		i = blend_rows_sse41(pRow0, pRow1, weight, numPixels, pDestination);
+#endif
+	blend_rows_scalar(pRow0, pRow1, weight, i, numPixels, pDestination);
+}
+
+void CPixelKernels::BlendRows(const uint16_t *pRow0, const uint16_t *pRow1, uint32_t weight, size_t numPixels, uint32_t *pDestination)
+{
+	size_t i = 0;
+#if defined(PIXELKERNELS_X86)
+	EInstructionSet instructionSet = GetInstructionSet();
+	if (instructionSet == InstructionSet_AVX2)
+		i = blend_rows_avx2(pRow0, pRow1, weight, numPixels, pDestination);
+	else if (instructionSet == InstructionSet_SSE41)
+		i = blend_rows_sse41(pRow0, pRow1, weight, numPixels, pDestination);
+#endif
+	blend_rows_scalar(pRow0, pRow1, weight, i, numPixels, pDestination);
+}
+
+void CPixelKernels::ResampleRow(const int16_t *pBlended, int32_t firstIndex, const int32_t *pIndex, const uint32_t *pWeights, size_t numPixels, uint8_t *pDestination)
+{
+	size_t i = 0;
+#if defined(PIXELKERNELS_X86)
+	if (GetInstructionSet() == InstructionSet_AVX2)
+		i = resample_row_avx2(pBlended, firstIndex, pIndex, pWeights, numPixels, pDestination);
+#endif
+	resample_row_scalar(pBlended, firstIndex, pIndex, pWeights, i, numPixels, pDestination);
+}
+
+void CPixelKernels::ResampleRow(const uint32_t *pBlended, int32_t firstIndex, const int32_t *pIndex, const uint32_t *pWeights, size_t numPixels, uint16_t *pDestination)
+{
+	resample_row_scalar(pBlended, firstIndex, pIndex, pWeights, 0, numPixels, pDestination);
+}
+
+void CPixelKernels::Transpose(const uint8_t *pSource, size_t sourceStride, uint8_t *pDestination, size_t destinationStride, uint32_t width, uint32_t height, uint32_t bytesPerPixel)
+{
+	uint32_t blockWidth = 0;
+	uint32_t blockHeight = 0;
+#if defined(PIXELKERNELS_X86)
+	if (GetInstructionSet() >= InstructionSet_SSE41 && (bytesPerPixel == 1 || bytesPerPixel == 2))
+	{
+		blockWidth = width & ~7u;
+		blockHeight = height & ~7u;
+		for (uint32_t y = 0; y < blockHeight; y += 8)
+		{
+			for (uint32_t x = 0; x < blockWidth; x += 8)
+			{
+				const uint8_t *pBlock = pSource + y * sourceStride + x * bytesPerPixel;
+				uint8_t *pTransposed = pDestination + x * destinationStride + y * bytesPerPixel;
+				if (bytesPerPixel == 1)
+					transpose8x8_sse41(pBlock, sourceStride, pTransposed, destinationStride);
+				else
+					transpose8x8_16_sse41(pBlock, sourceStride, pTransposed, destinationStride);
+			}
+		}
+	}
+#endif
+
+	// the columns right of the blocks, then the rows below them
+	if (bytesPerPixel == 1)
+	{
+		transpose_scalar<uint8_t>(pSource, sourceStride, pDestination, destinationStride, blockWidth, width, 0, blockHeight);
+		transpose_scalar<uint8_t>(pSource, sourceStride, pDestination, destinationStride, 0, width, blockHeight, height);
+	}
+	else
+	{
+		transpose_scalar<uint16_t>(pSource, sourceStride, pDestination, destinationStride, blockWidth, width, 0, blockHeight);
+		transpose_scalar<uint16_t>(pSource, sourceStride, pDestination, destinationStride, 0, width, blockHeight, height);
+	}
+}
@@ -0,0 +1,80 @@
+/*  CPixelKernels.h: header file for CPixelKernels Class.
+    Hand-written (SIMD) pixel kernels for the conversions Pylon's image format converter does not offer.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#pragma once
+
+#include <pylon/PylonIncludes.h>
+#include <stdint.h>
+
+// ******* CPixelKernels *******
+// Each kernel has SIMD versions (AVX2 and/or SSE4.1) and a plain C++ version. The best version the CPU supports is picked at run time.
+// Kernels work on a range of rows, so they can be split into stripes on a CWorkerPool.
+class CPixelKernels
+{
+public:
+	enum EInstructionSet
+	{
+		InstructionSet_Scalar,
+		InstructionSet_SSE41,
+		InstructionSet_AVX2
+	};
+
+	// Where the planes of a YUV image are in a buffer. Matches GStreamer's default layout for I420, NV12 and Y42B.
+	struct SYuvLayout
+	{
+		size_t offset[3]; // Y, U, V. For NV12, U and V are interleaved and V is at offset[1] + 1.
+		size_t stride[3];
+		size_t size;
+	};
+
+	static EInstructionSet GetInstructionSet();
+	static void SetMaxInstructionSet(EInstructionSet instructionSet);
+	static const char* GetInstructionSetName(EInstructionSet instructionSet);
+
+	static bool IsBayer8(Pylon::EPixelType pixelType);
+	static Pylon::EPixelType GetUnpackedPixelType(Pylon::EPixelType packedPixelType);
+	static SYuvLayout GetYuv420Layout(uint32_t width, uint32_t height, bool isNV12);
+	static SYuvLayout GetY42BLayout(uint32_t width, uint32_t height);
+
+	// Demosaic 8-bit Bayer (bilinear) and convert to BT.601 4:2:0 YUV in one pass, for rows [firstRow, lastRow).
+	// width and height must be even, and so must firstRow and lastRow (unless lastRow == height).
+	static bool BayerToYuv420(const uint8_t *pSource, size_t sourceStride, Pylon::EPixelType pixelType, uint32_t width, uint32_t height,
+		uint8_t *pDestination, bool isNV12, uint32_t firstRow, uint32_t lastRow);
+
+	// Unpack numPixels of a packed 10 or 12-bit format (eg: Mono12p, Mono10packed, BayerRG12p) into 16 bits per pixel (little endian on x86 and ARM).
+	// pSource must start on a pixel that begins on a byte, ie: a multiple of 4 pixels into the packed stream. sourceSize bounds the reads.
+	// alignMsb: shift the pixels into the upper bits (eg: 12-bit 0..4095 -> 0..65520), so 16-bit consumers see the full range.
+	static bool UnpackTo16(const uint8_t *pSource, size_t sourceSize, Pylon::EPixelType pixelType, size_t numPixels, uint16_t *pDestination, bool alignMsb);
+	// Shift numPixels 16-bit pixels of bitDepth bits into the upper bits, in place
+	static void AlignMsb16(uint16_t *pPixels, size_t numPixels, uint32_t bitDepth);
+
+	// The vertical half of bilinear scaling: blend two source rows with weight 0..256 (0 = all pRow0).
+	// 8-bit rows are blended into 15 bits (sum >> 1), 16-bit rows into 24 bits, as ResampleRow() expects them.
+	static void BlendRows(const uint8_t *pRow0, const uint8_t *pRow1, uint32_t weight, size_t numPixels, int16_t *pDestination);
+	static void BlendRows(const uint16_t *pRow0, const uint16_t *pRow1, uint32_t weight, size_t numPixels, uint32_t *pDestination);
+	// The horizontal half: pixel i blends the blended columns pIndex[i] and pIndex[i] + 1 (pBlended starts at column firstIndex).
+	// pWeights[i] holds the weight of the left column in the low 16 bits and of the right column in the high 16 bits, adding up to 256.
+	static void ResampleRow(const int16_t *pBlended, int32_t firstIndex, const int32_t *pIndex, const uint32_t *pWeights, size_t numPixels, uint8_t *pDestination);
+	static void ResampleRow(const uint32_t *pBlended, int32_t firstIndex, const int32_t *pIndex, const uint32_t *pWeights, size_t numPixels, uint16_t *pDestination);
+	// Row x of pDestination = column x of a width x height block of pSource, for 1 or 2 bytes per pixel. Strides are in bytes.
+	static void Transpose(const uint8_t *pSource, size_t sourceStride, uint8_t *pDestination, size_t destinationStride, uint32_t width, uint32_t height, uint32_t bytesPerPixel);
+};
@@ -0,0 +1,237 @@
+/*  CScaleRotate.cpp: Definition file for CScaleRotate Class.
+    Rescales (bilinear), flips and rotates image planes in one pass, in parallel on a CWorkerPool.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#include "CScaleRotate.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Tiles of 64 x 64 pixels (4 or 8 KB) and the source rows they are scaled from stay in the L1 cache until they are transposed.
+static const uint32_t TILE_SIZE = 64;
+
+// Stripes thinner than this cost more in hand-over than they gain.
+static const uint32_t MIN_STRIPE_ROWS = 16;
+
+// pWorkerPool: the threads that transform the stripes. NULL = transform all stripes on the calling thread.
+CScaleRotate::CScaleRotate(CWorkerPool *pWorkerPool)
+{
+	m_pWorkerPool = pWorkerPool;
+	m_numStripes = 1;
+	m_isConfigured = false;
+	m_isTransposed = false;
+	m_isScaled = false;
+	m_isReversedX = false;
+	m_isReversedY = false;
+	m_sourceWidth = 0;
+	m_sourceHeight = 0;
+	m_scaledWidth = 0;
+	m_scaledHeight = 0;
+	m_blendBuffers.resize(1);
+	m_tileBuffers.resize(1);
+}
+
+void CScaleRotate::SetWorkerPool(CWorkerPool *pWorkerPool)
+{
+	m_pWorkerPool = pWorkerPool;
+}
+
+// How many stripes to split each plane into. Usually the number of threads in the worker pool.
+void CScaleRotate::SetNumStripes(int numStripes)
+{
+	m_numStripes = (numStripes < 1) ? 1 : numStripes;
+	m_blendBuffers.resize(m_numStripes);
+	m_tileBuffers.resize(m_numStripes);
+}
+
+bool CScaleRotate::Configure(uint32_t sourceWidth, uint32_t sourceHeight, uint32_t scaledWidth, uint32_t scaledHeight, int rotation, bool flipX, bool flipY)
+{
+	m_isConfigured = false;
+	if (sourceWidth < 2 || sourceHeight < 2 || scaledWidth < 2 || scaledHeight < 2)
+		return false;
+
+	// Work out which way the tables run, so that transposing (or not) the scaled image gives the rotated image.
+	// 90: the scaled image upside down, transposed. 270: the scaled image mirrored, transposed. 180: upside down and mirrored.
+	bool isReversedX = flipX;
+	bool isReversedY = flipY;
+	switch (rotation)
+	{
+	case -1:
+	case 0:
+		m_isTransposed = false;
+		break;
+	case 90:
+		m_isTransposed = true;
+		isReversedY = !isReversedY;
+		break;
+	case 180:
+		m_isTransposed = false;
+		isReversedX = !isReversedX;
+		isReversedY = !isReversedY;
+		break;
+	case 270:
+		m_isTransposed = true;
+		isReversedX = !isReversedX;
+		break;
+	default:
+		return false;
+	}
+
+	m_sourceWidth = sourceWidth;
+	m_sourceHeight = sourceHeight;
+	m_scaledWidth = scaledWidth;
+	m_scaledHeight = scaledHeight;
+	m_isScaled = (sourceWidth != scaledWidth || sourceHeight != scaledHeight);
+	m_isReversedX = isReversedX;
+	m_isReversedY = isReversedY;
+	make_table(sourceWidth, scaledWidth, isReversedX, m_xIndex, m_xWeights, true);
+	make_table(sourceHeight, scaledHeight, isReversedY, m_yIndex, m_yWeight, false);
+	m_isConfigured = true;
+	return true;
+}
+
+uint32_t CScaleRotate::GetOutputWidth()
+{
+	return (m_isTransposed == true) ? m_scaledHeight : m_scaledWidth;
+}
+
+uint32_t CScaleRotate::GetOutputHeight()
+{
+	return (m_isTransposed == true) ? m_scaledWidth : m_scaledHeight;
+}
+
+void CScaleRotate::Transform(const uint8_t *pSource, size_t sourceStride, uint8_t *pDestination, size_t destinationStride)
+{
+	transform<uint8_t, int16_t>(pSource, sourceStride, pDestination, destinationStride);
+}
+
+void CScaleRotate::Transform(const uint16_t *pSource, size_t sourceStride, uint16_t *pDestination, size_t destinationStride)
+{
+	transform<uint16_t, uint32_t>(pSource, sourceStride, pDestination, destinationStride);
+}
+
+// For each scaled pixel (of a row or column), the source pixel before it and the weight of the one after it. Pixel centers line up like videoscale's.
+// Pixels beyond the first and last source pixel repeat them.
+void CScaleRotate::make_table(uint32_t sourceSize, uint32_t scaledSize, bool isReversed, std::vector<int32_t> &index, std::vector<uint32_t> &weights, bool isPacked)
+{
+	index.resize(scaledSize);
+	weights.resize(scaledSize);
+
+	for (uint32_t i = 0; i < scaledSize; i++)
+	{
+		uint32_t scaled = (isReversed == true) ? scaledSize - 1 - i : i;
+		double position = (scaled + 0.5) * sourceSize / scaledSize - 0.5;
+		int32_t first = (int32_t)std::floor(position);
+		uint32_t weight = (uint32_t)std::lround((position - first) * 256);
+
+		if (position <= 0)
+		{
+			first = 0;
+			weight = 0;
+		}
+		else if (first >= (int32_t)sourceSize - 1)
+		{
+			first = (int32_t)sourceSize - 2;
+			weight = 256;
+		}
+
+		index[i] = first;
+		weights[i] = (isPacked == true) ? ((weight << 16) | (256 - weight)) : weight;
+	}
+}
+
+template <typename TPixel, typename TBlended>
+void CScaleRotate::transform(const TPixel *pSource, size_t sourceStride, TPixel *pDestination, size_t destinationStride)
+{
+	if (m_isConfigured == false)
+		return;
+
+	// Split the scaled image (before it's transposed) into stripes of rows. Without transposing, each stripe is scaled row by row straight into the destination.
+	// When transposing, a stripe is a column of the destination, so its rows are whole tiles.
+	int numStripes = (int)std::min<uint32_t>((uint32_t)m_numStripes, std::max<uint32_t>(m_scaledHeight / MIN_STRIPE_ROWS, 1));
+	uint32_t stripeRows = (m_scaledHeight + numStripes - 1) / numStripes;
+	uint32_t tileWidth = m_scaledWidth;
+	if (m_isTransposed == true)
+	{
+		stripeRows = (stripeRows + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE;
+		tileWidth = TILE_SIZE;
+	}
+
+	for (int stripe = 0; stripe < numStripes; stripe++)
+	{
+		m_blendBuffers[stripe].resize(m_sourceWidth);
+		m_tileBuffers[stripe].resize(TILE_SIZE * TILE_SIZE);
+	}
+
+	std::function<void(int)> transformStripe = [&](int stripe)
+	{
+		uint32_t first = stripe * stripeRows;
+		uint32_t last = std::min(m_scaledHeight, first + stripeRows);
+		uint32_t tileHeight = (m_isTransposed == true) ? TILE_SIZE : stripeRows;
+
+		for (uint32_t y0 = first; y0 < last; y0 += tileHeight)
+			for (uint32_t x0 = 0; x0 < m_scaledWidth; x0 += tileWidth)
+				transform_tile<TPixel, TBlended>(pSource, sourceStride, pDestination, destinationStride, x0, std::min(m_scaledWidth, x0 + tileWidth), y0, std::min(last, y0 + tileHeight), stripe);
+	};
+
+	if (m_pWorkerPool != NULL && numStripes > 1)
+		m_pWorkerPool->Run(numStripes, transformStripe);
+	else
+		for (int stripe = 0; stripe < numStripes; stripe++)
+			transformStripe(stripe);
+}
+
+// Scale the pixels [x0, x1) x [y0, y1) of the scaled image, and write them to the destination directly or transposed
+template <typename TPixel, typename TBlended>
+void CScaleRotate::transform_tile(const TPixel *pSource, size_t sourceStride, TPixel *pDestination, size_t destinationStride, uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1, int stripe)
+{
+	// the source columns under the tile (the tables run forwards or backwards)
+	int32_t firstIndex = std::min(m_xIndex[x0], m_xIndex[x1 - 1]);
+	size_t numColumns = std::max(m_xIndex[x0], m_xIndex[x1 - 1]) + 2 - firstIndex;
+
+	TBlended *pBlended = (TBlended*)m_blendBuffers[stripe].data();
+	uint8_t *pTile = (uint8_t*)m_tileBuffers[stripe].data();
+	size_t tileStride = (x1 - x0) * sizeof(TPixel);
+
+	for (uint32_t y = y0; y < y1; y++)
+	{
+		TPixel *pScaled = (m_isTransposed == true) ? (TPixel*)(pTile + (y - y0) * tileStride) : (TPixel*)((uint8_t*)pDestination + y * destinationStride) + x0;
+
+		if (m_isScaled == false)
+		{
+			const TPixel *pRow = (const TPixel*)((const uint8_t*)pSource + ((m_isReversedY == true) ? m_sourceHeight - 1 - y : y) * sourceStride);
+			if (m_isReversedX == false)
+				memcpy(pScaled, pRow + x0, (x1 - x0) * sizeof(TPixel));
+			else
+				for (uint32_t x = x0; x < x1; x++)
+					pScaled[x - x0] = pRow[m_sourceWidth - 1 - x];
+			continue;
+		}
+
+		const TPixel *pRow0 = (const TPixel*)((const uint8_t*)pSource + m_yIndex[y] * sourceStride) + firstIndex;
+		const TPixel *pRow1 = (const TPixel*)((const uint8_t*)pSource + (m_yIndex[y] + 1) * sourceStride) + firstIndex;
+		CPixelKernels::BlendRows(pRow0, pRow1, m_yWeight[y], numColumns, pBlended);
+		CPixelKernels::ResampleRow(pBlended, firstIndex, m_xIndex.data() + x0, m_xWeights.data() + x0, x1 - x0, pScaled);
+	}
+
+	if (m_isTransposed == true)
+		CPixelKernels::Transpose(pTile, tileStride, (uint8_t*)pDestination + x0 * destinationStride + y0 * sizeof(TPixel), destinationStride, x1 - x0, y1 - y0, sizeof(TPixel));
+}
@@ -0,0 +1,76 @@
+/*  CScaleRotate.h: header file for CScaleRotate Class.
+    Rescales (bilinear), flips and rotates image planes in one pass, in parallel on a CWorkerPool.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "CWorkerPool.h"
+#include "CPixelKernels.h"
+
+// ******* CScaleRotate *******
+// Does the work of videoscale and videoflip on one plane of 8 or 16-bit pixels (eg: GRAY8, GRAY16_LE, or each plane of I420), without an intermediate image.
+// Flips cost nothing: the tables that pick the source pixels for each scaled pixel simply run backwards.
+// 90 and 270 degree rotations are a flip plus a transpose. The plane is then scaled in small tiles that stay in the cache and are transposed into the destination.
+class CScaleRotate
+{
+public:
+	CScaleRotate(CWorkerPool *pWorkerPool = NULL);
+
+	void SetWorkerPool(CWorkerPool *pWorkerPool);
+	void SetNumStripes(int numStripes);
+
+	// rotation: 0, 90, 180 or 270 degrees clockwise. flipX and flipY mirror the scaled image before it is rotated.
+	// Returns false (and does nothing on Transform()) if a size is smaller than 2x2 or the rotation is not a multiple of 90.
+	bool Configure(uint32_t sourceWidth, uint32_t sourceHeight, uint32_t scaledWidth, uint32_t scaledHeight, int rotation, bool flipX = false, bool flipY = false);
+	uint32_t GetOutputWidth();
+	uint32_t GetOutputHeight();
+
+	// Strides are in bytes.
+	void Transform(const uint8_t *pSource, size_t sourceStride, uint8_t *pDestination, size_t destinationStride);
+	void Transform(const uint16_t *pSource, size_t sourceStride, uint16_t *pDestination, size_t destinationStride);
+
+private:
+	CWorkerPool *m_pWorkerPool;
+	int m_numStripes;
+	bool m_isConfigured;
+	bool m_isTransposed;
+	bool m_isScaled;    // false = the plane is only flipped or rotated, so the pixels are copied rather than blended
+	bool m_isReversedX;
+	bool m_isReversedY;
+	uint32_t m_sourceWidth;
+	uint32_t m_sourceHeight;
+	uint32_t m_scaledWidth;
+	uint32_t m_scaledHeight;
+	std::vector<int32_t> m_xIndex;   // per scaled column: the left source column
+	std::vector<uint32_t> m_xWeights; // per scaled column: the weights of the left and right source column (see CPixelKernels::ResampleRow())
+	std::vector<int32_t> m_yIndex;   // per scaled row: the upper source row
+	std::vector<uint32_t> m_yWeight;  // per scaled row: the weight of the lower source row
+	std::vector< std::vector<uint32_t> > m_blendBuffers; // one per stripe, for the blended source rows
+	std::vector< std::vector<uint16_t> > m_tileBuffers;  // one per stripe, for the tile before it is transposed
+
+	static void make_table(uint32_t sourceSize, uint32_t scaledSize, bool isReversed, std::vector<int32_t> &index, std::vector<uint32_t> &weights, bool isPacked);
+	template <typename TPixel, typename TBlended>
+	void transform(const TPixel *pSource, size_t sourceStride, TPixel *pDestination, size_t destinationStride);
+	template <typename TPixel, typename TBlended>
+	void transform_tile(const TPixel *pSource, size_t sourceStride, TPixel *pDestination, size_t destinationStride, uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1, int stripe);
+};
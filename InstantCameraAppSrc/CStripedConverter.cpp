@@ -0,0 +1,264 @@
+/*  CStripedConverter.cpp: Definition file for CStripedConverter Class.
+    Converts pixel formats in row stripes, in parallel on a CWorkerPool.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#include "CStripedConverter.h"
+#include <algorithm>
+#include <cstring>
+
+// Halo rows above and below each stripe of a Bayer image. An even number keeps every stripe starting on the same Bayer phase.
+static const uint32_t BAYER_HALO_ROWS = 2;
+
+// Stripes thinner than this cost more in halo rows and hand-over than they gain.
+static const uint32_t MIN_STRIPE_ROWS = 16;
+
+// pWorkerPool: the threads that convert the stripes. NULL = convert all stripes on the calling thread.
+CStripedConverter::CStripedConverter(CWorkerPool *pWorkerPool)
+{
+	m_pWorkerPool = pWorkerPool;
+	m_outputPixelType = Pylon::PixelType_RGB8packed;
+	m_numStripes = 1;
+	create_converters(1);
+}
+
+CStripedConverter::~CStripedConverter()
+{
+	destroy_converters();
+}
+
+void CStripedConverter::SetWorkerPool(CWorkerPool *pWorkerPool)
+{
+	m_pWorkerPool = pWorkerPool;
+}
+
+void CStripedConverter::SetOutputPixelFormat(Pylon::EPixelType pixelType)
+{
+	m_outputPixelType = pixelType;
+	for (size_t i = 0; i < m_converters.size(); i++)
+		m_converters[i]->OutputPixelFormat.SetValue(pixelType);
+}
+
+Pylon::EPixelType CStripedConverter::GetOutputPixelFormat()
+{
+	return m_outputPixelType;
+}
+
+// How many stripes to split each image into. Usually the number of threads in the worker pool.
+void CStripedConverter::SetNumStripes(int numStripes)
+{
+	m_numStripes = (numStripes < 1) ? 1 : numStripes;
+	create_converters(m_numStripes);
+}
+
+int CStripedConverter::GetNumStripes()
+{
+	return m_numStripes;
+}
+
+bool CStripedConverter::ImageHasDestinationFormat(const Pylon::IImage &image)
+{
+	return m_converters[0]->ImageHasDestinationFormat(image);
+}
+
+// Convert an image (eg: a grab result) into pDestination. The destination lines are not padded.
+void CStripedConverter::Convert(void *pDestination, size_t destinationSize, const Pylon::IImage &image)
+{
+	Convert(pDestination, destinationSize, image.GetBuffer(), image.GetImageSize(), image.GetPixelType(), image.GetWidth(), image.GetHeight(), image.GetPaddingX());
+}
+
+void CStripedConverter::Convert(void *pDestination, size_t destinationSize, const void *pSource, size_t sourceSize, Pylon::EPixelType sourcePixelType, uint32_t width, uint32_t height, size_t paddingX)
+{
+	size_t sourceLineSize = ((size_t)width * Pylon::BitPerPixel(sourcePixelType) + 7) / 8 + paddingX;
+	size_t destinationLineSize = ((size_t)width * Pylon::BitPerPixel(m_outputPixelType) + 7) / 8;
+	uint32_t haloRows = (Pylon::IsBayer(sourcePixelType) == true) ? BAYER_HALO_ROWS : 0;
+
+	int numStripes = (int)std::min<uint32_t>((uint32_t)m_numStripes, std::max<uint32_t>(height / MIN_STRIPE_ROWS, 1));
+
+	// not worth splitting
+	if (numStripes == 1)
+	{
+		m_converters[0]->Convert(pDestination, destinationSize, pSource, sourceSize, sourcePixelType, width, height, paddingX, Pylon::ImageOrientation_TopDown);
+		return;
+	}
+
+	// an even number of rows per stripe, so each stripe starts on the same Bayer phase as the image
+	uint32_t stripeRows = (height + numStripes - 1) / numStripes;
+	stripeRows += stripeRows % 2;
+
+	uint8_t *pDestinationRows = (uint8_t*)pDestination;
+	const uint8_t *pSourceRows = (const uint8_t*)pSource;
+
+	std::function<void(int)> convertStripe = [&](int stripe)
+	{
+		uint32_t first = stripe * stripeRows;
+		if (first >= height)
+			return;
+		uint32_t last = std::min(height, first + stripeRows);
+
+		if (haloRows == 0)
+		{
+			// the stripe converts straight into its rows of the destination
+			m_converters[stripe]->Convert(
+				pDestinationRows + first * destinationLineSize, (last - first) * destinationLineSize,
+				pSourceRows + first * sourceLineSize, (last - first) * sourceLineSize,
+				sourcePixelType, width, last - first, paddingX, Pylon::ImageOrientation_TopDown);
+			return;
+		}
+
+		// Convert the stripe including its halo rows into the stripe's own buffer, then copy only the stripe's rows to the destination.
+		// The halo rows are converted by the neighbouring stripes, so they can't be written to the destination from here.
+		uint32_t top = (first >= haloRows) ? first - haloRows : 0;
+		uint32_t bottom = std::min(height, last + haloRows);
+		std::vector<uint8_t> &haloBuffer = m_haloBuffers[stripe];
+		haloBuffer.resize((bottom - top) * destinationLineSize);
+
+		m_converters[stripe]->Convert(
+			haloBuffer.data(), haloBuffer.size(),
+			pSourceRows + top * sourceLineSize, (bottom - top) * sourceLineSize,
+			sourcePixelType, width, bottom - top, paddingX, Pylon::ImageOrientation_TopDown);
+
+		memcpy(pDestinationRows + first * destinationLineSize, haloBuffer.data() + (first - top) * destinationLineSize, (last - first) * destinationLineSize);
+	};
+
+	if (m_pWorkerPool != NULL)
+		m_pWorkerPool->Run(numStripes, convertStripe);
+	else
+		for (int stripe = 0; stripe < numStripes; stripe++)
+			convertStripe(stripe);
+}
+
+// Demosaic an 8-bit Bayer image straight into I420 or NV12 (GStreamer's default layout), with CPixelKernels instead of Pylon's converter.
+// The kernel reads the rows around a stripe from the source, so there are no halo rows to throw away.
+bool CStripedConverter::ConvertBayerToYuv420(void *pDestination, size_t destinationSize, const Pylon::IImage &image, bool isNV12)
+{
+	uint32_t width = image.GetWidth();
+	uint32_t height = image.GetHeight();
+	if (CPixelKernels::IsBayer8(image.GetPixelType()) == false || (width % 2) != 0 || (height % 2) != 0)
+		return false;
+	if (CPixelKernels::GetYuv420Layout(width, height, isNV12).size > destinationSize)
+		return false;
+
+	const uint8_t *pSource = (const uint8_t*)image.GetBuffer();
+	size_t sourceStride = width + image.GetPaddingX();
+
+	int numStripes = (int)std::min<uint32_t>((uint32_t)m_numStripes, std::max<uint32_t>(height / MIN_STRIPE_ROWS, 1));
+	uint32_t stripeRows = (height + numStripes - 1) / numStripes;
+	stripeRows += stripeRows % 2;
+
+	std::function<void(int)> convertStripe = [&](int stripe)
+	{
+		uint32_t first = stripe * stripeRows;
+		if (first >= height)
+			return;
+		CPixelKernels::BayerToYuv420(pSource, sourceStride, image.GetPixelType(), width, height, (uint8_t*)pDestination, isNV12, first, std::min(height, first + stripeRows));
+	};
+
+	if (m_pWorkerPool != NULL && numStripes > 1)
+		m_pWorkerPool->Run(numStripes, convertStripe);
+	else
+		for (int stripe = 0; stripe < numStripes; stripe++)
+			convertStripe(stripe);
+
+	return true;
+}
+
+// Unpack a packed 10 or 12-bit image (eg: Mono12p) into 16 bits per pixel with CPixelKernels. The destination lines are not padded.
+bool CStripedConverter::UnpackTo16(void *pDestination, size_t destinationSize, const Pylon::IImage &image, bool alignMsb)
+{
+	Pylon::EPixelType pixelType = image.GetPixelType();
+	uint32_t width = image.GetWidth();
+	uint32_t height = image.GetHeight();
+	size_t paddingX = image.GetPaddingX();
+	if (CPixelKernels::GetUnpackedPixelType(pixelType) == Pylon::PixelType_Undefined || destinationSize < (size_t)width * height * 2)
+		return false;
+
+	const uint8_t *pSource = (const uint8_t*)image.GetBuffer();
+	size_t sourceSize = image.GetImageSize();
+	uint16_t *pPixels = (uint16_t*)pDestination;
+	uint32_t bitsPerPixel = Pylon::BitPerPixel(pixelType);
+	int numStripes = (int)std::min<uint32_t>((uint32_t)m_numStripes, std::max<uint32_t>(height / MIN_STRIPE_ROWS, 1));
+
+	std::function<void(int)> unpackStripe;
+	if (paddingX == 0)
+	{
+		// Without padding the image is one packed stream, which may even continue across lines (eg: Mono10p with an odd width).
+		// Split it where a pixel starts on a byte: every 4 pixels in all packed formats. 16 also keeps the SIMD steps whole.
+		size_t numPixels = (size_t)width * height;
+		size_t stripePixels = (numPixels + numStripes - 1) / numStripes;
+		stripePixels = (stripePixels + 15) & ~(size_t)15;
+
+		unpackStripe = [&](int stripe)
+		{
+			size_t first = stripe * stripePixels;
+			if (first >= numPixels)
+				return;
+			size_t sourceOffset = first * bitsPerPixel / 8;
+			CPixelKernels::UnpackTo16(pSource + sourceOffset, sourceSize - std::min(sourceSize, sourceOffset), pixelType, std::min(numPixels, first + stripePixels) - first, pPixels + first, alignMsb);
+		};
+	}
+	else
+	{
+		// padded lines each start on a byte
+		size_t sourceLineSize = ((size_t)width * bitsPerPixel + 7) / 8 + paddingX;
+		uint32_t stripeRows = (height + numStripes - 1) / numStripes;
+
+		unpackStripe = [&](int stripe)
+		{
+			uint32_t first = stripe * stripeRows;
+			uint32_t last = std::min(height, first + stripeRows);
+			for (uint32_t row = first; row < last; row++)
+			{
+				size_t sourceOffset = row * sourceLineSize;
+				CPixelKernels::UnpackTo16(pSource + sourceOffset, sourceSize - std::min(sourceSize, sourceOffset), pixelType, width, pPixels + (size_t)row * width, alignMsb);
+			}
+		};
+	}
+
+	if (m_pWorkerPool != NULL && numStripes > 1)
+		m_pWorkerPool->Run(numStripes, unpackStripe);
+	else
+		for (int stripe = 0; stripe < numStripes; stripe++)
+			unpackStripe(stripe);
+
+	return true;
+}
+
+void CStripedConverter::create_converters(int numConverters)
+{
+	destroy_converters();
+
+	for (int i = 0; i < numConverters; i++)
+	{
+		Pylon::CImageFormatConverter *pConverter = new Pylon::CImageFormatConverter();
+		pConverter->OutputPixelFormat.SetValue(m_outputPixelType);
+		pConverter->MaxNumThreads.SetValue(1); // the stripes are our threads
+		m_converters.push_back(pConverter);
+	}
+	m_haloBuffers.resize(numConverters);
+}
+
+void CStripedConverter::destroy_converters()
+{
+	for (size_t i = 0; i < m_converters.size(); i++)
+		delete m_converters[i];
+	m_converters.clear();
+	m_haloBuffers.clear();
+}
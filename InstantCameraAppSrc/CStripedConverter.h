@@ -0,0 +1,60 @@
+/*  CStripedConverter.h: header file for CStripedConverter Class.
+    Converts pixel formats in row stripes, in parallel on a CWorkerPool.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#pragma once
+
+#include <pylon/PylonIncludes.h>
+#include <vector>
+#include "CWorkerPool.h"
+#include "CPixelKernels.h"
+
+// ******* CStripedConverter *******
+// Works like a Pylon::CImageFormatConverter, but splits each image into horizontal stripes that are converted at the same time.
+// Demosaicing needs the rows above and below, so Bayer stripes are converted with a few extra "halo" rows that are then thrown away.
+// Each stripe has its own Pylon converter, since a converter can only convert one image at a time.
+class CStripedConverter
+{
+public:
+	CStripedConverter(CWorkerPool *pWorkerPool = NULL);
+	~CStripedConverter();
+
+	void SetWorkerPool(CWorkerPool *pWorkerPool);
+	void SetOutputPixelFormat(Pylon::EPixelType pixelType);
+	Pylon::EPixelType GetOutputPixelFormat();
+	void SetNumStripes(int numStripes);
+	int GetNumStripes();
+	bool ImageHasDestinationFormat(const Pylon::IImage &image);
+	void Convert(void *pDestination, size_t destinationSize, const Pylon::IImage &image);
+	void Convert(void *pDestination, size_t destinationSize, const void *pSource, size_t sourceSize, Pylon::EPixelType sourcePixelType, uint32_t width, uint32_t height, size_t paddingX);
+	bool ConvertBayerToYuv420(void *pDestination, size_t destinationSize, const Pylon::IImage &image, bool isNV12);
+	bool UnpackTo16(void *pDestination, size_t destinationSize, const Pylon::IImage &image, bool alignMsb);
+
+private:
+	CWorkerPool *m_pWorkerPool;
+	Pylon::EPixelType m_outputPixelType;
+	int m_numStripes;
+	std::vector<Pylon::CImageFormatConverter*> m_converters; // one per stripe
+	std::vector< std::vector<uint8_t> > m_haloBuffers;       // one per stripe, for the output of stripes with halo rows
+
+	void create_converters(int numConverters);
+	void destroy_converters();
+};
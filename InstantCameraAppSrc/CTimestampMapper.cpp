@@ -0,0 +1,149 @@
+/*  CTimestampMapper.cpp: Definition file for CTimestampMapper Class.
+    Maps camera timestamps (device clock ticks) onto the host's pipeline clock.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#include "CTimestampMapper.h"
+
+// numIntervals: how many intervals the fit looks back over.
+// intervalLength: of all observations within one interval, only the least-delayed is kept for the fit.
+CTimestampMapper::CTimestampMapper(int numIntervals, GstClockTime intervalLength)
+{
+	m_numIntervals = (numIntervals < 2) ? 2 : numIntervals;
+	m_intervalLength = intervalLength;
+	Reset(1e9);
+}
+
+// Forget all observations. tickFrequency is the camera's timestamp clock in ticks per second (eg: 125 MHz for GigE, 1 GHz for usb).
+void CTimestampMapper::Reset(double tickFrequency)
+{
+	m_tickFrequency = (tickFrequency > 0) ? tickFrequency : 1e9;
+	m_hasOrigin = false;
+	m_cameraOrigin = 0;
+	m_hostOrigin = 0;
+	m_lastCameraTicks = 0;
+	m_intervals.clear();
+	m_current.cameraTime = 0;
+	m_current.hostTime = 0;
+	m_currentStart = 0;
+	m_slope = 1.0;
+	m_offset = 0;
+}
+
+// Add the camera timestamp of an image and the host time it was received.
+void CTimestampMapper::AddObservation(guint64 cameraTicks, GstClockTime hostTime)
+{
+	// start over on the first image, or if the camera's clock was reset (eg: camera reboot, timestamp latch/reset command)
+	if (m_hasOrigin == false || cameraTicks < m_lastCameraTicks)
+	{
+		Reset(m_tickFrequency);
+		m_cameraOrigin = cameraTicks;
+		m_hostOrigin = hostTime;
+		m_hasOrigin = true;
+	}
+	m_lastCameraTicks = cameraTicks;
+
+	SObservation observation;
+	observation.cameraTime = to_camera_time(cameraTicks);
+	observation.hostTime = (double)(gint64)(hostTime - m_hostOrigin);
+
+	if (observation.cameraTime - m_currentStart >= (double)m_intervalLength)
+	{
+		// the current interval is over. Keep its least-delayed observation and start a new interval.
+		m_intervals.push_back(m_current);
+		if (m_intervals.size() > m_numIntervals)
+			m_intervals.pop_front();
+		m_current = observation;
+		m_currentStart = observation.cameraTime;
+	}
+	else if (observation.hostTime - m_slope * observation.cameraTime < m_current.hostTime - m_slope * m_current.cameraTime)
+	{
+		m_current = observation;
+	}
+
+	update_mapping();
+}
+
+// Map a camera timestamp onto the host clock. Returns GST_CLOCK_TIME_NONE until there is an observation.
+GstClockTime CTimestampMapper::ToHostTime(guint64 cameraTicks)
+{
+	if (m_hasOrigin == false)
+		return GST_CLOCK_TIME_NONE;
+
+	double hostTime = (double)m_hostOrigin + m_offset + m_slope * to_camera_time(cameraTicks);
+	if (hostTime < 0)
+		return 0;
+
+	return (GstClockTime)hostTime;
+}
+
+// How much faster (positive) or slower (negative) the host clock runs compared to the camera clock, in parts per million
+double CTimestampMapper::GetDrift()
+{
+	return (m_slope - 1.0) * 1e6;
+}
+
+double CTimestampMapper::to_camera_time(guint64 cameraTicks)
+{
+	return (double)(gint64)(cameraTicks - m_cameraOrigin) * 1e9 / m_tickFrequency;
+}
+
+// Fit the line (slope = drift, offset = least delay) through the least-delayed observations
+void CTimestampMapper::update_mapping()
+{
+	size_t numPoints = m_intervals.size() + 1;
+	double first = (m_intervals.empty() == true) ? m_current.cameraTime : m_intervals.front().cameraTime;
+
+	// only estimate drift over at least a second. Before that, the jitter of the host is larger than the drift we are looking for.
+	if (numPoints >= 2 && m_current.cameraTime - first >= 1e9)
+	{
+		double meanCamera = m_current.cameraTime;
+		double meanHost = m_current.hostTime;
+		for (size_t i = 0; i < m_intervals.size(); i++)
+		{
+			meanCamera += m_intervals[i].cameraTime;
+			meanHost += m_intervals[i].hostTime;
+		}
+		meanCamera /= numPoints;
+		meanHost /= numPoints;
+
+		double covariance = (m_current.cameraTime - meanCamera) * (m_current.hostTime - meanHost);
+		double variance = (m_current.cameraTime - meanCamera) * (m_current.cameraTime - meanCamera);
+		for (size_t i = 0; i < m_intervals.size(); i++)
+		{
+			covariance += (m_intervals[i].cameraTime - meanCamera) * (m_intervals[i].hostTime - meanHost);
+			variance += (m_intervals[i].cameraTime - meanCamera) * (m_intervals[i].cameraTime - meanCamera);
+		}
+
+		// real clocks drift by some tens of ppm. Anything beyond 1000 ppm is a bad fit, keep the previous estimate.
+		double slope = (variance > 0) ? covariance / variance : 1.0;
+		if (slope > 0.999 && slope < 1.001)
+			m_slope = slope;
+	}
+
+	// shift the line down onto the least-delayed observation
+	m_offset = m_current.hostTime - m_slope * m_current.cameraTime;
+	for (size_t i = 0; i < m_intervals.size(); i++)
+	{
+		double offset = m_intervals[i].hostTime - m_slope * m_intervals[i].cameraTime;
+		if (offset < m_offset)
+			m_offset = offset;
+	}
+}
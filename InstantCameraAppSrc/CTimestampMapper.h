@@ -0,0 +1,65 @@
+/*  CTimestampMapper.h: header file for CTimestampMapper Class.
+    Maps camera timestamps (device clock ticks) onto the host's pipeline clock.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#pragma once
+
+#include <gst/gst.h>
+#include <deque>
+
+// ******* CTimestampMapper *******
+// Each image gives us an observation: the camera's timestamp of the image, and the host clock time when we received it.
+// The host time is always late by some transfer and scheduling delay, which varies from image to image.
+// We keep the least-delayed observation of each interval, fit a line through those (the slope compensates drift between the two clocks),
+// and shift the line down onto the least-delayed observation. Camera time then maps to host time without the jitter of the host.
+class CTimestampMapper
+{
+public:
+	CTimestampMapper(int numIntervals = 32, GstClockTime intervalLength = GST_SECOND);
+
+	void Reset(double tickFrequency);
+	void AddObservation(guint64 cameraTicks, GstClockTime hostTime);
+	GstClockTime ToHostTime(guint64 cameraTicks);
+	double GetDrift();
+
+private:
+	struct SObservation
+	{
+		double cameraTime; // ns since the first observation
+		double hostTime;   // ns since the first observation
+	};
+
+	size_t m_numIntervals;
+	GstClockTime m_intervalLength;
+	double m_tickFrequency;
+	bool m_hasOrigin;
+	guint64 m_cameraOrigin;
+	GstClockTime m_hostOrigin;
+	guint64 m_lastCameraTicks;
+	std::deque<SObservation> m_intervals; // the least-delayed observation of each finished interval
+	SObservation m_current;               // the least-delayed observation of the current interval
+	double m_currentStart;
+	double m_slope;
+	double m_offset;
+
+	double to_camera_time(guint64 cameraTicks);
+	void update_mapping();
+};
@@ -0,0 +1,151 @@
+/*  CWorkerPool.cpp: Definition file for CWorkerPool Class.
+    A pool of persistent worker threads that split per-frame work between cores.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#include "CWorkerPool.h"
+
+// numThreads: how many worker threads to start, besides the thread calling Run(). -1 = one less than the number of cores.
+CWorkerPool::CWorkerPool(int numThreads)
+{
+	if (numThreads < 0)
+		numThreads = (int)std::thread::hardware_concurrency() - 1;
+
+	m_task = NULL;
+	m_numTasks = 0;
+	m_nextTask = 0;
+	m_numTasksDone = 0;
+	m_numActiveWorkers = 0;
+	m_generation = 0;
+	m_isStopping = false;
+
+	for (int i = 0; i < numThreads; i++)
+		m_threads.push_back(std::thread(&CWorkerPool::worker_loop, this));
+}
+
+CWorkerPool::~CWorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isStopping = true;
+	}
+	m_wake.notify_all();
+
+	for (size_t i = 0; i < m_threads.size(); i++)
+		m_threads[i].join();
+}
+
+// The number of threads working on a Run(), including the calling thread.
+int CWorkerPool::GetNumThreads()
+{
+	return (int)m_threads.size() + 1;
+}
+
+// Run task(0) ... task(numTasks - 1) on the pool and wait until all are done.
+void CWorkerPool::Run(int numTasks, const std::function<void(int)> &task)
+{
+	if (numTasks <= 0)
+		return;
+
+	// nothing to share
+	if (numTasks == 1 || m_threads.empty() == true)
+	{
+		for (int i = 0; i < numTasks; i++)
+			task(i);
+		return;
+	}
+
+	std::lock_guard<std::mutex> runLock(m_runMutex);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &task;
+		m_numTasks = numTasks;
+		m_nextTask = 0;
+		m_numTasksDone = 0;
+		m_exception = NULL;
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	// the calling thread works too, instead of only waiting
+	work();
+
+	// Wait until all tasks are done, and all workers have left work(), so none of them touches this task after we return.
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this] { return m_numTasksDone == m_numTasks && m_numActiveWorkers == 0; });
+	m_task = NULL;
+
+	// hand a task's exception to the caller, instead of letting it end the worker thread (and the application)
+	std::exception_ptr exception = m_exception;
+	m_exception = NULL;
+	lock.unlock();
+	if (exception != NULL)
+		std::rethrow_exception(exception);
+}
+
+void CWorkerPool::worker_loop()
+{
+	unsigned int generation = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this, generation] { return m_isStopping == true || m_generation != generation; });
+			if (m_isStopping == true)
+				return;
+			generation = m_generation;
+
+			// too late, the Run() is already over
+			if (m_task == NULL)
+				continue;
+			m_numActiveWorkers++;
+		}
+
+		work();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_numActiveWorkers--;
+		}
+		m_done.notify_all();
+	}
+}
+
+// take tasks until there are none left
+void CWorkerPool::work()
+{
+	int task;
+	while ((task = m_nextTask.fetch_add(1)) < m_numTasks)
+	{
+		try
+		{
+			(*m_task)(task);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_exception == NULL)
+				m_exception = std::current_exception();
+		}
+		m_numTasksDone++;
+	}
+}
@@ -0,0 +1,64 @@
+/*  CWorkerPool.h: header file for CWorkerPool Class.
+    A pool of persistent worker threads that split per-frame work between cores.
+
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ******* CWorkerPool *******
+// Run() hands out numTasks tasks to the worker threads and the calling thread, and returns when all of them are done.
+// The threads live as long as the pool, so there is no thread start-up cost per frame.
+// Run() may be called from several threads (eg: several cameras sharing one pool). The calls then take turns.
+// If tasks throw, the other tasks still run, and Run() rethrows the first exception on the calling thread.
+class CWorkerPool
+{
+public:
+	CWorkerPool(int numThreads = -1);
+	~CWorkerPool();
+
+	int GetNumThreads();
+	void Run(int numTasks, const std::function<void(int)> &task);
+
+private:
+	std::vector<std::thread> m_threads;
+	std::mutex m_runMutex; // one Run() at a time
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	const std::function<void(int)> *m_task;
+	int m_numTasks;
+	std::atomic<int> m_nextTask;
+	std::atomic<int> m_numTasksDone;
+	int m_numActiveWorkers;
+	unsigned int m_generation;
+	bool m_isStopping;
+	std::exception_ptr m_exception; // the first exception a task of this Run() threw
+
+	void worker_loop();
+	void work();
+};
@@ -0,0 +1,488 @@
+/*  benchmark.cpp: Measures the host-side image processing of the InstantCameraAppSrc class without a camera.
+	
+	Copyright 2019 Matthew Breit <matt.breit@gmail.com>
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+	THIS SOFTWARE REQUIRES ADDITIONAL SOFTWARE (IE: LIBRARIES) IN ORDER TO COMPILE
+	INTO BINARY FORM AND TO FUNCTION IN BINARY FORM. ANY SUCH ADDITIONAL SOFTWARE
+	IS OUTSIDE THE SCOPE OF THIS LICENSE.
+	
+
+	Benchmark:
+	Feeds synthetic images through the same processing the InstantCameraAppSrc does on each grabbed image, and reports frames per second.
+
+	Usage:
+	benchmark -options
+
+	Options:
+	-size <width> <height> (Image size. Default is 5472 x 3648, a 20 MP sensor.)
+	-frames <n> (Number of images to process per measurement. Default is 100.)
+	-conversion (BayerRG8 to RGB8 color conversion, once per stripe count from 1 to the number of cores.)
+	-demosaic (BayerRG8 to I420 and NV12 with our own kernels, once per instruction set, on one stripe and on one per core.)
+	-unpack (Mono10p, Mono12p, Mono10packed and Mono12packed to 16-bit, once per instruction set.)
+	-transform <width> <height> <degrees clockwise> (BayerRG8 to I420, rescaled and rotated: through the videoscale/videoflip source bin, and with CScaleRotate.
+	            Measured at 5 MP and 20 MP, or at -size if given.)
+
+	Examples:
+	benchmark -conversion
+	benchmark -size 2448 2048 -frames 500 -conversion
+	benchmark -conversion -demosaic
+	benchmark -size 4096 3000 -unpack
+	benchmark -transform 1920 1080 90
+*/
+
+
+#include "../../InstantCameraAppSrc/CStripedConverter.h"
+#include "../../InstantCameraAppSrc/CWorkerPool.h"
+#include "../../InstantCameraAppSrc/CPixelKernels.h"
+#include "../../InstantCameraAppSrc/CScaleRotate.h"
+#include <gst/gst.h>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+int exitCode = 0;
+
+// *********** Command line argument variables and parser **************
+int width = 5472;
+int height = 3648;
+int numFrames = 100;
+bool conversion = false;
+bool demosaic = false;
+bool unpack = false;
+bool transform = false;
+bool sizeGiven = false;
+int scaledWidth = 1920;
+int scaledHeight = 1080;
+int rotation = 0;
+
+int ParseCommandLine(int argc, char *argv[])
+{
+	try
+	{
+		if (argc < 2)
+		{
+			cout << endl;
+			cout << "Benchmark: " << endl;
+			cout << " Feeds synthetic images through the same processing the InstantCameraAppSrc does on each grabbed image, and reports frames per second." << endl;
+			cout << endl;
+			cout << "Usage:" << endl;
+			cout << " benchmark -options" << endl;
+			cout << endl;
+			cout << "Options: " << endl;
+			cout << " -size <width> <height> (Image size. Default is 5472 x 3648, a 20 MP sensor.)" << endl;
+			cout << " -frames <n> (Number of images to process per measurement. Default is 100.)" << endl;
+			cout << " -conversion (BayerRG8 to RGB8 color conversion, once per stripe count from 1 to the number of cores.)" << endl;
+			cout << " -demosaic (BayerRG8 to I420 and NV12 with our own kernels, once per instruction set, on one stripe and on one per core.)" << endl;
+			cout << " -unpack (Mono10p, Mono12p, Mono10packed and Mono12packed to 16-bit, once per instruction set.)" << endl;
+			cout << " -transform <width> <height> <degrees clockwise> (BayerRG8 to I420, rescaled and rotated: through the videoscale/videoflip source bin, and with CScaleRotate." << endl;
+			cout << "             Measured at 5 MP and 20 MP, or at -size if given.)" << endl;
+			cout << endl;
+			cout << "Examples: " << endl;
+			cout << " benchmark -conversion" << endl;
+			cout << " benchmark -size 2448 2048 -frames 500 -conversion" << endl;
+			cout << " benchmark -conversion -demosaic" << endl;
+			cout << " benchmark -size 4096 3000 -unpack" << endl;
+			cout << " benchmark -transform 1920 1080 90" << endl;
+			cout << endl;
+
+			return -1;
+		}
+
+		for (int i = 1; i < argc; i++)
+		{
+			if (string(argv[i]) == "-size")
+			{
+				if (argv[i + 1] != NULL && argv[i + 2] != NULL)
+				{
+					width = atoi(argv[i + 1]);
+					height = atoi(argv[i + 2]);
+					sizeGiven = true;
+				}
+				else
+				{
+					cout << "Size not specified. eg: -size 2448 2048" << endl;
+					return -1;
+				}
+			}
+			else if (string(argv[i]) == "-frames")
+			{
+				if (argv[i + 1] != NULL)
+					numFrames = atoi(argv[i + 1]);
+				else
+				{
+					cout << "Number of frames not specified. eg: -frames 100" << endl;
+					return -1;
+				}
+			}
+			else if (string(argv[i]) == "-conversion")
+			{
+				conversion = true;
+			}
+			else if (string(argv[i]) == "-demosaic")
+			{
+				demosaic = true;
+			}
+			else if (string(argv[i]) == "-unpack")
+			{
+				unpack = true;
+			}
+			else if (string(argv[i]) == "-transform")
+			{
+				if (argv[i + 1] != NULL && argv[i + 2] != NULL && argv[i + 3] != NULL)
+				{
+					transform = true;
+					scaledWidth = atoi(argv[i + 1]);
+					scaledHeight = atoi(argv[i + 2]);
+					rotation = atoi(argv[i + 3]);
+				}
+				else
+				{
+					cout << "Transform not specified. eg: -transform 1920 1080 90" << endl;
+					return -1;
+				}
+			}
+		}
+
+		if (width < 2 || height < 2 || numFrames < 1)
+		{
+			cout << "Size must be at least 2x2 and frames at least 1." << endl;
+			return -1;
+		}
+		if ((demosaic == true || transform == true) && (width % 2 != 0 || height % 2 != 0))
+		{
+			cout << "Width and height must be even for -demosaic and -transform." << endl;
+			return -1;
+		}
+		if (transform == true && (scaledWidth < 2 || scaledHeight < 2 || (rotation != 0 && rotation != 90 && rotation != 180 && rotation != 270)))
+		{
+			cout << "Transform size must be at least 2x2 and rotation 0, 90, 180 or 270." << endl;
+			return -1;
+		}
+
+		return 0;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in ParseCommandLine(): " << endl << e.what() << endl;
+		return -1;
+	}
+}
+
+// *********** END Command line argument variables and parser **************
+
+// an image of random pixels, so no kernel can take shortcuts on uniform data
+vector<uint8_t> MakeImage(size_t size)
+{
+	vector<uint8_t> image(size);
+	mt19937 generator(42);
+	for (size_t i = 0; i < size; i++)
+		image[i] = (uint8_t)generator();
+	return image;
+}
+
+// BayerRG8 -> RGB8 with the CStripedConverter, for each number of stripes from 1 to the number of cores
+void BenchmarkConversion()
+{
+	vector<uint8_t> source = MakeImage((size_t)width * height);
+	vector<uint8_t> destination((size_t)width * height * 3);
+
+	int numCores = max((int)thread::hardware_concurrency(), 1);
+	double singleStripeFps = 0;
+
+	cout << "BayerRG8 -> RGB8, " << width << " x " << height << ", " << numFrames << " frames" << endl;
+	cout << " stripes      fps  speedup" << endl;
+
+	for (int numStripes = 1; numStripes <= numCores; numStripes++)
+	{
+		CWorkerPool workerPool(numStripes - 1);
+		CStripedConverter converter(&workerPool);
+		converter.SetOutputPixelFormat(Pylon::PixelType_RGB8packed);
+		converter.SetNumStripes(numStripes);
+
+		// warm up caches and worker threads
+		converter.Convert(destination.data(), destination.size(), source.data(), source.size(), Pylon::PixelType_BayerRG8, width, height, 0);
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (int frame = 0; frame < numFrames; frame++)
+			converter.Convert(destination.data(), destination.size(), source.data(), source.size(), Pylon::PixelType_BayerRG8, width, height, 0);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		double fps = numFrames / seconds;
+		if (numStripes == 1)
+			singleStripeFps = fps;
+
+		cout << setw(8) << numStripes << setw(9) << fixed << setprecision(1) << fps << setw(8) << setprecision(2) << fps / singleStripeFps << "x" << endl;
+	}
+	cout << endl;
+}
+
+// BayerRG8 -> I420 and NV12 with CPixelKernels (through the CStripedConverter), for each instruction set the CPU supports
+void BenchmarkDemosaic()
+{
+	vector<uint8_t> source = MakeImage((size_t)width * height);
+	vector<uint8_t> destination(CPixelKernels::GetYuv420Layout(width, height, false).size);
+	Pylon::CPylonImage image;
+	image.AttachUserBuffer(source.data(), source.size(), Pylon::PixelType_BayerRG8, width, height, 0);
+
+	int numCores = max((int)thread::hardware_concurrency(), 1);
+	CWorkerPool workerPool(numCores - 1);
+	CStripedConverter converter(&workerPool);
+
+	cout << "BayerRG8 -> YUV 4:2:0, " << width << " x " << height << ", " << numFrames << " frames" << endl;
+	cout << " format instructions  stripes      fps" << endl;
+
+	for (int nv12 = 0; nv12 < 2; nv12++)
+	{
+		for (int set = CPixelKernels::InstructionSet_Scalar; set <= CPixelKernels::InstructionSet_AVX2; set++)
+		{
+			CPixelKernels::SetMaxInstructionSet((CPixelKernels::EInstructionSet)set);
+			if (CPixelKernels::GetInstructionSet() != set)
+				continue; // not supported by this cpu
+
+			int stripeCounts[2] = { 1, numCores };
+			for (int i = 0; i < ((numCores > 1) ? 2 : 1); i++)
+			{
+				converter.SetNumStripes(stripeCounts[i]);
+
+				// warm up caches and worker threads
+				converter.ConvertBayerToYuv420(destination.data(), destination.size(), image, nv12 == 1);
+
+				chrono::steady_clock::time_point start = chrono::steady_clock::now();
+				for (int frame = 0; frame < numFrames; frame++)
+					converter.ConvertBayerToYuv420(destination.data(), destination.size(), image, nv12 == 1);
+				double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+				cout << setw(7) << ((nv12 == 1) ? "NV12" : "I420") << setw(13) << CPixelKernels::GetInstructionSetName((CPixelKernels::EInstructionSet)set)
+					<< setw(9) << stripeCounts[i] << setw(9) << fixed << setprecision(1) << numFrames / seconds << endl;
+			}
+		}
+	}
+	CPixelKernels::SetMaxInstructionSet(CPixelKernels::InstructionSet_AVX2);
+	cout << endl;
+}
+
+// Packed 10 and 12-bit mono -> 16-bit with CPixelKernels, on one thread, for each instruction set the CPU supports
+void BenchmarkUnpack()
+{
+	Pylon::EPixelType pixelTypes[4] = { Pylon::PixelType_Mono10p, Pylon::PixelType_Mono12p, Pylon::PixelType_Mono10packed, Pylon::PixelType_Mono12packed };
+	const char *names[4] = { "Mono10p", "Mono12p", "Mono10packed", "Mono12packed" };
+	size_t numPixels = (size_t)width * height;
+	vector<uint16_t> destination(numPixels);
+
+	cout << "Packed mono -> 16-bit, " << width << " x " << height << ", " << numFrames << " frames" << endl;
+	cout << "       format instructions      fps" << endl;
+
+	for (int type = 0; type < 4; type++)
+	{
+		vector<uint8_t> source = MakeImage((numPixels * Pylon::BitPerPixel(pixelTypes[type]) + 7) / 8);
+
+		for (int set = CPixelKernels::InstructionSet_Scalar; set <= CPixelKernels::InstructionSet_AVX2; set++)
+		{
+			CPixelKernels::SetMaxInstructionSet((CPixelKernels::EInstructionSet)set);
+			if (CPixelKernels::GetInstructionSet() != set)
+				continue; // not supported by this cpu
+
+			CPixelKernels::UnpackTo16(source.data(), source.size(), pixelTypes[type], numPixels, destination.data(), false);
+
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			for (int frame = 0; frame < numFrames; frame++)
+				CPixelKernels::UnpackTo16(source.data(), source.size(), pixelTypes[type], numPixels, destination.data(), false);
+			double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+			cout << setw(13) << names[type] << setw(13) << CPixelKernels::GetInstructionSetName((CPixelKernels::EInstructionSet)set)
+				<< setw(9) << fixed << setprecision(1) << numFrames / seconds << endl;
+		}
+	}
+	CPixelKernels::SetMaxInstructionSet(CPixelKernels::InstructionSet_AVX2);
+	cout << endl;
+}
+
+// The source bin as GetSource() builds it without the host transform: videoconvert ! videoscale ! capsfilter ! videoflip ! videoconvert ! capsfilter.
+// Returns the frames per second from a Bayer image to a rescaled and rotated I420 image at the end of the bin.
+double MeasureSourceBin(Pylon::CPylonImage &image, CStripedConverter &converter, int sourceWidth, int sourceHeight)
+{
+	const char *flipMethods[4] = { "none", "clockwise", "rotate-180", "counterclockwise" };
+	ostringstream description;
+	description << "appsrc name=source format=time caps=video/x-raw,format=I420,width=" << sourceWidth << ",height=" << sourceHeight << ",framerate=30/1"
+		<< " ! videoconvert ! videoscale ! video/x-raw,format=I420,width=" << scaledWidth << ",height=" << scaledHeight
+		<< " ! videoflip method=" << flipMethods[rotation / 90] << " ! videoconvert ! video/x-raw,format=I420 ! appsink name=sink sync=false";
+
+	GError *error = NULL;
+	GstElement *pipeline = gst_parse_launch(description.str().c_str(), &error);
+	if (pipeline == NULL)
+	{
+		cerr << "Could not create the source bin: " << ((error != NULL) ? error->message : "") << endl;
+		if (error != NULL)
+			g_error_free(error);
+		return 0;
+	}
+	GstElement *source = gst_bin_get_by_name(GST_BIN(pipeline), "source");
+	GstElement *sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+	gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+	size_t frameSize = CPixelKernels::GetYuv420Layout(sourceWidth, sourceHeight, false).size;
+	double seconds = 0;
+
+	// one frame in flight at a time, like the pull-mode source: convert, push, and wait for it to come out of the bin. The first frame warms up.
+	for (int frame = 0; frame <= numFrames; frame++)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+		GstBuffer *buffer = gst_buffer_new_allocate(NULL, frameSize, NULL);
+		GstMapInfo map;
+		gst_buffer_map(buffer, &map, GST_MAP_WRITE);
+		converter.ConvertBayerToYuv420(map.data, map.size, image, false);
+		gst_buffer_unmap(buffer, &map);
+		GST_BUFFER_PTS(buffer) = gst_util_uint64_scale_int(frame, GST_SECOND, 30);
+
+		GstFlowReturn ret;
+		g_signal_emit_by_name(source, "push-buffer", buffer, &ret);
+		gst_buffer_unref(buffer);
+
+		GstSample *sample = NULL;
+		g_signal_emit_by_name(sink, "pull-sample", &sample);
+		if (sample == NULL)
+		{
+			cerr << "The source bin stopped." << endl;
+			break;
+		}
+		gst_sample_unref(sample);
+
+		if (frame > 0)
+			seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}
+
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(source);
+	gst_object_unref(sink);
+	gst_object_unref(pipeline);
+
+	return (seconds > 0) ? numFrames / seconds : 0;
+}
+
+// The host transform, as the InstantCameraAppSrc does it: demosaic to I420 at full size, then rescale and rotate each plane with CScaleRotate
+double MeasureHostTransform(Pylon::CPylonImage &image, CStripedConverter &converter, CWorkerPool &workerPool, int numStripes, int sourceWidth, int sourceHeight)
+{
+	CScaleRotate luma(&workerPool);
+	CScaleRotate chroma(&workerPool);
+	luma.SetNumStripes(numStripes);
+	chroma.SetNumStripes(numStripes);
+	luma.Configure(sourceWidth, sourceHeight, scaledWidth, scaledHeight, rotation);
+	chroma.Configure(sourceWidth / 2, sourceHeight / 2, (scaledWidth + 1) / 2, (scaledHeight + 1) / 2, rotation);
+
+	CPixelKernels::SYuvLayout sourceLayout = CPixelKernels::GetYuv420Layout(sourceWidth, sourceHeight, false);
+	CPixelKernels::SYuvLayout destinationLayout = CPixelKernels::GetYuv420Layout(luma.GetOutputWidth(), luma.GetOutputHeight(), false);
+	vector<uint8_t> converted(sourceLayout.size);
+	vector<uint8_t> destination(destinationLayout.size);
+	double seconds = 0;
+
+	for (int frame = 0; frame <= numFrames; frame++)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+		converter.ConvertBayerToYuv420(converted.data(), converted.size(), image, false);
+		for (int plane = 0; plane < 3; plane++)
+		{
+			CScaleRotate &planeTransform = (plane == 0) ? luma : chroma;
+			planeTransform.Transform(converted.data() + sourceLayout.offset[plane], sourceLayout.stride[plane], destination.data() + destinationLayout.offset[plane], destinationLayout.stride[plane]);
+		}
+
+		if (frame > 0)
+			seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}
+
+	return numFrames / seconds;
+}
+
+// BayerRG8 -> rescaled and rotated I420, through the source bin's elements and with the host transform, at 5 MP and 20 MP (or -size)
+void BenchmarkTransform()
+{
+	vector< pair<int, int> > sizes;
+	if (sizeGiven == true)
+		sizes.push_back(make_pair(width, height));
+	else
+	{
+		sizes.push_back(make_pair(2592, 1944)); // 5 MP
+		sizes.push_back(make_pair(5472, 3648)); // 20 MP
+	}
+
+	int numCores = max((int)thread::hardware_concurrency(), 1);
+	CWorkerPool workerPool(numCores - 1);
+	CStripedConverter converter(&workerPool);
+	converter.SetNumStripes(numCores);
+
+	cout << "BayerRG8 -> I420 -> " << scaledWidth << " x " << scaledHeight << ", rotated " << rotation << " degrees, " << numFrames << " frames" << endl;
+	cout << "        size    source bin fps   host fps (" << numCores << " stripes)  speedup" << endl;
+
+	for (size_t i = 0; i < sizes.size(); i++)
+	{
+		vector<uint8_t> source = MakeImage((size_t)sizes[i].first * sizes[i].second);
+		Pylon::CPylonImage image;
+		image.AttachUserBuffer(source.data(), source.size(), Pylon::PixelType_BayerRG8, sizes[i].first, sizes[i].second, 0);
+
+		double binFps = MeasureSourceBin(image, converter, sizes[i].first, sizes[i].second);
+		double hostFps = MeasureHostTransform(image, converter, workerPool, numCores, sizes[i].first, sizes[i].second);
+
+		ostringstream size;
+		size << sizes[i].first << " x " << sizes[i].second;
+		cout << setw(12) << size.str() << setw(18) << fixed << setprecision(1) << binFps << setw(26) << hostFps
+			<< setw(8) << setprecision(2) << ((binFps > 0) ? hostFps / binFps : 0) << "x" << endl;
+	}
+	cout << endl;
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		if (ParseCommandLine(argc, argv) == -1)
+		{
+			exitCode = -1;
+			return exitCode;
+		}
+
+		// the image format converter needs the pylon runtime, and the source bin GStreamer
+		Pylon::PylonAutoInitTerm autoInitTerm;
+		gst_init(&argc, &argv);
+
+		if (conversion == true)
+			BenchmarkConversion();
+		if (demosaic == true)
+			BenchmarkDemosaic();
+		if (unpack == true)
+			BenchmarkUnpack();
+		if (transform == true)
+			BenchmarkTransform();
+
+		exitCode = 0;
+	}
+	catch (GenICam::GenericException &e)
+	{
+		cerr << "An exception occured in main(): " << endl << e.GetDescription() << endl;
+		exitCode = -1;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in main(): " << endl << e.what() << endl;
+		exitCode = -1;
+	}
+
+	return exitCode;
+}
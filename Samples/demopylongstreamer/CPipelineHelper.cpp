@@ -46,6 +46,7 @@ CPipelineHelper::CPipelineHelper(GstElement *pipeline, GstElement *source)
 	m_pipelineBuilt = false;
 	m_pipeline = pipeline;
 	m_source = source;
+	m_sink = NULL;
 }
 
 CPipelineHelper::~CPipelineHelper()
@@ -95,6 +96,7 @@ bool CPipelineHelper::build_pipeline_display()
 		
 		cout << "Pipeline Made." << endl;
 		
+		m_sink = sink;
 		m_pipelineBuilt = true;
 
 		return true;
@@ -137,6 +139,7 @@ bool CPipelineHelper::build_pipeline_framebuffer(string fbDevice)
 		
 		cout << "Pipeline Made." << endl;
 
+		m_sink = sink;
 		m_pipelineBuilt = true;
 		
 		return true;
@@ -240,6 +243,7 @@ bool CPipelineHelper::build_pipeline_h264stream(string ipAddress)
 
 		cout << "Pipeline Made." << endl;
 
+		m_sink = sink;
 		m_pipelineBuilt = true;
 		
 		return true;
@@ -344,6 +348,7 @@ bool CPipelineHelper::build_pipeline_h264multicast(string ipAddress)
 
 		cout << "Pipeline Made." << endl;
 
+		m_sink = sink;
 		m_pipelineBuilt = true;
 
 		return true;
@@ -417,6 +422,7 @@ bool CPipelineHelper::build_pipeline_h264file(string fileName)
 		
 		cout << "Pipeline Made." << endl;
 		
+		m_sink = sink;
 		m_pipelineBuilt = true;
 
 		return true;
@@ -459,6 +465,16 @@ bool CPipelineHelper::build_pipeline_parsestring(string pipelineString)
 
 		cout << "Pipeline Made." << endl;
 
+		// remember the first sink of the user's pipeline, for trace_latency()
+		GstIterator *sinks = gst_bin_iterate_sinks(GST_BIN(userPipeline));
+		GValue item = G_VALUE_INIT;
+		if (gst_iterator_next(sinks, &item) == GST_ITERATOR_OK)
+		{
+			m_sink = (GstElement*)g_value_get_object(&item);
+			g_value_unset(&item);
+		}
+		gst_iterator_free(sinks);
+
 		m_pipelineBuilt = true;
 
 		return true;
@@ -471,6 +487,65 @@ bool CPipelineHelper::build_pipeline_parsestring(string pipelineString)
 }
 
 
+// example of how to measure the latency of each image from the camera to the sink.
+// A pad probe on the sink reads the CFrameTraceMeta the camera attaches to each image (see CInstantCameraAppSrc::SetLatencyTracing()),
+// and prints the latency percentiles of each stage when the stream ends.
+bool CPipelineHelper::trace_latency()
+{
+	try
+	{
+		if (m_pipelineBuilt == false || m_sink == NULL)
+		{
+			cout << "Cannot trace latency. Build a pipeline with a sink first." << endl;
+			return false;
+		}
+
+		GstPad *sinkPad = gst_element_get_static_pad(m_sink, "sink");
+		if (sinkPad == NULL)
+		{
+			cout << "Cannot trace latency. The sink has no sink pad." << endl;
+			return false;
+		}
+
+		m_latencyTracer.Reset();
+		gst_pad_add_probe(sinkPad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM), cb_latency_probe, this, NULL);
+		gst_object_unref(sinkPad);
+
+		return true;
+	}
+	catch (std::exception &e)
+	{
+		cerr << "An exception occurred in trace_latency(): " << endl << e.what() << endl;
+		return false;
+	}
+}
+
+// Record the latencies of each image arriving at the sink, and print them at the end of the stream
+GstPadProbeReturn CPipelineHelper::cb_latency_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+	CPipelineHelper *pHelper = (CPipelineHelper*)data;
+
+	if ((info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) != 0)
+	{
+		if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_EOS)
+			pHelper->m_latencyTracer.Print();
+		return GST_PAD_PROBE_OK;
+	}
+
+	CFrameTraceMeta *pTrace = CFrameTraceMeta::Get(GST_PAD_PROBE_INFO_BUFFER(info));
+	if (pTrace == NULL)
+		return GST_PAD_PROBE_OK;
+
+	GstClock *clock = gst_element_get_clock(pHelper->m_pipeline);
+	if (clock == NULL)
+		return GST_PAD_PROBE_OK;
+	GstClockTime sinkTime = gst_clock_get_time(clock);
+	gst_object_unref(clock);
+
+	pHelper->m_latencyTracer.RecordFrame(pTrace, sinkTime);
+	return GST_PAD_PROBE_OK;
+}
+
 // ****************************************************************************
 // debugging functions
 
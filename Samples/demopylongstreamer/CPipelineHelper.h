@@ -23,6 +23,7 @@
 #include <gst/gst.h>
 #include <gst/app/gstappsrc.h>
 #include <string>
+#include "../../InstantCameraAppSrc/CLatencyTracer.h"
 
 using namespace std;
 
@@ -52,8 +53,14 @@ public:
 	// example of how to create a pipeline from a string that you would use with gst-launch-1.0
 	bool build_pipeline_parsestring(string pipelineString);
 
+	// example of how to measure the latency of each image from the camera to the sink, and print its percentiles when the stream ends
+	bool trace_latency();
+
 private:
 	bool m_pipelineBuilt;
 	GstElement *m_pipeline;
 	GstElement *m_source;
+	GstElement *m_sink;
+	CLatencyTracer m_latencyTracer;
+	static GstPadProbeReturn cb_latency_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
 };
@@ -39,11 +39,32 @@
 	Options:
 	-camera <serialnumber> (Use a specific camera. If not specified, will use first camera found.)
 	-aoi <width> <height> (Camera's Area Of Interest. If not specified, will use camera's maximum.)
+	-switchaoi <width> <height> <fps> (Will switch between the AOI above and this one every 5 seconds, without restarting the pipeline. eg: a high-speed ROI.)
+	-pan (Will move the AOI back and forth across the sensor, by posting camera-region messages on the pipeline's bus. Use with -aoi.)
 	-rescale <width> <height> (Will rescale the image for the pipeline if desired.)
 	-rotate <degrees clockwise> (Will rotate 90, 180, 270 degrees clockwise)
+	-flipx (Will mirror the image horizontally, before rotating it. The camera does it if it can.)
+	-flipy (Will mirror the image vertically, before rotating it. The camera does it if it can.)
+	-chunkdata (Will attach the camera's chunk data (frame counter, exposure time, gain, line status, CRC) to each image, and print it every 100 images.)
+	-metrics <file> (Will write the frame counts and stream grabber statistics to a Prometheus text file every second. eg: /var/lib/node_exporter/camera.prom)
+	-gstscale (Will rescale and rotate with videoscale and videoflip elements, instead of on the host right after conversion.)
+	-nobinning (Will grab full resolution and rescale on the host, instead of binning or decimating on the camera first.)
 	-framerate <fps> (If not specified, will use camera's maximum under current settings.)
 	-ondemand (Will software trigger the camera when needed instead of using continuous free run. May lower CPU load.)
 	-usetrigger (Will configure the camera to expect a hardware trigger on IO Line 1. eg: TTL signal.)
+	-zerocopy (Will push the driver's image buffers into the pipeline without copying them, when no conversion is needed.)
+	-gstmemory (Will let the driver grab directly into GStreamer memory, which is then pushed without copying when no conversion is needed.)
+	-stripes <n> (Will split color conversion into n stripes converted in parallel. Default is one per core.)
+	-nv12 (Bayer cameras output NV12 instead of I420. Suits hardware encoders.)
+	-rgbconvert (Bayer cameras are converted to RGB by Pylon, instead of straight to YUV.)
+	-msb (10 and 12-bit images are shifted into the upper bits of GRAY16_LE, so they show the full brightness range.)
+	-rawbayer (Bayer cameras output video/x-bayer, to be demosaiced downstream. Use with -parse, eg: -parse "bayer2rgb ! videoconvert ! autovideosink")
+	-pushmode <ring depth> (Will grab and push images from separate threads as they arrive, instead of when the pipeline asks for them.)
+	-lowlatency (Will keep as little buffering as possible between camera and pipeline, for live display.)
+	-tracelatency (Will measure the latency of each image from exposure to sink, and print its percentiles per stage at the end.)
+	-dropwhenfull (In push mode, drop new images when the pipeline falls behind, instead of waiting for it.)
+	-grabstrategy <latestonly|latest|onebyone|upcoming> (How the driver hands images to the pipeline. Default latestonly is best for display, onebyone for recording every image.)
+	-numbuffers <n> (Number of driver buffers. With -grabstrategy latest, the number of latest images kept.)
 
 	Pipeline Examples (pick one):
 	-h264stream <ipaddress> (Encodes images as h264 and transmits stream to another PC running a GStreamer receiving pipeline.)
@@ -90,6 +111,9 @@ guint bus_watch_id;
 // we link elements together in a pipeline, and send messages to/from the pipeline.
 GstElement *pipeline;
 
+// the camera also takes messages from the bus (see CInstantCameraAppSrc::HandleBusMessage())
+CInstantCameraAppSrc *pCamera = NULL;
+
 // handler for bus call messages
 gboolean bus_call(GstBus *bus, GstMessage *msg, gpointer data)
 {
@@ -119,6 +143,32 @@ gboolean bus_call(GstBus *bus, GstMessage *msg, gpointer data)
 			break;
 		}
 
+		case GST_MESSAGE_APPLICATION:
+			if (pCamera != NULL)
+				pCamera->HandleBusMessage(msg);
+			break;
+
+		case GST_MESSAGE_ELEMENT: {
+			// the camera posts its frame counts periodically. Report them when images went missing since the last report.
+			const GstStructure *stats = gst_message_get_structure(msg);
+			if (stats == NULL || gst_structure_has_name(stats, "camera-frame-stats") == FALSE)
+				break;
+
+			static guint64 lastMissing = 0;
+			guint64 grabbed = 0, skipped = 0, lost = 0, failed = 0, incomplete = 0, duplicated = 0;
+			gst_structure_get_uint64(stats, "grabbed", &grabbed);
+			gst_structure_get_uint64(stats, "skipped", &skipped);
+			gst_structure_get_uint64(stats, "lost", &lost);
+			gst_structure_get_uint64(stats, "failed", &failed);
+			gst_structure_get_uint64(stats, "incomplete", &incomplete);
+			gst_structure_get_uint64(stats, "duplicated", &duplicated);
+			guint64 missing = skipped + lost + failed + incomplete;
+			if (missing != lastMissing)
+				cout << "Camera " << gst_structure_get_string(stats, "serial") << ": grabbed " << grabbed << ", skipped " << skipped << ", lost " << lost << ", failed " << failed << ", incomplete " << incomplete << ", duplicated " << duplicated << endl;
+			lastMissing = missing;
+			break;
+		}
+
 		default:
 			break;
 		}
@@ -174,6 +224,10 @@ void IntHandler(int dummy)
 int width = -1;
 int height = -1;
 int frameRate = -1;
+int switchWidth = -1; // do not switch the AOI by default
+int switchHeight = -1;
+int switchFrameRate = -1;
+bool pan = false;
 
 int numImagesToRecord = -1; // capture indefinitley unless otherwise specified.
 int scaledWidth = -1; // do not scale by default
@@ -187,11 +241,31 @@ bool framebuffer = false;
 bool parsestring = false;
 bool onDemand = false;
 bool useTrigger = false;
+bool zeroCopy = false;
+bool gstMemory = false;
+int numStripes = 0;
+bool useNV12 = false;
+bool rgbConvert = false;
+bool rawBayer = false;
+bool msbAligned = false;
+bool gstScale = false;
+bool noBinning = false;
+bool flipX = false;
+bool flipY = false;
+bool chunkData = false;
+bool pushMode = false;
+int ringDepth = 4;
+bool dropWhenFull = false;
+bool lowLatency = false;
+bool traceLatency = false;
+Pylon::EGrabStrategy grabStrategy = Pylon::GrabStrategy_LatestImageOnly;
+int numGrabBuffers = -1;
 string serialNumber = "";
 string ipaddress = "";
 string filename = "";
 string fbdev = "";
 string pipelineString = "";
+string metricsFile = "";
 
 int ParseCommandLine(gint argc, gchar *argv[])
 {
@@ -217,11 +291,32 @@ int ParseCommandLine(gint argc, gchar *argv[])
 			cout << "Options: " << endl;
 			cout << " -camera <serialnumber> (Use a specific camera. If not specified, will use first camera found.)" << endl;
 			cout << " -aoi <width> <height> (Camera's Area Of Interest. If not specified, will use camera's maximum.)" << endl;
+			cout << " -switchaoi <width> <height> <fps> (Will switch between the AOI above and this one every 5 seconds, without restarting the pipeline. eg: a high-speed ROI.)" << endl;
+			cout << " -pan (Will move the AOI back and forth across the sensor, by posting camera-region messages on the pipeline's bus. Use with -aoi.)" << endl;
 			cout << " -rescale <width> <height> (Will rescale the image for the pipeline if desired.)" << endl;
 			cout << " -rotate <degrees clockwise> (Will rotate 90, 180, 270 degrees clockwise)" << endl;
+			cout << " -flipx (Will mirror the image horizontally, before rotating it. The camera does it if it can.)" << endl;
+			cout << " -flipy (Will mirror the image vertically, before rotating it. The camera does it if it can.)" << endl;
+			cout << " -chunkdata (Will attach the camera's chunk data (frame counter, exposure time, gain, line status, CRC) to each image, and print it every 100 images.)" << endl;
+			cout << " -metrics <file> (Will write the frame counts and stream grabber statistics to a Prometheus text file every second. eg: /var/lib/node_exporter/camera.prom)" << endl;
+			cout << " -gstscale (Will rescale and rotate with videoscale and videoflip elements, instead of on the host right after conversion.)" << endl;
+			cout << " -nobinning (Will grab full resolution and rescale on the host, instead of binning or decimating on the camera first.)" << endl;
 			cout << " -framerate <fps> (If not specified, will use camera's maximum under current settings.)" << endl;
 			cout << " -ondemand (Will software trigger the camera when needed instead of using continuous free run. May lower CPU load.)" << endl;
 			cout << " -usetrigger (Will configure the camera to expect a hardware trigger on IO Line 1. eg: TTL signal.)" << endl;
+			cout << " -zerocopy (Will push the driver's image buffers into the pipeline without copying them, when no conversion is needed.)" << endl;
+			cout << " -gstmemory (Will let the driver grab directly into GStreamer memory, which is then pushed without copying when no conversion is needed.)" << endl;
+			cout << " -stripes <n> (Will split color conversion into n stripes converted in parallel. Default is one per core.)" << endl;
+			cout << " -nv12 (Bayer cameras output NV12 instead of I420. Suits hardware encoders.)" << endl;
+			cout << " -rgbconvert (Bayer cameras are converted to RGB by Pylon, instead of straight to YUV.)" << endl;
+			cout << " -msb (10 and 12-bit images are shifted into the upper bits of GRAY16_LE, so they show the full brightness range.)" << endl;
+			cout << " -rawbayer (Bayer cameras output video/x-bayer, to be demosaiced downstream. Use with -parse, eg: -parse \"bayer2rgb ! videoconvert ! autovideosink\")" << endl;
+			cout << " -pushmode <ring depth> (Will grab and push images from separate threads as they arrive, instead of when the pipeline asks for them.)" << endl;
+			cout << " -lowlatency (Will keep as little buffering as possible between camera and pipeline, for live display.)" << endl;
+			cout << " -tracelatency (Will measure the latency of each image from exposure to sink, and print its percentiles per stage at the end.)" << endl;
+			cout << " -dropwhenfull (In push mode, drop new images when the pipeline falls behind, instead of waiting for it.)" << endl;
+			cout << " -grabstrategy <latestonly|latest|onebyone|upcoming> (How the driver hands images to the pipeline. Default latestonly is best for display, onebyone for recording every image.)" << endl;
+			cout << " -numbuffers <n> (Number of driver buffers. With -grabstrategy latest, the number of latest images kept.)" << endl;
 			cout << endl;
 			cout << "Pipeline Examples (pick one):" << endl;
 			cout << " -h264stream <ipaddress> (Encodes images as h264 and transmits stream to another PC running a GStreamer receiving pipeline.)" << endl;
@@ -284,6 +379,24 @@ int ParseCommandLine(gint argc, gchar *argv[])
 					return -1;
 				}
 			}
+			else if (string(argv[i]) == "-switchaoi")
+			{
+				if (argv[i + 1] != NULL && argv[i + 2] != NULL && argv[i + 3] != NULL)
+				{
+					switchWidth = atoi(argv[i + 1]);
+					switchHeight = atoi(argv[i + 2]);
+					switchFrameRate = atoi(argv[i + 3]);
+				}
+				else
+				{
+					cout << "Switching AOI width, height or fps not specified. eg: -switchaoi 640 480 200" << endl;
+					return -1;
+				}
+			}
+			else if (string(argv[i]) == "-pan")
+			{
+				pan = true;
+			}
 			else if (string(argv[i]) == "-rescale")
 			{
 				if (argv[i + 1] != NULL)
@@ -329,6 +442,125 @@ int ParseCommandLine(gint argc, gchar *argv[])
 			{
 				useTrigger = true;
 			}
+			else if (string(argv[i]) == "-zerocopy")
+			{
+				zeroCopy = true;
+			}
+			else if (string(argv[i]) == "-gstmemory")
+			{
+				gstMemory = true;
+			}
+			else if (string(argv[i]) == "-stripes")
+			{
+				if (argv[i + 1] != NULL)
+					numStripes = atoi(argv[i + 1]);
+				else
+				{
+					cout << "Number of stripes not specified. eg: -stripes 4" << endl;
+					return -1;
+				}
+			}
+			else if (string(argv[i]) == "-nv12")
+			{
+				useNV12 = true;
+			}
+			else if (string(argv[i]) == "-rgbconvert")
+			{
+				rgbConvert = true;
+			}
+			else if (string(argv[i]) == "-msb")
+			{
+				msbAligned = true;
+			}
+			else if (string(argv[i]) == "-gstscale")
+			{
+				gstScale = true;
+			}
+			else if (string(argv[i]) == "-nobinning")
+			{
+				noBinning = true;
+			}
+			else if (string(argv[i]) == "-flipx")
+			{
+				flipX = true;
+			}
+			else if (string(argv[i]) == "-flipy")
+			{
+				flipY = true;
+			}
+			else if (string(argv[i]) == "-chunkdata")
+			{
+				chunkData = true;
+			}
+			else if (string(argv[i]) == "-metrics")
+			{
+				if (argv[i + 1] != NULL)
+					metricsFile = string(argv[i + 1]);
+				else
+				{
+					cout << "Metrics file not specified. eg: -metrics /var/lib/node_exporter/camera.prom" << endl;
+					return -1;
+				}
+			}
+			else if (string(argv[i]) == "-rawbayer")
+			{
+				rawBayer = true;
+			}
+			else if (string(argv[i]) == "-pushmode")
+			{
+				pushMode = true;
+				if (argv[i + 1] != NULL)
+					ringDepth = atoi(argv[i + 1]);
+				else
+				{
+					cout << "Ring depth not specified. eg: -pushmode 4" << endl;
+					return -1;
+				}
+			}
+			else if (string(argv[i]) == "-lowlatency")
+			{
+				lowLatency = true;
+			}
+			else if (string(argv[i]) == "-tracelatency")
+			{
+				traceLatency = true;
+			}
+			else if (string(argv[i]) == "-dropwhenfull")
+			{
+				dropWhenFull = true;
+			}
+			else if (string(argv[i]) == "-grabstrategy")
+			{
+				if (argv[i + 1] == NULL)
+				{
+					cout << "Grab strategy not specified. eg: -grabstrategy onebyone" << endl;
+					return -1;
+				}
+				string strategy = string(argv[i + 1]);
+				if (strategy == "latestonly")
+					grabStrategy = Pylon::GrabStrategy_LatestImageOnly;
+				else if (strategy == "latest")
+					grabStrategy = Pylon::GrabStrategy_LatestImages;
+				else if (strategy == "onebyone")
+					grabStrategy = Pylon::GrabStrategy_OneByOne;
+				else if (strategy == "upcoming")
+					grabStrategy = Pylon::GrabStrategy_UpcomingImage;
+				else
+				{
+					cout << "Unknown grab strategy. Use one of: latestonly, latest, onebyone, upcoming" << endl;
+					return -1;
+				}
+			}
+			else if (string(argv[i]) == "-numbuffers")
+			{
+				if (argv[i + 1] != NULL)
+					numGrabBuffers = atoi(argv[i + 1]);
+				else
+				{
+					cout << "Number of buffers not specified. eg: -numbuffers 20" << endl;
+					return -1;
+				}
+			}
 			else if (string(argv[i]) == "-h264stream")
 			{
 				h264stream = true;
@@ -458,6 +690,53 @@ int ParseCommandLine(gint argc, gchar *argv[])
 
 // *********** END Command line argument variables and parser **************
 
+// Switches the camera between its initial AOI and the -switchaoi one while the pipeline runs (see CInstantCameraAppSrc::Reconfigure())
+int initialWidth = -1;
+int initialHeight = -1;
+double initialFrameRate = -1;
+bool isAoiSwitched = false;
+gboolean switch_aoi(gpointer data)
+{
+	CInstantCameraAppSrc *pCamera = (CInstantCameraAppSrc*)data;
+	isAoiSwitched = !isAoiSwitched;
+	if (isAoiSwitched == true)
+		pCamera->Reconfigure(switchWidth, switchHeight, switchFrameRate);
+	else
+		pCamera->Reconfigure(initialWidth, initialHeight, initialFrameRate);
+	return TRUE; // keep the timer running
+}
+
+// Prints the chunk data the camera attached to every 100th image (see CChunkMeta). Any element or probe downstream can read it the same way.
+GstPadProbeReturn print_chunk_data(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	CChunkMeta *pChunkMeta = (buffer != NULL) ? CChunkMeta::Get(buffer) : NULL;
+	if (pChunkMeta == NULL || (pChunkMeta->Has(CChunkMeta::Field_FrameCounter) == true && pChunkMeta->frameCounter % 100 != 0))
+		return GST_PAD_PROBE_OK;
+
+	cout << "Chunk data: frame " << pChunkMeta->frameCounter << ", timestamp " << pChunkMeta->timestamp << ", exposure " << pChunkMeta->exposureTime << " us, gain "
+		<< pChunkMeta->gain << ", lines 0x" << hex << pChunkMeta->lineStatus << dec << ", CRC " << (pChunkMeta->Has(CChunkMeta::Field_Crc) ? (pChunkMeta->isCrcOk ? "ok" : "bad") : "n/a") << endl;
+	return GST_PAD_PROBE_OK;
+}
+
+// Moves the AOI a step across the sensor and back, like a region followed by an application would
+int panRange = 0;
+int panOffset = 0;
+int panStep = 16;
+gboolean pan_aoi(gpointer data)
+{
+	panOffset += panStep;
+	if (panOffset <= 0 || panOffset >= panRange)
+	{
+		panOffset = std::min(std::max(panOffset, 0), panRange);
+		panStep = -panStep;
+	}
+
+	GstStructure *region = gst_structure_new("camera-region", "offset-x", G_TYPE_INT, panOffset, NULL);
+	gst_element_post_message(pipeline, gst_message_new_application(GST_OBJECT(pipeline), region));
+	return TRUE; // keep the timer running
+}
+
 gint main(gint argc, gchar *argv[])
 {
 
@@ -484,14 +763,33 @@ gint main(gint argc, gchar *argv[])
 		// The InstantCameraForAppSrc will manage the camera and driver
 		// and provide a source element to the GStreamer pipeline.
 		CInstantCameraAppSrc camera(serialNumber);
+		pCamera = &camera;
 
 		// reset the camera to defaults if you like
 		cout << "Resetting camera to default settings..." << endl;
 		camera.ResetCamera();
 
+		// Choose the output path before initializing, as InitCamera() picks the camera's binning and mirroring for it.
+		camera.SetBayerToYuv(rgbConvert == false, useNV12);
+		camera.SetRawBayer(rawBayer);
+		camera.SetMsbAligned(msbAligned);
+		camera.SetFusedTransform(gstScale == false);
+		if (noBinning == true)
+			camera.SetCameraBinning(false);
+		camera.SetFlip(flipX, flipY);
+
 		// Initialize the camera and driver
 		cout << "Initializing camera and driver..." << endl;
-		camera.InitCamera(width, height, frameRate, onDemand, useTrigger, scaledWidth, scaledHeight, rotation, numImagesToRecord);		
+		camera.InitCamera(width, height, frameRate, onDemand, useTrigger, scaledWidth, scaledHeight, rotation, numImagesToRecord, grabStrategy, numGrabBuffers);		
+		camera.SetZeroCopy(zeroCopy);
+		if (gstMemory == true)
+			camera.SetGstBufferFactory(true);
+		camera.SetConversionStripes(numStripes);
+		camera.SetChunkData(chunkData);
+		camera.SetStatsInterval(1000, metricsFile);
+		camera.SetLowLatency(lowLatency);
+		camera.SetLatencyTracing(traceLatency);
+		camera.SetPushMode(pushMode, ringDepth, dropWhenFull ? CInstantCameraAppSrc::DropPolicy_DropNewest : CInstantCameraAppSrc::DropPolicy_Wait);
 
 		cout << "Using Camera             : " << camera.GetDeviceInfo().GetFriendlyName() << endl;
 		cout << "Camera Area Of Interest  : " << camera.GetWidth() << "x" << camera.GetHeight() << endl;
@@ -540,6 +838,18 @@ gint main(gint argc, gchar *argv[])
 			throw std::runtime_error("Pipeline building failed!");
 		}
 
+		// measure each image's latency at the sink
+		if (traceLatency == true)
+			myPipelineHelper.trace_latency();
+
+		// print the chunk data as the images leave the source
+		if (chunkData == true)
+		{
+			GstPad *sourcePad = gst_element_get_static_pad(source, "src");
+			gst_pad_add_probe(sourcePad, GST_PAD_PROBE_TYPE_BUFFER, print_chunk_data, NULL, NULL);
+			gst_object_unref(sourcePad);
+		}
+
 		// Start the camera and grab engine.
 		if (camera.StartCamera() == false)
 		{
@@ -551,6 +861,24 @@ gint main(gint argc, gchar *argv[])
 		cout << "Starting pipeline..." << endl;
 		gst_element_set_state(pipeline, GST_STATE_PLAYING);
 
+		// switch the AOI every 5 seconds if asked
+		if (switchWidth != -1 && switchHeight != -1)
+		{
+			initialWidth = camera.GetWidth();
+			initialHeight = camera.GetHeight();
+			initialFrameRate = camera.GetFrameRate();
+			g_timeout_add_seconds(5, switch_aoi, &camera);
+		}
+
+		// pan the AOI across the sensor if asked. The AOI can move as far as the sensor is wider than it.
+		if (pan == true && IsReadable(camera.GetNodeMap().GetNode("OffsetX")))
+		{
+			if (IsWritable(camera.GetNodeMap().GetNode("CenterX")))
+				GenApi::CBooleanPtr(camera.GetNodeMap().GetNode("CenterX"))->SetValue(false);
+			panRange = (int)GenApi::CIntegerPtr(camera.GetNodeMap().GetNode("OffsetX"))->GetMax();
+			g_timeout_add(40, pan_aoi, NULL);
+		}
+
 		// run the main loop. When Ctrl+C is pressed, an EOS event will be sent
 		// which will shutdown the pipeline in intHandler(), which will in turn quit the main loop.
 		g_main_loop_run(loop);
@@ -561,6 +889,7 @@ gint main(gint argc, gchar *argv[])
 
 		camera.StopCamera();
 		camera.CloseCamera();
+		pCamera = NULL;
 		
 		gst_object_unref(GST_OBJECT(pipeline));
 		g_main_loop_unref(loop);
@@ -28,13 +28,19 @@
 	|                                                 src--sink      src--sink      src--sink       |
 	+--------------------------------------------------+    +---------+    +---------+    +---------+
 
+	Usage:
+	twocameras_compositor [-sync <trigger|action>] [<serialnumber1> <serialnumber2>] (If not specified, will use the first two cameras found.)
+	-sync trigger: both cameras take their images on one trigger signal wired to their Line1 (ie: USB cameras).
+	-sync action: GigE cameras synchronize their clocks by PTP, and take their images together on scheduled action commands.
+	With -sync, the left and right images are shown in matched pairs, taken at the same moment.
+
 	Note:
 	Some GStreamer elements (plugins) used in the pipeline examples may not be available on all systems. Consult GStreamer for more information:
 	https://gstreamer.freedesktop.org/
 */
 
 
-#include "../../InstantCameraAppSrc/CInstantCameraAppSrc.h"
+#include "../../InstantCameraAppSrc/CCameraArrayAppSrc.h"
 #include <gst/gst.h>
 #include <thread>
 
@@ -150,10 +156,37 @@ gint main(gint argc, gchar *argv[])
 		// create the mainloop
 		loop = g_main_loop_new(NULL, FALSE);
 
-		// The InstantCameraForAppSrc will manage the physical camera and pylon driver
-		// and provide a source element to the GStreamer pipeline.
-		CInstantCameraAppSrc camera1("21734321");
-		CInstantCameraAppSrc camera2("21708961");
+		// The CCameraArrayAppSrc enumerates the cameras once, opens them in parallel, and retrieves their images on one shared pool of threads.
+		// Each camera is an InstantCameraForAppSrc, which manages the physical camera and pylon driver and provides a source element to the GStreamer pipeline.
+		// Pass two serial numbers on the command line to use specific cameras, otherwise the first two cameras found are used.
+		CCameraArrayAppSrc::ESyncMode syncMode = CCameraArrayAppSrc::Sync_None;
+		vector<string> serialNumbers;
+		for (int i = 1; i < argc; i++)
+		{
+			if (string(argv[i]) == "-sync" && i + 1 < argc)
+			{
+				string mode = argv[++i];
+				if (mode == "trigger")
+					syncMode = CCameraArrayAppSrc::Sync_HardwareTrigger;
+				else if (mode == "action")
+					syncMode = CCameraArrayAppSrc::Sync_ActionCommand;
+				else
+					cout << "Unknown sync mode: " << mode << ". Cameras will run free." << endl;
+			}
+			else
+				serialNumbers.push_back(argv[i]);
+		}
+		CCameraArrayAppSrc cameras(2, serialNumbers);
+		if (cameras.GetSize() < 2)
+		{
+			exitCode = -1;
+			throw std::runtime_error("This sample needs two cameras!");
+		}
+
+		// Synchronized cameras take their images together, and their images are pushed in matched pairs with one timestamp.
+		cameras.SetSynchronization(syncMode);
+		CInstantCameraAppSrc &camera1 = cameras.GetCamera(0);
+		CInstantCameraAppSrc &camera2 = cameras.GetCamera(1);
 
 		// rescale both cameras' images to 320x240 for demo purposes
 		int rescaleWidth = 320;
@@ -162,8 +195,11 @@ gint main(gint argc, gchar *argv[])
 		// Initialize the cameras and driver for use with GStreamer
 		// use maximum possible width and height, and maximum possible framerate under current settings.
 		cout << "Initializing camera and driver..." << endl;
-		camera1.InitCamera(-1, -1, -1, true, false, rescaleWidth, rescaleHeight);
-		camera2.InitCamera(-1, -1, -1, true, false, rescaleWidth, rescaleHeight);
+		if (cameras.InitCameras(-1, -1, -1, false, rescaleWidth, rescaleHeight) == false)
+		{
+			exitCode = -1;
+			throw std::runtime_error("Could not initialize cameras!");
+		}
 
 		// Apply some additional settings you may like
 		cout << "Applying additional user settings..." << endl;
@@ -173,34 +209,17 @@ gint main(gint argc, gchar *argv[])
 		GenApi::CFloatPtr(camera1.GetNodeMap().GetNode("ExposureTime"))->SetValue(3000);
 		GenApi::CFloatPtr(camera2.GetNodeMap().GetNode("ExposureTime"))->SetValue(3000);
 
-		// Split the bandwidth between both cameras. This is critical for multi-camera operation.
-		// example: if we are using two usb cameras
-		if (camera1.GetDeviceInfo().GetDeviceClass() == Pylon::BaslerUsbDeviceClass && camera1.GetDeviceInfo().GetDeviceClass() == Pylon::BaslerUsbDeviceClass)
-		{
-			// Turn on the bandwidth limiter
-			GenApi::CEnumerationPtr(camera1.GetNodeMap().GetNode("DeviceLinkThroughputLimitMode"))->FromString("On");
-			GenApi::CEnumerationPtr(camera2.GetNodeMap().GetNode("DeviceLinkThroughputLimitMode"))->FromString("On");
-
-			// Set each camera's limit to 150 MB/sec. Typically USB 3 can support ~350-400 MB/sec, but performance varies based on the host system's chipset.
-			// So, assuming a maximum of 300 MB/sec per chipset is usually safe.
-			GenApi::CIntegerPtr(camera1.GetNodeMap().GetNode("DeviceLinkThroughputLimit"))->SetValue(150000000);
-			GenApi::CIntegerPtr(camera2.GetNodeMap().GetNode("DeviceLinkThroughputLimit"))->SetValue(150000000);
-		}
+		// Split the bandwidth of the links the cameras share (ie: one usb host controller, or one network card). This is critical for multi-camera operation.
+		// The planner gives each camera a share of its link, and tells us the frame rate both cameras can sustain on their shares.
+		double sustainableFrameRate = cameras.PlanBandwidth();
 
 		// If we change settings like exposuretime, bandwidth, width, height, etc.
 		// Then the camera's framerate possibilities have probably changed...
 		// Since we are using multiple cameras, we probably want them to be "in sync", so let's use the maximum common framerate between them
-		double frameRateCamera1 = camera1.GetFrameRate(); // get the max framerate based on current settings
-		double frameRateCamera2 = camera2.GetFrameRate();
-		double maxCommonFrameRate = 0;
-
-		if (frameRateCamera1 <= frameRateCamera2)
-			maxCommonFrameRate = frameRateCamera1;
-		else
-			maxCommonFrameRate = frameRateCamera2;
-
-		camera1.SetFrameRate(maxCommonFrameRate);
-		camera2.SetFrameRate(maxCommonFrameRate);
+		double maxCommonFrameRate = cameras.GetMaxCommonFrameRate(); // the max framerate based on current settings
+		if (sustainableFrameRate > 0 && sustainableFrameRate < maxCommonFrameRate)
+			maxCommonFrameRate = sustainableFrameRate;
+		cameras.SetFrameRate(maxCommonFrameRate);
 		
 		cout << "Maximum common framerate: " << maxCommonFrameRate << endl;		
 		
@@ -262,7 +281,8 @@ gint main(gint argc, gchar *argv[])
 
 		// The sink element for this sample will be whatever videosink the system prefers for display.
 		sink = gst_element_factory_make("autovideosink", "videosink");
-		g_object_set(sink, "sync", false, NULL);
+		// Matched pairs share a timestamp, so let the sink show them by it. Free-running cameras are shown as soon as their images come.
+		g_object_set(sink, "sync", syncMode != CCameraArrayAppSrc::Sync_None, NULL);
 		g_object_set(sink, "message-forward", true, NULL);
 
 		// Add all the elements to the pipeline.
@@ -273,8 +293,8 @@ gint main(gint argc, gchar *argv[])
 		gst_element_link_many(source2, videoconvert2, compositor, capsfilter, sink, NULL);
 		gst_element_link_many(compositor, sink, NULL);
 		
-		// Start the camera and grab engine.
-		if (camera1.StartCamera() == false || camera2.StartCamera() == false)
+		// Start the cameras and grab engines.
+		if (cameras.StartCameras() == false)
 		{
 			exitCode = -1;
 			throw std::runtime_error("Could not start camera!");
@@ -292,11 +312,8 @@ gint main(gint argc, gchar *argv[])
 		cout << "Stopping pipeline..." << endl;
 		gst_element_set_state(pipeline, GST_STATE_NULL);
 
-		camera1.StopCamera();
-		camera1.CloseCamera();
-
-		camera2.StopCamera();
-		camera2.CloseCamera();
+		cameras.StopCameras();
+		cameras.CloseCameras();
 		
 		gst_object_unref(GST_OBJECT(pipeline));
 		g_main_loop_unref(loop);